@@ -171,6 +171,61 @@ bool Adafruit_BME280::init()
     return true;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Initialise a freshly powered I2C sensor for single forced measurements
+
+    The soft-reset and its delays are skipped, after the power up the
+    sensor is already sleeping with the filter off. The calibration is
+    only read from the sensor if no cached copy is given.
+    @param calib cached calibration of this sensor or NULL
+    @param addr the I2C address the device can be found on
+    @param theWire the I2C object to use
+    @returns true on success, false otherwise
+*/
+/**************************************************************************/
+bool Adafruit_BME280::beginForced(const bme280_calib_data *calib, uint8_t addr, TwoWire *theWire)
+{
+    _i2caddr = addr;
+    _wire = theWire;
+    _wire -> begin();
+
+    // start-up time after power on (DS 1.1)
+    delay(2);
+
+    if (read8(BME280_REGISTER_CHIPID) != 0x60)
+        return false;
+
+    if (calib) {
+        _bme280_calib = *calib;
+    } else {
+        while (isReadingCalibration())
+            delay(1);
+        readCoefficients();
+    }
+    _humReg.osrs_h    = SAMPLING_X1;
+    _configReg.filter = FILTER_OFF;
+    _configReg.t_sb   = STANDBY_MS_0_5;
+    _measReg.osrs_t   = SAMPLING_X1;
+    _measReg.osrs_p   = SAMPLING_X1;
+    _measReg.mode     = MODE_SLEEP;
+
+    // the control register is written with the forced mode by measureAll() or startMeasurement()
+    write8(BME280_REGISTER_CONTROLHUMID, _humReg.get());
+    return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  The calibration of the sensor, i.e. to cache it for beginForced()
+    @returns the calibration data
+*/
+/**************************************************************************/
+const bme280_calib_data &Adafruit_BME280::getCalibration(void)
+{
+    return _bme280_calib;
+}
+
 /**************************************************************************/
 /*!
     @brief  setup sensor with given parameters / settings
@@ -405,6 +460,37 @@ uint32_t Adafruit_BME280::read24(byte reg)
 }
 
 
+/**************************************************************************/
+/*!
+    @brief  Reads consecutive registers in one I2C or SPI transaction
+    @param reg the first register address to read from
+    @param buffer the buffer for the data bytes
+    @param len the number of registers to read
+*/
+/**************************************************************************/
+void Adafruit_BME280::readBurst(byte reg, uint8_t *buffer, uint8_t len)
+{
+    if (_cs == -1) {
+        _wire -> beginTransmission((uint8_t)_i2caddr);
+        _wire -> write((uint8_t)reg);
+        _wire -> endTransmission();
+        _wire -> requestFrom((uint8_t)_i2caddr, (byte)len);
+        for (uint8_t i = 0; i < len; i++)
+            buffer[i] = _wire -> read();
+    } else {
+        if (_sck == -1)
+            SPI.beginTransaction(SPISettings(500000, MSBFIRST, SPI_MODE0));
+        digitalWrite(_cs, LOW);
+        spixfer(reg | 0x80); // read, bit 7 high
+        for (uint8_t i = 0; i < len; i++)
+            buffer[i] = spixfer(0);
+        digitalWrite(_cs, HIGH);
+        if (_sck == -1)
+            SPI.endTransaction(); // release the SPI bus
+    }
+}
+
+
 /**************************************************************************/
 /*!
     @brief  Take a new measurement (only possible in forced mode)
@@ -434,26 +520,33 @@ void Adafruit_BME280::takeForcedMeasurement()
 /**************************************************************************/
 void Adafruit_BME280::readCoefficients(void)
 {
-    _bme280_calib.dig_T1 = read16_LE(BME280_REGISTER_DIG_T1);
-    _bme280_calib.dig_T2 = readS16_LE(BME280_REGISTER_DIG_T2);
-    _bme280_calib.dig_T3 = readS16_LE(BME280_REGISTER_DIG_T3);
-
-    _bme280_calib.dig_P1 = read16_LE(BME280_REGISTER_DIG_P1);
-    _bme280_calib.dig_P2 = readS16_LE(BME280_REGISTER_DIG_P2);
-    _bme280_calib.dig_P3 = readS16_LE(BME280_REGISTER_DIG_P3);
-    _bme280_calib.dig_P4 = readS16_LE(BME280_REGISTER_DIG_P4);
-    _bme280_calib.dig_P5 = readS16_LE(BME280_REGISTER_DIG_P5);
-    _bme280_calib.dig_P6 = readS16_LE(BME280_REGISTER_DIG_P6);
-    _bme280_calib.dig_P7 = readS16_LE(BME280_REGISTER_DIG_P7);
-    _bme280_calib.dig_P8 = readS16_LE(BME280_REGISTER_DIG_P8);
-    _bme280_calib.dig_P9 = readS16_LE(BME280_REGISTER_DIG_P9);
-
-    _bme280_calib.dig_H1 = read8(BME280_REGISTER_DIG_H1);
-    _bme280_calib.dig_H2 = readS16_LE(BME280_REGISTER_DIG_H2);
-    _bme280_calib.dig_H3 = read8(BME280_REGISTER_DIG_H3);
-    _bme280_calib.dig_H4 = (read8(BME280_REGISTER_DIG_H4) << 4) | (read8(BME280_REGISTER_DIG_H4+1) & 0xF);
-    _bme280_calib.dig_H5 = (read8(BME280_REGISTER_DIG_H5+1) << 4) | (read8(BME280_REGISTER_DIG_H5) >> 4);
-    _bme280_calib.dig_H6 = (int8_t)read8(BME280_REGISTER_DIG_H6);
+    uint8_t tp[BME280_CALIB_TP_LENGTH];
+    uint8_t h[BME280_CALIB_H_LENGTH];
+
+    // two burst reads instead of one transaction per value
+    readBurst(BME280_REGISTER_DIG_T1, tp, BME280_CALIB_TP_LENGTH);
+    readBurst(BME280_REGISTER_DIG_H2, h,  BME280_CALIB_H_LENGTH);
+
+    _bme280_calib.dig_T1 = (uint16_t)(tp[1] << 8 | tp[0]);
+    _bme280_calib.dig_T2 = (int16_t)(tp[3] << 8 | tp[2]);
+    _bme280_calib.dig_T3 = (int16_t)(tp[5] << 8 | tp[4]);
+
+    _bme280_calib.dig_P1 = (uint16_t)(tp[7] << 8 | tp[6]);
+    _bme280_calib.dig_P2 = (int16_t)(tp[9] << 8 | tp[8]);
+    _bme280_calib.dig_P3 = (int16_t)(tp[11] << 8 | tp[10]);
+    _bme280_calib.dig_P4 = (int16_t)(tp[13] << 8 | tp[12]);
+    _bme280_calib.dig_P5 = (int16_t)(tp[15] << 8 | tp[14]);
+    _bme280_calib.dig_P6 = (int16_t)(tp[17] << 8 | tp[16]);
+    _bme280_calib.dig_P7 = (int16_t)(tp[19] << 8 | tp[18]);
+    _bme280_calib.dig_P8 = (int16_t)(tp[21] << 8 | tp[20]);
+    _bme280_calib.dig_P9 = (int16_t)(tp[23] << 8 | tp[22]);
+
+    _bme280_calib.dig_H1 = tp[25]; // 0xA1, 0xA0 is unused
+    _bme280_calib.dig_H2 = (int16_t)(h[1] << 8 | h[0]);
+    _bme280_calib.dig_H3 = h[2];
+    _bme280_calib.dig_H4 = (h[3] << 4) | (h[4] & 0xF);
+    _bme280_calib.dig_H5 = (h[5] << 4) | (h[4] >> 4);
+    _bme280_calib.dig_H6 = (int8_t)h[6];
 }
 
 /**************************************************************************/
@@ -478,13 +571,27 @@ bool Adafruit_BME280::isReadingCalibration(void)
 /**************************************************************************/
 float Adafruit_BME280::readTemperature(void)
 {
-    int32_t var1, var2;
-
     int32_t adc_T = read24(BME280_REGISTER_TEMPDATA);
     if (adc_T == 0x800000) // value in case temp measurement was disabled
         return NAN;
     adc_T >>= 4;
 
+    float T = compensateTemperature(adc_T);
+    return T/100;
+}
+
+
+/**************************************************************************/
+/*!
+    @brief  Compensates a raw temperature value and sets t_fine
+    @param adc_T the 20 bit raw value
+    @returns the temperature in 1/100 degrees Celsius
+*/
+/**************************************************************************/
+int32_t Adafruit_BME280::compensateTemperature(int32_t adc_T)
+{
+    int32_t var1, var2;
+
     var1 = ((((adc_T>>3) - ((int32_t)_bme280_calib.dig_T1 <<1))) *
             ((int32_t)_bme280_calib.dig_T2)) >> 11;
              
@@ -494,8 +601,7 @@ float Adafruit_BME280::readTemperature(void)
 
     t_fine = var1 + var2;
 
-    float T = (t_fine * 5 + 128) >> 8;
-    return T/100;
+    return (t_fine * 5 + 128) >> 8;
 }
 
 
@@ -506,8 +612,6 @@ float Adafruit_BME280::readTemperature(void)
 */
 /**************************************************************************/
 float Adafruit_BME280::readPressure(void) {
-    int64_t var1, var2, p;
-
     readTemperature(); // must be done first to get t_fine
 
     int32_t adc_P = read24(BME280_REGISTER_PRESSUREDATA);
@@ -515,6 +619,20 @@ float Adafruit_BME280::readPressure(void) {
         return NAN;
     adc_P >>= 4;
 
+    return (float)compensatePressure(adc_P)/256;
+}
+
+
+/**************************************************************************/
+/*!
+    @brief  Compensates a raw pressure value with the current t_fine
+    @param adc_P the 20 bit raw value
+    @returns the pressure in 1/256 Pa
+*/
+/**************************************************************************/
+uint32_t Adafruit_BME280::compensatePressure(int32_t adc_P) {
+    int64_t var1, var2, p;
+
     var1 = ((int64_t)t_fine) - 128000;
     var2 = var1 * var1 * (int64_t)_bme280_calib.dig_P6;
     var2 = var2 + ((var1*(int64_t)_bme280_calib.dig_P5)<<17);
@@ -532,7 +650,7 @@ float Adafruit_BME280::readPressure(void) {
     var2 = (((int64_t)_bme280_calib.dig_P8) * p) >> 19;
 
     p = ((p + var1 + var2) >> 8) + (((int64_t)_bme280_calib.dig_P7)<<4);
-    return (float)p/256;
+    return (uint32_t)p;
 }
 
 
@@ -548,7 +666,20 @@ float Adafruit_BME280::readHumidity(void) {
     int32_t adc_H = read16(BME280_REGISTER_HUMIDDATA);
     if (adc_H == 0x8000) // value in case humidity measurement was disabled
         return NAN;
-        
+
+    float h = compensateHumidity(adc_H);
+    return  h / 1024.0;
+}
+
+
+/**************************************************************************/
+/*!
+    @brief  Compensates a raw humidity value with the current t_fine
+    @param adc_H the 16 bit raw value
+    @returns the relative humidity in 1/1024 %
+*/
+/**************************************************************************/
+uint32_t Adafruit_BME280::compensateHumidity(int32_t adc_H) {
     int32_t v_x1_u32r;
 
     v_x1_u32r = (t_fine - ((int32_t)76800));
@@ -564,8 +695,104 @@ float Adafruit_BME280::readHumidity(void) {
 
     v_x1_u32r = (v_x1_u32r < 0) ? 0 : v_x1_u32r;
     v_x1_u32r = (v_x1_u32r > 419430400) ? 419430400 : v_x1_u32r;
-    float h = (v_x1_u32r>>12);
-    return  h / 1024.0;
+    return (uint32_t)(v_x1_u32r>>12);
+}
+
+
+/**************************************************************************/
+/*!
+    @brief  Takes one forced measurement and reads all the values at once
+    @param temperature the temperature in 1/100 degrees Celsius
+    @param pressure the pressure in 1/256 Pa (0 if skipped)
+    @param humidity the relative humidity in 1/1024 % (0 if skipped)
+    @returns false if the temperature is skipped
+*/
+/**************************************************************************/
+bool Adafruit_BME280::measureAll(int32_t *temperature, uint32_t *pressure, uint32_t *humidity)
+{
+    _measReg.mode = MODE_FORCED;
+    takeForcedMeasurement();
+    return readAll(temperature, pressure, humidity);
+}
+
+
+/**************************************************************************/
+/*!
+    @brief  Starts one forced measurement without waiting for the result
+
+    The result can be read with readAll() after getMeasurementTimeMs()
+    or when isMeasuring() is false.
+*/
+/**************************************************************************/
+void Adafruit_BME280::startMeasurement(void)
+{
+    _measReg.mode = MODE_FORCED;
+    write8(BME280_REGISTER_CONTROL, _measReg.get());
+}
+
+
+/**************************************************************************/
+/*!
+    @brief  Is a conversion running?
+    @returns true while the sensor is measuring
+*/
+/**************************************************************************/
+bool Adafruit_BME280::isMeasuring(void)
+{
+    return (read8(BME280_REGISTER_STATUS) & 0x08) != 0;
+}
+
+
+/**************************************************************************/
+/*!
+    @brief  Maximum conversion time of the current oversampling (DS 9.1)
+    @returns the measurement time in ms
+*/
+/**************************************************************************/
+float Adafruit_BME280::getMeasurementTimeMs(void)
+{
+    float ms = 1.25;
+
+    if (_measReg.osrs_t)
+        ms += 2.3 * (1 << (_measReg.osrs_t - 1));
+    if (_measReg.osrs_p)
+        ms += 2.3 * (1 << (_measReg.osrs_p - 1)) + 0.575;
+    if (_humReg.osrs_h)
+        ms += 2.3 * (1 << (_humReg.osrs_h - 1)) + 0.575;
+    return ms;
+}
+
+
+/**************************************************************************/
+/*!
+    @brief  Reads the values of the last measurement in one burst
+
+    The data registers 0xF7-0xFE are read at once, so all the values
+    belong to the same conversion and t_fine is only calculated once.
+    @param temperature the temperature in 1/100 degrees Celsius
+    @param pressure the pressure in 1/256 Pa (0 if skipped)
+    @param humidity the relative humidity in 1/1024 % (0 if skipped)
+    @returns false if the temperature is skipped
+*/
+/**************************************************************************/
+bool Adafruit_BME280::readAll(int32_t *temperature, uint32_t *pressure, uint32_t *humidity)
+{
+    uint8_t data[BME280_DATA_LENGTH];
+
+    readBurst(BME280_REGISTER_PRESSUREDATA, data, BME280_DATA_LENGTH);
+
+    int32_t adc_P = ((uint32_t)data[0] << 12) | ((uint32_t)data[1] << 4) | (data[2] >> 4);
+    int32_t adc_T = ((uint32_t)data[3] << 12) | ((uint32_t)data[4] << 4) | (data[5] >> 4);
+    int32_t adc_H = ((uint32_t)data[6] << 8)  | data[7];
+
+    // values in case a measurement was disabled, t_fine needs the temperature
+    if (adc_T == 0x80000)
+        return false;
+
+    *temperature = compensateTemperature(adc_T);
+    *pressure    = adc_P == 0x80000 ? 0 : compensatePressure(adc_P);
+    *humidity    = adc_H == 0x8000  ? 0 : compensateHumidity(adc_H);
+    return true;
 }
 
 
@@ -80,6 +80,15 @@
         BME280_REGISTER_HUMIDDATA          = 0xFD
     };
 
+/**************************************************************************/
+/*! 
+    @brief Burst read lengths
+*/
+/**************************************************************************/
+    #define BME280_CALIB_TP_LENGTH        26  ///< 0x88-0xA1: temperature, pressure and H1
+    #define BME280_CALIB_H_LENGTH         7   ///< 0xE1-0xE7: remaining humidity values
+    #define BME280_DATA_LENGTH            8   ///< 0xF7-0xFE: pressure, temperature, humidity
+
 /**************************************************************************/
 /*! 
     @brief  calibration data
@@ -202,6 +211,9 @@ class Adafruit_BME280 {
 		bool begin(uint8_t addr);
         bool begin(uint8_t addr, TwoWire *theWire);
 		bool init();
+        bool beginForced(const bme280_calib_data *calib = NULL,
+                         uint8_t addr = BME280_ADDRESS, TwoWire *theWire = &Wire);
+        const bme280_calib_data &getCalibration(void);
 
 	void setSampling(sensor_mode mode              = MODE_NORMAL,
 			 sensor_sampling tempSampling  = SAMPLING_X16,
@@ -212,6 +224,11 @@ class Adafruit_BME280 {
 			 );
                    
         void takeForcedMeasurement();
+        bool measureAll(int32_t *temperature, uint32_t *pressure, uint32_t *humidity);
+        void startMeasurement(void);
+        bool isMeasuring(void);
+        bool readAll(int32_t *temperature, uint32_t *pressure, uint32_t *humidity);
+        float getMeasurementTimeMs(void);
         float readTemperature(void);
         float readPressure(void);
         float readHumidity(void);
@@ -233,6 +250,11 @@ class Adafruit_BME280 {
         int16_t   readS16(byte reg);
         uint16_t  read16_LE(byte reg); // little endian
         int16_t   readS16_LE(byte reg); // little endian
+        void      readBurst(byte reg, uint8_t *buffer, uint8_t len);
+
+        int32_t   compensateTemperature(int32_t adc_T);
+        uint32_t  compensatePressure(int32_t adc_P);
+        uint32_t  compensateHumidity(int32_t adc_H);
 
         uint8_t   _i2caddr;
         int32_t   _sensorID;
@@ -23,6 +23,7 @@
   typedef TinyGsmSim800 TinyGsm;
   typedef TinyGsmSim800::GsmClient TinyGsmClient;
   typedef TinyGsmSim800::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim800::GsmClientUdp TinyGsmClientUdp;
 
 #elif defined(TINY_GSM_MODEM_SIM808) || defined(TINY_GSM_MODEM_SIM868)
   #define TINY_GSM_MODEM_HAS_GPRS
@@ -30,6 +31,7 @@
   typedef TinyGsmSim808 TinyGsm;
   typedef TinyGsmSim808::GsmClient TinyGsmClient;
   typedef TinyGsmSim808::GsmClientSecure TinyGsmClientSecure;
+  typedef TinyGsmSim808::GsmClientUdp TinyGsmClientUdp;
 
 #elif defined(TINY_GSM_MODEM_UBLOX)
   #define TINY_GSM_MODEM_HAS_GPRS
@@ -16,8 +16,24 @@
   #define TINY_GSM_RX_BUFFER 64
 #endif
 
+#if !defined(TINY_GSM_TX_BUFFER)
+  #define TINY_GSM_TX_BUFFER 64
+#endif
+
+#if !defined(TINY_GSM_TX_TIMEOUT)
+  #define TINY_GSM_TX_TIMEOUT 100
+#endif
+
+#if !defined(TINY_GSM_SEND_MAX)
+  #define TINY_GSM_SEND_MAX 1460
+#endif
+
 #define TINY_GSM_MUX_COUNT 5
 
+#if !defined(TINY_GSM_SMS_QUEUE)
+  #define TINY_GSM_SMS_QUEUE 4
+#endif
+
 #include <TinyGsmCommon.h>
 
 #define GSM_NL "\r\n"
@@ -69,6 +85,9 @@ public:
     prev_check = 0;
     sock_connected = false;
     got_data = false;
+    tx_len = 0;
+    tx_since = 0;
+    send_count = 0;
 
     at->sockets[mux] = this;
 
@@ -98,16 +117,46 @@ public:
 
   virtual void stop() {
     TINY_GSM_YIELD();
+    if (sock_connected) {
+      sendTx();
+    }
+    tx_len = 0;
     at->sendAT(GF("+CIPCLOSE="), mux);
     sock_connected = false;
     at->waitResponse();
     rx.clear();
   }
 
+  // Small writes are collected and sent with one +CIPSEND.
+  // The buffer is sent when it is full, too old, before reading and on flush().
+  // Large writes are sent directly in chunks of at most TINY_GSM_SEND_MAX.
+  // If a buffered send fails the socket is marked as disconnected, so the
+  // caller sees the loss with connected().
   virtual size_t write(const uint8_t *buf, size_t size) {
     TINY_GSM_YIELD();
-    at->maintain();
-    return at->modemSend(buf, size, mux);
+    if (tx_len && (tx_len + size > sizeof(tx) || isTxStale())) {
+      if (!sendTx()) {
+        return 0;
+      }
+    }
+    if (size >= sizeof(tx)) {
+      size_t sent = 0;
+      while (sent < size) {
+        size_t chunk = TinyGsmMin(size - sent, (size_t) TINY_GSM_SEND_MAX);
+        size_t rc    = modemSend(buf + sent, chunk);
+        sent += rc;
+        if (rc != chunk) {
+          break;
+        }
+      }
+      return sent;
+    }
+    if (!tx_len) {
+      tx_since = millis();
+    }
+    memcpy(tx + tx_len, buf, size);
+    tx_len += size;
+    return size;
   }
 
   virtual size_t write(uint8_t c) {
@@ -121,6 +170,7 @@ public:
 
   virtual int available() {
     TINY_GSM_YIELD();
+    sendTx();
     if (!rx.size() && sock_connected) {
       // Workaround: sometimes SIM800 forgets to notify about data arrival.
       // TODO: Currently we ping the module periodically,
@@ -136,7 +186,7 @@ public:
 
   virtual int read(uint8_t *buf, size_t size) {
     TINY_GSM_YIELD();
-    at->maintain();
+    sendTx();
     size_t cnt = 0;
     while (cnt < size && sock_connected) {
       size_t chunk = TinyGsmMin(size-cnt, rx.size());
@@ -146,7 +196,6 @@ public:
         cnt += chunk;
         continue;
       }
-      // TODO: Read directly into user buffer?
       at->maintain();
       if (sock_available > 0) {
         at->modemRead(rx.free(), mux);
@@ -166,7 +215,10 @@ public:
   }
 
   virtual int peek() { return -1; } //TODO
-  virtual void flush() { at->stream.flush(); }
+  virtual void flush() {
+    sendTx();
+    at->stream.flush();
+  }
 
   virtual uint8_t connected() {
     if (available()) {
@@ -182,6 +234,32 @@ public:
 
   String remoteIP() TINY_GSM_ATTR_NOT_IMPLEMENTED;
 
+  // Number of +CIPSEND transactions since init()
+  uint32_t getSendCount() { return send_count; }
+
+  // Are there buffered bytes older than TINY_GSM_TX_TIMEOUT?
+  bool isTxStale() { return tx_len && millis() - tx_since > TINY_GSM_TX_TIMEOUT; }
+
+private:
+  size_t modemSend(const uint8_t *buf, size_t size) {
+    at->maintain();
+    send_count++;
+    return at->modemSend(buf, size, mux);
+  }
+
+  bool sendTx() {
+    if (!tx_len) {
+      return true;
+    }
+    size_t len = tx_len;
+    tx_len = 0;
+    if (modemSend(tx, len) != len) {
+      sock_connected = false;
+      return false;
+    }
+    return true;
+  }
+
 private:
   TinyGsmSim800* at;
   uint8_t        mux;
@@ -190,6 +268,10 @@ private:
   bool           sock_connected;
   bool           got_data;
   RxFifo         rx;
+  uint8_t        tx[TINY_GSM_TX_BUFFER];
+  size_t         tx_len;
+  uint32_t       tx_since;
+  uint32_t       send_count;
 };
 
 class GsmClientSecure : public GsmClient
@@ -211,10 +293,33 @@ public:
   }
 };
 
+class GsmClientUdp : public GsmClient
+{
+public:
+  GsmClientUdp() {}
+
+  GsmClientUdp(TinyGsmSim800& modem, uint8_t mux = 1)
+    : GsmClient(modem, mux)
+  {}
+
+public:
+  // Every write() followed by flush() leaves the modem as one datagram
+  virtual int connect(const char *host, uint16_t port) {
+    stop();
+    TINY_GSM_YIELD();
+    rx.clear();
+    sock_connected = at->modemConnect(host, port, mux, false, true);
+    return sock_connected;
+  }
+};
+
 public:
 
   TinyGsmSim800(Stream& stream)
     : stream(stream)
+    , sms_new_count(0)
+    , ftp_get_result(-1)
+    , ftp_get_size(0)
   {
     memset(sockets, 0, sizeof(sockets));
   }
@@ -260,6 +365,9 @@ public:
   void maintain() {
     for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
       GsmClient* sock = sockets[mux];
+      if (sock && sock->sock_connected && sock->isTxStale()) {
+        sock->sendTx();
+      }
       if (sock && sock->got_data) {
         sock->got_data = false;
         sock->sock_available = modemGetAvailable(mux);
@@ -678,6 +786,43 @@ public:
     }
   }
 
+  // Text mode and +CMTI: "SM",<index> URC on new messages
+  bool setNewSmsIndication() {
+    sendAT(GF("+CMGF=1"));
+    if (waitResponse() != 1) {
+      return false;
+    }
+    sendAT(GF("+CNMI=2,1,0,0,0"));
+    return waitResponse() == 1;
+  }
+
+  bool hasNewSms() {
+    return sms_new_count > 0;
+  }
+
+  // Index of the oldest indicated message or -1
+  int getNewSmsIndex() {
+    if (!sms_new_count) {
+      return -1;
+    }
+    int index = sms_new[0];
+    sms_new_count--;
+    memmove(sms_new, sms_new + 1, sms_new_count * sizeof(sms_new[0]));
+    return index;
+  }
+
+  /*
+   * FTP functions
+   */
+
+  // Result of the last +FTPGETTOFS: <result>[,<size>] URC or -1
+  int getFtpGetResult(long& size) {
+    int result = ftp_get_result;
+    size = ftp_get_size;
+    ftp_get_result = -1;
+    return result;
+  }
+
   bool sendSMS(const String& number, const String& text) {
     sendAT(GF("+CMGF=1"));
     waitResponse();
@@ -793,7 +938,7 @@ public:
 
 protected:
 
-  bool modemConnect(const char* host, uint16_t port, uint8_t mux, bool ssl = false) {
+  bool modemConnect(const char* host, uint16_t port, uint8_t mux, bool ssl = false, bool udp = false) {
     int rsp;
 #if !defined(TINY_GSM_MODEM_SIM900)
     sendAT(GF("+CIPSSL="), ssl);
@@ -802,7 +947,11 @@ protected:
       return false;
     }
 #endif
-    sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port);
+    if (udp) {
+      sendAT(GF("+CIPSTART="), mux, ',', GF("\"UDP"), GF("\",\""), host, GF("\","), port);
+    } else {
+      sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port);
+    }
     rsp = waitResponse(75000L,
                        GF("CONNECT OK" GSM_NL),
                        GF("CONNECT FAIL" GSM_NL),
@@ -844,26 +993,35 @@ protected:
     size_t len = stream.readStringUntil(',').toInt();
     sockets[mux]->sock_available = stream.readStringUntil('\n').toInt();
 
-    for (size_t i=0; i<len; i++) {
 #ifdef TINY_GSM_USE_HEX
+    for (size_t i=0; i<len; i++) {
       while (stream.available() < 2) { TINY_GSM_YIELD(); }
       char buf[4] = { 0, };
       buf[0] = stream.read();
       buf[1] = stream.read();
       char c = strtol(buf, NULL, 16);
+      sockets[mux]->rx.put(c);
+    }
 #else
-// Original!!!
-//      while (!stream.available()) { TINY_GSM_YIELD(); }
-//      char c = stream.read();
-// Ebby Neu
-       char c = stream.read();
-       if (c == -1) {
-          return i;
-       }
-// Ende
+    // Copy the data segment by segment straight into the free space of the fifo
+    size_t cnt = 0;
+    while (cnt < len) {
+      int n;
+      uint8_t* span = sockets[mux]->rx.reserve(n);
+      if (n <= 0) {
+        break;
+      }
+      if ((size_t)n > len - cnt) {
+        n = len - cnt;
+      }
+      size_t got = stream.readBytes((char*)span, n);
+      sockets[mux]->rx.commit(got);
+      cnt += got;
+      if (got < (size_t)n) {
+        return cnt;
+      }
+    }
 #endif
-       sockets[mux]->rx.put(c);
-  }
     waitResponse();
     return len;
   }
@@ -971,6 +1129,21 @@ public:
           } else {
             data += mode;
           }
+        } else if (data.endsWith(GF(GSM_NL "+CMTI:"))) {
+          streamSkipUntil(',');
+          int index = stream.readStringUntil('\n').toInt();
+          if (sms_new_count < TINY_GSM_SMS_QUEUE) {
+            sms_new[sms_new_count++] = index;
+          }
+          data = "";
+          DBG("### New SMS: ", index);
+        } else if (data.endsWith(GF(GSM_NL "+FTPGETTOFS:"))) {
+          String result = stream.readStringUntil('\n');
+          int comma = result.indexOf(',');
+          ftp_get_result = result.toInt();
+          ftp_get_size = comma >= 0 ? result.substring(comma + 1).toInt() : 0;
+          data = "";
+          DBG("### FTP get: ", ftp_get_result);
         } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
           int nl = data.lastIndexOf(GSM_NL, data.length()-8);
           int coma = data.indexOf(',', nl+2);
@@ -1013,6 +1186,10 @@ public:
 
 protected:
   GsmClient*    sockets[TINY_GSM_MUX_COUNT];
+  int           sms_new[TINY_GSM_SMS_QUEUE];
+  uint8_t       sms_new_count;
+  int           ftp_get_result;
+  long          ftp_get_size;
 };
 
 #endif
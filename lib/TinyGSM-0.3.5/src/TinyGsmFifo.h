@@ -69,6 +69,23 @@ public:
         return n - c;
     }
 
+    // contiguous free space to be filled directly, e.g. by Stream::readBytes()
+    T* reserve(int& n)
+    {
+        int f = free();
+        int m = N - _w;
+        // check wrap
+        if (f > m) f = m;
+        n = f;
+        return &_b[_w];
+    }
+
+    // make n elements of the reserved space readable
+    void commit(int n)
+    {
+        _w = _inc(_w, n);
+    }
+
     // reading thread/context API
     // --------------------------------------------------------
 
@@ -24,10 +24,11 @@ DS2438::DS2438(OneWire *ow, uint8_t *address) {
 };
 
 void DS2438::begin(uint8_t mode) {
-    _mode = mode & (DS2438_MODE_CHA | DS2438_MODE_CHB | DS2438_MODE_TEMPERATURE);
+    _mode = mode & (DS2438_MODE_CHA | DS2438_MODE_CHB | DS2438_MODE_TEMPERATURE | DS2438_MODE_CURRENT);
     _temperature = 0;
     _voltageA = 0.0;
     _voltageB = 0.0;
+    _current = 0;
     _error = true;
     _timestamp = 0;
 }
@@ -51,6 +52,9 @@ void DS2438::update() {
         if (_mode & DS2438_MODE_CHA) {
             _voltageA = (((data[4] << 8) & 0x00300) | (data[3] & 0x0ff)) / 100.0;
         }
+        if (_mode & DS2438_MODE_CURRENT) {
+            _current = (int16_t)((data[6] << 8) | data[5]);
+        }
     }
     if (_mode & DS2438_MODE_CHB) {
         boolean doTemperature = _mode & DS2438_MODE_TEMPERATURE && !(_mode & DS2438_MODE_CHA);
@@ -67,6 +71,52 @@ void DS2438::update() {
     _error = false;
 }
 
+// Asynchronous alternative to update(): start the conversions one after
+// the other and read the results after the conversion delays instead of
+// waiting here.
+boolean DS2438::startTemperatureConversion() {
+    if (!_ow->reset())
+        return false;
+    _ow->select(_address);
+    _ow->write(DS2438_TEMPERATURE_CONVERSION_COMMAND, 0);
+    return true;
+}
+
+boolean DS2438::startVoltageConversion(int channel) {
+    if (!selectChannel(channel))
+        return false;
+    _ow->reset();
+    _ow->select(_address);
+    _ow->write(DS2438_VOLTAGE_CONVERSION_COMMAND, 0);
+    return true;
+}
+
+boolean DS2438::readConversion(int channel) {
+    uint8_t data[9];
+
+    _error = true;
+    _timestamp = millis();
+    if (!readPageZero(data))
+        return false;
+    decodePageZero(data, channel, _mode & DS2438_MODE_TEMPERATURE);
+    _error = false;
+    return true;
+}
+
+void DS2438::decodePageZero(uint8_t *data, int channel, boolean doTemperature) {
+    if (doTemperature) {
+        _temperature = (double)(((((int16_t)data[2]) << 8) | (data[1] & 0x0ff)) >> 3) * 0.03125;
+    }
+    if (channel == DS2438_CHA) {
+        _voltageA = (((data[4] << 8) & 0x00300) | (data[3] & 0x0ff)) / 100.0;
+    } else {
+        _voltageB = (((data[4] << 8) & 0x00300) | (data[3] & 0x0ff)) / 100.0;
+    }
+    if (_mode & DS2438_MODE_CURRENT) {
+        _current = (int16_t)((data[6] << 8) | data[5]);
+    }
+}
+
 double DS2438::getTemperature() {
     return _temperature;
 }
@@ -81,6 +131,11 @@ float DS2438::getVoltage(int channel) {
     }
 }
 
+// Current through the sense resistor in A (positive = charging).
+float DS2438::getCurrent(float senseResistor) {
+    return _current / (4096.0 * senseResistor);
+}
+
 boolean DS2438::isError() {
     return _error;
 }
@@ -109,9 +164,12 @@ boolean DS2438::selectChannel(int channel) {
     uint8_t data[9];
     if (readPageZero(data)) {
         if (channel == DS2438_CHB)
-            data[0] = data[0] | 0x08;
+            data[0] = data[0] | DS2438_CONFIG_AD;
         else
-            data[0] = data[0] & 0xf7;
+            data[0] = data[0] & ~DS2438_CONFIG_AD;
+        // the current A/D converts continuously while IAD is set
+        if (_mode & DS2438_MODE_CURRENT)
+            data[0] = data[0] | DS2438_CONFIG_IAD;
         writePageZero(data);
         return true;
     }
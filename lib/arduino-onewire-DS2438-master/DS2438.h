@@ -36,6 +36,10 @@
 #define DS2438_MODE_CHA 0x01
 #define DS2438_MODE_CHB 0x02
 #define DS2438_MODE_TEMPERATURE 0x04
+#define DS2438_MODE_CURRENT 0x08
+
+#define DS2438_CONFIG_IAD 0x01
+#define DS2438_CONFIG_AD 0x08
 
 #define DS2438_TEMPERATURE_DELAY 10
 #define DS2438_VOLTAGE_CONVERSION_DELAY 8
@@ -45,8 +49,12 @@ class DS2438 {
         DS2438(OneWire *ow, uint8_t *address);
         void begin(uint8_t mode=(DS2438_MODE_CHA | DS2438_MODE_CHB | DS2438_MODE_TEMPERATURE));
         void update();
+        boolean startTemperatureConversion();
+        boolean startVoltageConversion(int channel=DS2438_CHA);
+        boolean readConversion(int channel=DS2438_CHA);
         double getTemperature();
         float getVoltage(int channel=DS2438_CHA);
+        float getCurrent(float senseResistor);
         boolean isError();
         unsigned long getTimestamp();
     private:
@@ -56,12 +64,14 @@ class DS2438 {
         double _temperature;
         float _voltageA;
         float _voltageB;
+        int16_t _current;
         unsigned long _timestamp;
         boolean _error;
         boolean startConversion(int channel, boolean doTemperature);
         boolean selectChannel(int channel);
         void writePageZero(uint8_t *data);
         boolean readPageZero(uint8_t *data);
+        void decodePageZero(uint8_t *data, int channel, boolean doTemperature);
 };
 
 #endif
@@ -0,0 +1,54 @@
+/*
+ MqttSnClient.cpp - A minimal MQTT-SN publisher for datagram clients.
+*/
+
+#include "MqttSnClient.h"
+#include "Arduino.h"
+
+MqttSnClient::MqttSnClient(Client& client) {
+    this->_client = &client;
+    this->domain = NULL;
+    this->port = 0;
+}
+
+MqttSnClient& MqttSnClient::setServer(const char* domain, uint16_t port) {
+    this->domain = domain;
+    this->port = port;
+    return *this;
+}
+
+boolean MqttSnClient::publish(uint16_t topicId, const char* payload, boolean retained) {
+    return publish(topicId,(const uint8_t*)payload,strlen(payload),retained);
+}
+
+boolean MqttSnClient::publish(uint16_t topicId, const uint8_t* payload, unsigned int plength, boolean retained) {
+    uint16_t length = MQTTSN_HEADER_LENGTH + plength;
+    if (length > MQTT_SN_MAX_PACKET_SIZE || length > 255) {
+        // Too long
+        return false;
+    }
+    if (!_client->connected()) {
+        // Only selects the gateway address, nothing is sent
+        if (domain == NULL || !_client->connect(domain, port)) {
+            return false;
+        }
+    }
+    uint16_t pos = 0;
+    buffer[pos++] = length;
+    buffer[pos++] = MQTTSN_PUBLISH;
+    buffer[pos++] = MQTTSN_FLAG_QOS_M1 | MQTTSN_TOPIC_PREDEFINED | (retained ? MQTTSN_FLAG_RETAIN : 0);
+    buffer[pos++] = (topicId >> 8);
+    buffer[pos++] = (topicId & 0xFF);
+    buffer[pos++] = 0;   // message id is not used with QoS -1
+    buffer[pos++] = 0;
+    memcpy(buffer+pos,payload,plength);
+
+    uint16_t rc = _client->write(buffer,length);
+    // A buffering client sends on flush() and drops the socket if that fails
+    _client->flush();
+    return rc == length && _client->connected();
+}
+
+void MqttSnClient::stop() {
+    _client->stop();
+}
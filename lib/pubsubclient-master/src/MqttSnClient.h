@@ -0,0 +1,42 @@
+/*
+ MqttSnClient.h - A minimal MQTT-SN publisher for datagram clients.
+*/
+
+#ifndef MqttSnClient_h
+#define MqttSnClient_h
+
+#include <Arduino.h>
+#include "Client.h"
+
+// MQTT_SN_MAX_PACKET_SIZE : Maximum datagram size (one byte length field)
+#ifndef MQTT_SN_MAX_PACKET_SIZE
+#define MQTT_SN_MAX_PACKET_SIZE 128
+#endif
+
+#define MQTTSN_PUBLISH          0x0C    // Publish message
+
+#define MQTTSN_FLAG_RETAIN      0x10
+#define MQTTSN_FLAG_QOS_M1      0x60    // QoS -1: publish without a connection
+#define MQTTSN_TOPIC_PREDEFINED 0x01    // Topic id registered in the gateway
+
+#define MQTTSN_HEADER_LENGTH    7       // Length, type, flags, topic id and message id
+
+// Sends every message as one datagram with a pre-defined topic id.
+// Neither a CONNECT nor a REGISTER is needed, the gateway knows the topic ids.
+class MqttSnClient {
+private:
+   Client* _client;
+   const char* domain;
+   uint16_t port;
+   uint8_t buffer[MQTT_SN_MAX_PACKET_SIZE];
+public:
+   MqttSnClient(Client& client);
+
+   MqttSnClient& setServer(const char* domain, uint16_t port);
+
+   boolean publish(uint16_t topicId, const char* payload, boolean retained);
+   boolean publish(uint16_t topicId, const uint8_t* payload, unsigned int plength, boolean retained);
+   void stop();
+};
+
+#endif
@@ -9,6 +9,7 @@
 
 PubSubClient::PubSubClient() {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     this->_client = NULL;
     this->stream = NULL;
     setCallback(NULL);
@@ -16,24 +17,28 @@ PubSubClient::PubSubClient() {
 
 PubSubClient::PubSubClient(Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setClient(client);
     this->stream = NULL;
 }
 
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(addr, port);
     setClient(client);
     this->stream = NULL;
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(addr,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(addr, port);
     setCallback(callback);
     setClient(client);
@@ -41,6 +46,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(addr,port);
     setCallback(callback);
     setClient(client);
@@ -49,18 +55,21 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
 
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(ip, port);
     setClient(client);
     this->stream = NULL;
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(ip,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(ip, port);
     setCallback(callback);
     setClient(client);
@@ -68,6 +77,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(ip,port);
     setCallback(callback);
     setClient(client);
@@ -76,18 +86,21 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
 
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(domain,port);
     setClient(client);
     this->stream = NULL;
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(domain,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(domain,port);
     setCallback(callback);
     setClient(client);
@@ -95,6 +108,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGN
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initClient();
     setServer(domain,port);
     setCallback(callback);
     setClient(client);
@@ -141,9 +155,12 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 
             uint8_t v;
             if (willTopic) {
-                v = 0x06|(willQos<<3)|(willRetain<<5);
+                v = 0x04|(willQos<<3)|(willRetain<<5);
             } else {
-                v = 0x02;
+                v = 0x00;
+            }
+            if (cleanSession) {
+                v = v|0x02;
             }
 
             if(user != NULL) {
@@ -156,8 +173,8 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 
             buffer[length++] = v;
 
-            buffer[length++] = ((MQTT_KEEPALIVE) >> 8);
-            buffer[length++] = ((MQTT_KEEPALIVE) & 0xFF);
+            buffer[length++] = (keepAlive >> 8);
+            buffer[length++] = (keepAlive & 0xFF);
             length = writeString(id,buffer,length);
             if (willTopic) {
                 length = writeString(willTopic,buffer,length);
@@ -188,9 +205,16 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
 
             if (len == 4) {
                 if (buffer[3] == 0) {
+                    _sessionPresent = buffer[2] & 0x01;
                     lastInActivity = millis();
                     pingOutstanding = false;
                     _state = MQTT_CONNECTED;
+                    // Retransmit the publishes which are not acknowledged yet
+                    for (uint8_t i = 0;i<MQTT_MAX_INFLIGHT;i++) {
+                        if (inflightLength[i]) {
+                            sendInflight(i);
+                        }
+                    }
                     return true;
                 } else {
                     _state = buffer[3];
@@ -214,7 +238,12 @@ boolean PubSubClient::readByte(uint8_t * result) {
        return false;
      }
    }
-   *result = _client->read();
+   int c = _client->read();
+   if (c < 0) {
+     // The socket reports data but has nothing to read (i.e. it is closed)
+     return false;
+   }
+   *result = c;
    return true;
 }
 
@@ -229,6 +258,29 @@ boolean PubSubClient::readByte(uint8_t * result, uint16_t * index){
   return false;
 }
 
+// reads count bytes into result[*index] with as few client reads as possible.
+// Fails on a timeout or if the client reports data but reads nothing (closed socket).
+boolean PubSubClient::readBytes(uint8_t * result, uint16_t * index, uint16_t count) {
+  uint16_t end = *index + count;
+  uint32_t previousMillis = millis();
+  while (*index < end) {
+    int avail = _client->available();
+    if (avail > 0) {
+      uint16_t chunk = (avail < end - *index) ? avail : end - *index;
+      int rc = _client->read(result + *index, chunk);
+      if (rc <= 0) {
+        return false;
+      }
+      *index += rc;
+      previousMillis = millis();
+    }
+    if (millis() - previousMillis >= ((int32_t) MQTT_SOCKET_TIMEOUT * 1000)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 uint16_t PubSubClient::readPacket(uint8_t* lengthLength) {
     uint16_t len = 0;
     if(!readByte(buffer, &len)) return 0;
@@ -265,17 +317,22 @@ uint16_t PubSubClient::readPacket(uint8_t* lengthLength) {
         }
     }
 
-    for (uint16_t i = start;i<length;i++) {
-        if(!readByte(&digit)) return 0;
-        if (this->stream) {
-            if (isPublish && len-*lengthLength-2>skip) {
-                this->stream->write(digit);
+    if (!this->stream && len + length - start <= MQTT_MAX_PACKET_SIZE) {
+        // The rest of the packet fits into the buffer
+        if(!readBytes(buffer, &len, length - start)) return 0;
+    } else {
+        for (uint16_t i = start;i<length;i++) {
+            if(!readByte(&digit)) return 0;
+            if (this->stream) {
+                if (isPublish && len-*lengthLength-2>skip) {
+                    this->stream->write(digit);
+                }
             }
+            if (len < MQTT_MAX_PACKET_SIZE) {
+                buffer[len] = digit;
+            }
+            len++;
         }
-        if (len < MQTT_MAX_PACKET_SIZE) {
-            buffer[len] = digit;
-        }
-        len++;
     }
 
     if (!this->stream && len > MQTT_MAX_PACKET_SIZE) {
@@ -288,11 +345,14 @@ uint16_t PubSubClient::readPacket(uint8_t* lengthLength) {
 boolean PubSubClient::loop() {
     if (connected()) {
         unsigned long t = millis();
-        if ((t - lastInActivity > MQTT_KEEPALIVE*1000UL) || (t - lastOutActivity > MQTT_KEEPALIVE*1000UL)) {
+        if ((t - lastInActivity > keepAlive*1000UL) || (t - lastOutActivity > keepAlive*1000UL)) {
             if (pingOutstanding) {
-                this->_state = MQTT_CONNECTION_TIMEOUT;
-                _client->stop();
-                return false;
+                // A late caller may find the response already waiting
+                if (!_client->available()) {
+                    this->_state = MQTT_CONNECTION_TIMEOUT;
+                    _client->stop();
+                    return false;
+                }
             } else {
                 buffer[0] = MQTTPINGREQ;
                 buffer[1] = 0;
@@ -340,6 +400,8 @@ boolean PubSubClient::loop() {
                     _client->write(buffer,2);
                 } else if (type == MQTTPINGRESP) {
                     pingOutstanding = false;
+                } else if (type == MQTTPUBACK) {
+                    ackInflight((buffer[llen+1]<<8)+buffer[llen+2]);
                 }
             } else if (!connected()) {
                 // readPacket has closed the connection
@@ -385,6 +447,59 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
     return false;
 }
 
+boolean PubSubClient::publish(const char* topic, const char* payload, boolean retained, uint8_t qos) {
+    return publish(topic,(const uint8_t*)payload,strlen(payload),retained,qos);
+}
+
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained, uint8_t qos) {
+    if (qos == 0) {
+        return publish(topic,payload,plength,retained);
+    }
+    if (qos > 1) {
+        return false;
+    }
+    if (MQTT_MAX_PACKET_SIZE < 5 + 2+strlen(topic) + 2 + plength) {
+        // Too long
+        return false;
+    }
+    // Collect the acknowledgements which are already waiting
+    while (inflightCount() >= inflightWindow && connected() && _client->available()) {
+        if (!loop()) {
+            break;
+        }
+    }
+    if (inflightCount() >= inflightWindow) {
+        // Window is full
+        return false;
+    }
+    uint8_t slot = 0;
+    while (inflightLength[slot]) {
+        slot++;
+    }
+    uint16_t msgId = nextId();
+    uint16_t length = 5;
+    length = writeString(topic,buffer,length);
+    buffer[length++] = (msgId >> 8);
+    buffer[length++] = (msgId & 0xFF);
+    uint16_t i;
+    for (i=0;i<plength;i++) {
+        buffer[length++] = payload[i];
+    }
+    uint8_t header = MQTTPUBLISH|MQTTQOS1;
+    if (retained) {
+        header |= 1;
+    }
+    uint8_t llen = writeHeader(header,buffer,length-5);
+    inflightLength[slot] = length-5+1+llen;
+    inflightId[slot] = msgId;
+    memcpy(inflight[slot],buffer+(4-llen),inflightLength[slot]);
+    // Without a connection the publish is queued until the next connect
+    if (connected()) {
+        return sendInflight(slot);
+    }
+    return true;
+}
+
 boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
     uint8_t llen = 0;
     uint8_t digit;
@@ -430,13 +545,67 @@ boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsig
     return rc == tlen + 4 + plength;
 }
 
-boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
+boolean PubSubClient::beginPublish(const char* topic, uint32_t plength, boolean retained) {
+    if (connected()) {
+        if (MQTT_MAX_PACKET_SIZE < 5 + 2+strlen(topic)) {
+            // Too long
+            return false;
+        }
+        // Only the fixed header and the topic go through the buffer
+        uint16_t length = 5;
+        length = writeString(topic,buffer,length);
+        if (plength > (uint32_t)MQTT_MAX_REMAINING_LENGTH - (uint32_t)(length-5)) {
+            // The remaining length does not fit into the header
+            return false;
+        }
+        uint8_t header = MQTTPUBLISH;
+        if (retained) {
+            header |= 1;
+        }
+        uint8_t llen = writeHeader(header,buffer,length-5+plength);
+        publishRemaining = plength;
+        return writeRaw(buffer+(4-llen),length-5+1+llen);
+    }
+    return false;
+}
+
+// Bytes beyond the length announced with beginPublish are rejected
+size_t PubSubClient::write(uint8_t c) {
+    if (publishRemaining == 0) {
+        return 0;
+    }
+    lastOutActivity = millis();
+    size_t rc = _client->write(c);
+    publishRemaining -= rc;
+    return rc;
+}
+
+size_t PubSubClient::write(const uint8_t* buf, size_t size) {
+    if (size > publishRemaining) {
+        size = publishRemaining;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    lastOutActivity = millis();
+    size_t rc = _client->write(buf,size);
+    publishRemaining -= rc;
+    return rc;
+}
+
+// Checks that the whole announced payload is written
+boolean PubSubClient::endPublish() {
+    boolean rc = (publishRemaining == 0);
+    publishRemaining = 0;
+    return rc && connected();
+}
+
+uint8_t PubSubClient::writeHeader(uint8_t header, uint8_t* buf, uint32_t length) {
     uint8_t lenBuf[4];
     uint8_t llen = 0;
     uint8_t digit;
     uint8_t pos = 0;
-    uint16_t rc;
-    uint16_t len = length;
+    uint32_t len = length;
     do {
         digit = len % 128;
         len = len / 128;
@@ -451,10 +620,19 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
     for (int i=0;i<llen;i++) {
         buf[5-llen+i] = lenBuf[i];
     }
+    return llen;
+}
+
+boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
+    uint8_t llen = writeHeader(header,buf,length);
+    return writeRaw(buf+(4-llen),length+1+llen);
+}
 
+boolean PubSubClient::writeRaw(const uint8_t* buf, uint16_t length) {
+    uint16_t rc;
 #ifdef MQTT_MAX_TRANSFER_SIZE
-    uint8_t* writeBuf = buf+(4-llen);
-    uint16_t bytesRemaining = length+1+llen;  //Match the length type
+    const uint8_t* writeBuf = buf;
+    uint16_t bytesRemaining = length;  //Match the length type
     uint8_t bytesToWrite;
     boolean result = true;
     while((bytesRemaining > 0) && result) {
@@ -464,11 +642,12 @@ boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
         bytesRemaining -= rc;
         writeBuf += rc;
     }
+    lastOutActivity = millis();
     return result;
 #else
-    rc = _client->write(buf+(4-llen),length+1+llen);
+    rc = _client->write(buf,length);
     lastOutActivity = millis();
-    return (rc == 1+llen+length);
+    return (rc == length);
 #endif
 }
 
@@ -487,10 +666,7 @@ boolean PubSubClient::subscribe(const char* topic, uint8_t qos) {
     if (connected()) {
         // Leave room in the buffer for header and variable length field
         uint16_t length = 5;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
-        }
+        nextId();
         buffer[length++] = (nextMsgId >> 8);
         buffer[length++] = (nextMsgId & 0xFF);
         length = writeString((char*)topic, buffer,length);
@@ -507,10 +683,7 @@ boolean PubSubClient::unsubscribe(const char* topic) {
     }
     if (connected()) {
         uint16_t length = 5;
-        nextMsgId++;
-        if (nextMsgId == 0) {
-            nextMsgId = 1;
-        }
+        nextId();
         buffer[length++] = (nextMsgId >> 8);
         buffer[length++] = (nextMsgId & 0xFF);
         length = writeString(topic, buffer,length);
@@ -595,3 +768,130 @@ PubSubClient& PubSubClient::setStream(Stream& stream){
 int PubSubClient::state() {
     return this->_state;
 }
+
+void PubSubClient::initClient() {
+    for (uint8_t i = 0;i<MQTT_MAX_INFLIGHT;i++) {
+        inflightLength[i] = 0;
+        inflightId[i] = 0;
+    }
+    inflightWindow = MQTT_MAX_INFLIGHT;
+    publishRemaining = 0;
+    keepAlive = MQTT_KEEPALIVE;
+    cleanSession = true;
+    _sessionPresent = false;
+    store = NULL;
+    nextMsgId = 1;
+}
+
+// Next message id which is not used by an unacknowledged publish
+uint16_t PubSubClient::nextId() {
+    boolean used;
+    do {
+        nextMsgId++;
+        if (nextMsgId == 0) {
+            nextMsgId = 1;
+        }
+        used = false;
+        for (uint8_t i = 0;i<MQTT_MAX_INFLIGHT;i++) {
+            if (inflightLength[i] && inflightId[i] == nextMsgId) {
+                used = true;
+            }
+        }
+    } while (used);
+    return nextMsgId;
+}
+
+// Every transmission after the first one is marked as duplicate
+boolean PubSubClient::sendInflight(uint8_t slot) {
+    boolean rc = writeRaw(inflight[slot],inflightLength[slot]);
+    inflight[slot][0] |= MQTTDUP;
+    return rc;
+}
+
+void PubSubClient::ackInflight(uint16_t msgId) {
+    for (uint8_t i = 0;i<MQTT_MAX_INFLIGHT;i++) {
+        if (inflightLength[i] && inflightId[i] == msgId) {
+            inflightLength[i] = 0;
+        }
+    }
+}
+
+// Message id of a stored QoS 1 publish packet behind the topic
+uint16_t PubSubClient::packetMsgId(const uint8_t* packet) {
+    uint16_t pos = 1;
+    while (packet[pos++] & 0x80) {
+    }
+    pos += 2 + ((packet[pos]<<8)+packet[pos+1]);
+    return (packet[pos]<<8)+packet[pos+1];
+}
+
+PubSubClient& PubSubClient::setInflightWindow(uint8_t window) {
+    if (window < 1) {
+        window = 1;
+    }
+    if (window > MQTT_MAX_INFLIGHT) {
+        window = MQTT_MAX_INFLIGHT;
+    }
+    this->inflightWindow = window;
+    return *this;
+}
+
+// Restores the unacknowledged publishes of the last run from the store
+PubSubClient& PubSubClient::setStore(PubSubStore& store) {
+    this->store = &store;
+    for (uint8_t i = 0;i<MQTT_MAX_INFLIGHT;i++) {
+        inflightLength[i] = store.load(i,inflight[i],MQTT_MAX_PACKET_SIZE);
+        if (inflightLength[i]) {
+            inflightId[i] = packetMsgId(inflight[i]);
+        }
+    }
+    return *this;
+}
+
+// Writes the current window into the store, the empty slots are removed
+void PubSubClient::saveInflight() {
+    if (!store) {
+        return;
+    }
+    for (uint8_t i = 0;i<MQTT_MAX_INFLIGHT;i++) {
+        if (inflightLength[i]) {
+            uint8_t header = inflight[i][0];
+            inflight[i][0] |= MQTTDUP;
+            store->save(i,inflight[i],inflightLength[i]);
+            inflight[i][0] = header;
+        } else {
+            store->remove(i);
+        }
+    }
+}
+
+PubSubClient& PubSubClient::setKeepAlive(uint16_t keepAlive) {
+    this->keepAlive = keepAlive;
+    return *this;
+}
+
+// Without a clean session the broker keeps the subscriptions between connections
+PubSubClient& PubSubClient::setCleanSession(boolean cleanSession) {
+    this->cleanSession = cleanSession;
+    return *this;
+}
+
+// Did the broker resume the session of the last connect?
+boolean PubSubClient::sessionPresent() {
+    return _sessionPresent;
+}
+
+// millis() of the last packet sent to or received from the broker
+unsigned long PubSubClient::lastActivity() {
+    return (long)(lastInActivity - lastOutActivity) > 0 ? lastInActivity : lastOutActivity;
+}
+
+uint8_t PubSubClient::inflightCount() {
+    uint8_t count = 0;
+    for (uint8_t i = 0;i<MQTT_MAX_INFLIGHT;i++) {
+        if (inflightLength[i]) {
+            count++;
+        }
+    }
+    return count;
+}
@@ -36,6 +36,14 @@
 #define MQTT_SOCKET_TIMEOUT 15
 #endif
 
+// MQTT_MAX_INFLIGHT : Maximum number of unacknowledged QoS 1 publishes
+#ifndef MQTT_MAX_INFLIGHT
+#define MQTT_MAX_INFLIGHT 4
+#endif
+
+// MQTT_MAX_REMAINING_LENGTH : Largest remaining length of a packet (4 byte varint)
+#define MQTT_MAX_REMAINING_LENGTH 268435455
+
 // MQTT_MAX_TRANSFER_SIZE : limit how much data is passed to the network client
 //  in each write call. Needed for the Arduino Wifi Shield. Leave undefined to
 //  pass the entire MQTT packet in each write call.
@@ -72,6 +80,7 @@
 #define MQTTQOS0        (0 << 1)
 #define MQTTQOS1        (1 << 1)
 #define MQTTQOS2        (2 << 1)
+#define MQTTDUP         (1 << 3)
 
 #ifdef ESP8266
 #include <functional>
@@ -80,6 +89,17 @@
 #define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
 #endif
 
+// Optional persistent storage of the unacknowledged QoS 1 publishes. The window
+// is kept in RAM and only written with saveInflight() (i.e. before a deep sleep).
+// A stored packet is replayed after a restart, so it is handed over with the DUP flag set.
+class PubSubStore {
+public:
+   virtual ~PubSubStore() {}
+   virtual void save(uint8_t slot, const uint8_t* packet, uint16_t length) = 0;
+   virtual void remove(uint8_t slot) = 0;
+   virtual uint16_t load(uint8_t slot, uint8_t* packet, uint16_t size) = 0;
+};
+
 class PubSubClient {
 private:
    Client* _client;
@@ -92,13 +112,30 @@ private:
    uint16_t readPacket(uint8_t*);
    boolean readByte(uint8_t * result);
    boolean readByte(uint8_t * result, uint16_t * index);
+   boolean readBytes(uint8_t * result, uint16_t * index, uint16_t count);
    boolean write(uint8_t header, uint8_t* buf, uint16_t length);
+   uint8_t writeHeader(uint8_t header, uint8_t* buf, uint32_t length);
+   boolean writeRaw(const uint8_t* buf, uint16_t length);
    uint16_t writeString(const char* string, uint8_t* buf, uint16_t pos);
    IPAddress ip;
    const char* domain;
    uint16_t port;
    Stream* stream;
    int _state;
+   uint8_t inflight[MQTT_MAX_INFLIGHT][MQTT_MAX_PACKET_SIZE];
+   uint16_t inflightLength[MQTT_MAX_INFLIGHT];
+   uint16_t inflightId[MQTT_MAX_INFLIGHT];
+   uint8_t inflightWindow;
+   uint32_t publishRemaining;
+   uint16_t keepAlive;
+   boolean cleanSession;
+   boolean _sessionPresent;
+   PubSubStore* store;
+   void initClient();
+   uint16_t nextId();
+   boolean sendInflight(uint8_t slot);
+   void ackInflight(uint16_t msgId);
+   static uint16_t packetMsgId(const uint8_t* packet);
 public:
    PubSubClient();
    PubSubClient(Client& client);
@@ -121,6 +158,10 @@ public:
    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
    PubSubClient& setClient(Client& client);
    PubSubClient& setStream(Stream& stream);
+   PubSubClient& setInflightWindow(uint8_t window);
+   PubSubClient& setStore(PubSubStore& store);
+   PubSubClient& setKeepAlive(uint16_t keepAlive);
+   PubSubClient& setCleanSession(boolean cleanSession);
 
    boolean connect(const char* id);
    boolean connect(const char* id, const char* user, const char* pass);
@@ -131,13 +172,23 @@ public:
    boolean publish(const char* topic, const char* payload, boolean retained);
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength);
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
+   boolean publish(const char* topic, const char* payload, boolean retained, uint8_t qos);
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained, uint8_t qos);
    boolean publish_P(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
+   boolean beginPublish(const char* topic, uint32_t plength, boolean retained);
+   size_t write(uint8_t c);
+   size_t write(const uint8_t * buf, size_t size);
+   boolean endPublish();
    boolean subscribe(const char* topic);
    boolean subscribe(const char* topic, uint8_t qos);
    boolean unsubscribe(const char* topic);
    boolean loop();
    boolean connected();
    int state();
+   uint8_t inflightCount();
+   void saveInflight();
+   boolean sessionPresent();
+   unsigned long lastActivity();
 };
 
 
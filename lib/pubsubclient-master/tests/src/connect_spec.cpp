@@ -253,6 +253,30 @@ int test_connect_disconnect_connect() {
     END_IT
 }
 
+int test_connect_keepalive_no_clean_session() {
+    IT("connects with a keepalive and without a clean session");
+    ShimClient shimClient;
+
+    shimClient.setAllowConnect(true);
+    byte connect[] = {0x10,0x18,0x0,0x4,0x4d,0x51,0x54,0x54,0x4,0x0,0x0,0x3c,0x0,0xc,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31};
+    byte connack[] = { 0x20, 0x02, 0x01, 0x00 };
+
+    shimClient.expect(connect,26);
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setKeepAlive(60);
+    client.setCleanSession(false);
+    IS_FALSE(client.sessionPresent());
+
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.sessionPresent());
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
 int main()
 {
     SUITE("Connect");
@@ -269,5 +293,6 @@ int main()
     test_connect_with_will();
     test_connect_with_will_username_password();
     test_connect_disconnect_connect();
+    test_connect_keepalive_no_clean_session();
     FINISH
 }
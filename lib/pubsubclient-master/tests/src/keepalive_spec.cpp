@@ -172,6 +172,43 @@ int test_keepalive_disconnects_hung() {
     END_IT
 }
 
+int test_keepalive_late_pingresp() {
+    IT("reads a waiting ping response after the keepalive (takes 6 seconds)");
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setKeepAlive(1);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte pingreq[] = { 0xC0,0x0 };
+    byte pingresp[] = { 0xD0,0x0 };
+    shimClient.expect(pingreq,2);
+    sleep(2);
+    rc = client.loop();
+    IS_TRUE(rc);
+
+    // The response arrives, but the next loop is later than the keepalive
+    shimClient.respond(pingresp,2);
+    sleep(2);
+    rc = client.loop();
+    IS_TRUE(rc);
+
+    shimClient.expect(pingreq,2);
+    sleep(2);
+    rc = client.loop();
+    IS_TRUE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
 int main()
 {
     SUITE("Keep-alive");
@@ -180,6 +217,7 @@ int main()
     test_keepalive_pings_with_inbound_qos0();
     test_keepalive_no_pings_inbound_qos1();
     test_keepalive_disconnects_hung();
+    test_keepalive_late_pingresp();
 
     FINISH
 }
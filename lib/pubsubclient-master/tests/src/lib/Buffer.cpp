@@ -15,6 +15,10 @@ bool Buffer::available() {
     return this->pos < this->length;
 }
 
+size_t Buffer::remaining() {
+    return this->length - this->pos;
+}
+
 uint8_t Buffer::next() {
     if (this->available()) {
         return this->buffer[this->pos++];
@@ -14,6 +14,7 @@ public:
     Buffer(uint8_t* buf, size_t size);
     
     virtual bool available();
+    virtual size_t remaining();
     virtual uint8_t next();
     virtual void reset();
     
@@ -97,7 +97,7 @@ size_t ShimClient::write(const uint8_t *buf, size_t size)  {
     return size;
 }
 int ShimClient::available()  {
-    return this->responseBuffer->available();
+    return this->responseBuffer->remaining();
 }
 int ShimClient::read()  { return this->responseBuffer->next(); }
 int ShimClient::read(uint8_t *buf, size_t size) {
@@ -0,0 +1,190 @@
+#include "MqttSnClient.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+// Stand-in for an MQTT-SN gateway. Every write is one datagram which is decoded here.
+class GatewayStandIn : public Client {
+public:
+    bool _connected;
+    int connects;
+    int datagrams;
+    int length;
+    int type;
+    int flags;
+    int topicId;
+    int msgId;
+    char payload[256];
+    int plength;
+    bool _error;
+    bool failFlush;
+
+    GatewayStandIn() {
+        _connected = false;
+        failFlush = false;
+        connects = 0;
+        datagrams = 0;
+        length = type = flags = topicId = msgId = plength = 0;
+        payload[0] = '\0';
+        _error = false;
+    }
+    virtual int connect(IPAddress ip, uint16_t port) { _error = true; return 0; }
+    virtual int connect(const char *host, uint16_t port) {
+        if (strcmp(host,"gateway") != 0 || port != 1884) {
+            _error = true;
+        }
+        connects++;
+        _connected = true;
+        return 1;
+    }
+    virtual size_t write(uint8_t b) { _error = true; return 0; }
+    virtual size_t write(const uint8_t *buf, size_t size) {
+        datagrams++;
+        length = buf[0];
+        if (length != (int)size) {
+            _error = true;
+        }
+        type = buf[1];
+        flags = buf[2];
+        topicId = (buf[3]<<8)+buf[4];
+        msgId = (buf[5]<<8)+buf[6];
+        plength = size-7;
+        memcpy(payload,buf+7,plength);
+        payload[plength] = '\0';
+        return size;
+    }
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int read(uint8_t *buf, size_t size) { return 0; }
+    virtual int peek() { return -1; }
+    virtual void flush() { if (failFlush) _connected = false; }
+    virtual void stop() { _connected = false; }
+    virtual uint8_t connected() { return _connected; }
+    virtual operator bool() { return true; }
+};
+
+int test_mqttsn_publish() {
+    IT("publishes one datagram with a predefined topic id");
+    GatewayStandIn gateway;
+
+    MqttSnClient client(gateway);
+    client.setServer("gateway",1884);
+
+    int rc = client.publish(1,"52.1,8.6,120,0",false);
+    IS_TRUE(rc);
+
+    IS_TRUE(gateway.connects == 1);
+    IS_TRUE(gateway.datagrams == 1);
+    IS_TRUE(gateway.length == 7+14);
+    IS_TRUE(gateway.type == MQTTSN_PUBLISH);
+    IS_TRUE(gateway.flags == 0x61);
+    IS_TRUE(gateway.topicId == 1);
+    IS_TRUE(gateway.msgId == 0);
+    IS_TRUE(strcmp(gateway.payload,"52.1,8.6,120,0") == 0);
+    IS_FALSE(gateway._error);
+
+    END_IT
+}
+
+int test_mqttsn_publish_retained() {
+    IT("publishes retained");
+    GatewayStandIn gateway;
+
+    MqttSnClient client(gateway);
+    client.setServer("gateway",1884);
+
+    int rc = client.publish(0x1234,"payload",true);
+    IS_TRUE(rc);
+
+    IS_TRUE(gateway.flags == 0x71);
+    IS_TRUE(gateway.topicId == 0x1234);
+    IS_FALSE(gateway._error);
+
+    END_IT
+}
+
+int test_mqttsn_connects_once() {
+    IT("selects the gateway only once");
+    GatewayStandIn gateway;
+
+    MqttSnClient client(gateway);
+    client.setServer("gateway",1884);
+
+    for (int i = 0;i<3;i++) {
+        int rc = client.publish(1,"payload",false);
+        IS_TRUE(rc);
+    }
+    IS_TRUE(gateway.connects == 1);
+    IS_TRUE(gateway.datagrams == 3);
+
+    client.stop();
+    int rc = client.publish(1,"payload",false);
+    IS_TRUE(rc);
+    IS_TRUE(gateway.connects == 2);
+    IS_FALSE(gateway._error);
+
+    END_IT
+}
+
+int test_mqttsn_publish_too_long() {
+    IT("fails to publish a too long message");
+    GatewayStandIn gateway;
+
+    MqttSnClient client(gateway);
+    client.setServer("gateway",1884);
+
+    char payload[MQTT_SN_MAX_PACKET_SIZE];
+    memset(payload,'x',sizeof(payload)-1);
+    payload[sizeof(payload)-1] = '\0';
+
+    int rc = client.publish(1,payload,false);
+    IS_FALSE(rc);
+    IS_TRUE(gateway.datagrams == 0);
+
+    END_IT
+}
+
+int test_mqttsn_no_server() {
+    IT("fails to publish without a server");
+    GatewayStandIn gateway;
+
+    MqttSnClient client(gateway);
+
+    int rc = client.publish(1,"payload",false);
+    IS_FALSE(rc);
+    IS_TRUE(gateway.datagrams == 0);
+
+    END_IT
+}
+
+int test_mqttsn_flush_failed() {
+    IT("fails to publish if the buffered datagram is not sent");
+    GatewayStandIn gateway;
+
+    MqttSnClient client(gateway);
+    client.setServer("gateway",1884);
+
+    gateway.failFlush = true;
+    int rc = client.publish(1,"payload",false);
+    IS_FALSE(rc);
+
+    gateway.failFlush = false;
+    rc = client.publish(1,"payload",false);
+    IS_TRUE(rc);
+    IS_TRUE(gateway.connects == 2);
+    IS_FALSE(gateway._error);
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("MQTT-SN");
+    test_mqttsn_publish();
+    test_mqttsn_publish_retained();
+    test_mqttsn_connects_once();
+    test_mqttsn_publish_too_long();
+    test_mqttsn_no_server();
+    test_mqttsn_flush_failed();
+
+    FINISH
+}
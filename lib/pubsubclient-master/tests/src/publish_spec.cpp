@@ -174,6 +174,180 @@ int test_publish_P() {
 
 
 
+int test_publish_stream() {
+    IT("publishes a payload in chunks");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish,16);
+
+    rc = client.beginPublish((char*)"topic",7,false);
+    IS_TRUE(rc);
+    IS_TRUE(client.write((const uint8_t*)"pay",3) == 3);
+    IS_TRUE(client.write((const uint8_t*)"load",4) == 4);
+    rc = client.endPublish();
+    IS_TRUE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_stream_larger_than_buffer() {
+    IT("publishes a payload larger than the packet buffer");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte payload[600];
+    for (int i = 0;i<600;i++) {
+        payload[i] = i & 0xFF;
+    }
+    byte header[] = {0x31,0xdf,0x4,0x0,0x5,0x74,0x6f,0x70,0x69,0x63};
+    shimClient.expect(header,10);
+    shimClient.expect(payload,600);
+
+    rc = client.beginPublish((char*)"topic",600,true);
+    IS_TRUE(rc);
+    for (int i = 0;i<600;i += 100) {
+        IS_TRUE(client.write(payload+i,100) == 100);
+    }
+    rc = client.endPublish();
+    IS_TRUE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_stream_multi_kb() {
+    IT("publishes a multi-KB payload");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    uint16_t received = shimClient.received();
+
+    byte chunk[256];
+    memset(chunk,'x',256);
+
+    rc = client.beginPublish((char*)"topic",8192,false);
+    IS_TRUE(rc);
+    for (int i = 0;i<32;i++) {
+        IS_TRUE(client.write(chunk,256) == 256);
+    }
+    rc = client.endPublish();
+    IS_TRUE(rc);
+
+    // header, remaining length (2 bytes), topic and payload
+    IS_TRUE(shimClient.received() - received == 1+2+7+8192);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_stream_incomplete() {
+    IT("fails to end an incomplete streamed payload");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.beginPublish((char*)"topic",10,false);
+    IS_TRUE(rc);
+    IS_TRUE(client.write((const uint8_t*)"12345",5) == 5);
+    rc = client.endPublish();
+    IS_FALSE(rc);
+
+    END_IT
+}
+
+int test_publish_stream_overflow() {
+    IT("rejects bytes beyond the announced length");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x30,0x0c,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f};
+    shimClient.expect(publish,14);
+
+    rc = client.beginPublish((char*)"topic",5,false);
+    IS_TRUE(rc);
+    IS_TRUE(client.write((const uint8_t*)"paylo",3) == 3);
+    IS_TRUE(client.write((const uint8_t*)"loadXX",6) == 2);
+    IS_TRUE(client.write('X') == 0);
+    rc = client.endPublish();
+    IS_TRUE(rc);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_stream_too_long() {
+    IT("fails to begin a stream longer than the maximum remaining length");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.beginPublish((char*)"topic",268435455,false);
+    IS_FALSE(rc);
+    rc = client.beginPublish((char*)"topic",268435455-7,false);
+    IS_TRUE(rc);
+
+    END_IT
+}
+
+int test_publish_stream_not_connected() {
+    IT("publish stream fails when not connected");
+    ShimClient shimClient;
+
+    PubSubClient client(server, 1883, callback, shimClient);
+
+    int rc = client.beginPublish((char*)"topic",7,false);
+    IS_FALSE(rc);
+
+    END_IT
+}
+
+
 
 int main()
 {
@@ -185,6 +359,13 @@ int main()
     test_publish_not_connected();
     test_publish_too_long();
     test_publish_P();
+    test_publish_stream();
+    test_publish_stream_larger_than_buffer();
+    test_publish_stream_multi_kb();
+    test_publish_stream_incomplete();
+    test_publish_stream_overflow();
+    test_publish_stream_too_long();
+    test_publish_stream_not_connected();
 
     FINISH
 }
@@ -0,0 +1,278 @@
+#include "PubSubClient.h"
+#include "ShimClient.h"
+#include "Buffer.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+
+byte server[] = { 172, 16, 0, 2 };
+
+void callback(char* topic, byte* payload, unsigned int length) {
+  // handle message arrived
+}
+
+class MemoryStore : public PubSubStore {
+public:
+    uint8_t packets[MQTT_MAX_INFLIGHT][MQTT_MAX_PACKET_SIZE];
+    uint16_t lengths[MQTT_MAX_INFLIGHT];
+
+    MemoryStore() {
+        memset(lengths,0,sizeof(lengths));
+    }
+    void save(uint8_t slot, const uint8_t* packet, uint16_t length) {
+        memcpy(packets[slot],packet,length);
+        lengths[slot] = length;
+    }
+    void remove(uint8_t slot) {
+        lengths[slot] = 0;
+    }
+    uint16_t load(uint8_t slot, uint8_t* packet, uint16_t size) {
+        if (lengths[slot] > size) {
+            return 0;
+        }
+        memcpy(packet,packets[slot],lengths[slot]);
+        return lengths[slot];
+    }
+};
+
+int test_publish_qos1() {
+    IT("publishes qos 1 with a message id");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x2,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish,18);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 1);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_qos1_puback() {
+    IT("releases a qos 1 publish on puback");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 1);
+
+    byte puback[] = { 0x40, 0x02, 0x00, 0x02 };
+    shimClient.respond(puback,4);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_qos1_reordered() {
+    IT("releases qos 1 publishes on reordered pubacks");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 2);
+
+    byte puback3[] = { 0x40, 0x02, 0x00, 0x03 };
+    byte puback2[] = { 0x40, 0x02, 0x00, 0x02 };
+    shimClient.respond(puback3,4);
+    shimClient.respond(puback2,4);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 1);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_qos1_window() {
+    IT("refuses a qos 1 publish when the window is full");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setInflightWindow(2);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_FALSE(rc);
+    IS_TRUE(client.inflightCount() == 2);
+
+    byte puback[] = { 0x40, 0x02, 0x00, 0x02 };
+    shimClient.respond(puback,4);
+
+    byte publish[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x4,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish,18);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 2);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_qos1_resend() {
+    IT("resends unacknowledged qos 1 publishes after a lost connection");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish2[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x2,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish2,18);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+
+    // The packet is lost together with the connection
+    shimClient.setConnected(false);
+    IS_FALSE(client.connected());
+
+    // Queued without a connection
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 2);
+
+    byte connect[] = {0x10,0x18,0x0,0x4,0x4d,0x51,0x54,0x54,0x4,0x2,0x0,0xf,0x0,0xc,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31};
+    byte dup2[] = {0x3a,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x2,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    byte publish3[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x3,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(connect,26);
+    shimClient.expect(dup2,18);
+    shimClient.expect(publish3,18);
+    shimClient.respond(connack,4);
+
+    rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 2);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_qos1_store() {
+    IT("restores unacknowledged qos 1 publishes from the store");
+    MemoryStore store;
+    {
+        ShimClient shimClient;
+        shimClient.setAllowConnect(true);
+
+        byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+        shimClient.respond(connack,4);
+
+        PubSubClient client(server, 1883, callback, shimClient);
+        client.setStore(store);
+        int rc = client.connect((char*)"client_test1");
+        IS_TRUE(rc);
+
+        rc = client.publish((char*)"topic",(char*)"payload",false,1);
+        IS_TRUE(rc);
+        rc = client.publish((char*)"topic",(char*)"payload",false,1);
+        IS_TRUE(rc);
+
+        byte puback[] = { 0x40, 0x02, 0x00, 0x02 };
+        shimClient.respond(puback,4);
+        rc = client.loop();
+        IS_TRUE(rc);
+        // The window is only written on request
+        IS_TRUE(store.lengths[1] == 0);
+        client.saveInflight();
+        IS_TRUE(store.lengths[0] == 0);
+        IS_TRUE(store.lengths[1] == 18);
+    }
+
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setStore(store);
+    IS_TRUE(client.inflightCount() == 1);
+
+    byte connect[] = {0x10,0x18,0x0,0x4,0x4d,0x51,0x54,0x54,0x4,0x2,0x0,0xf,0x0,0xc,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31};
+    byte dup3[] = {0x3a,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x3,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    byte publish2[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x2,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(connect,26);
+    shimClient.expect(dup3,18);
+    shimClient.expect(publish2,18);
+
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    // The restored message id is not used again
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_TRUE(client.inflightCount() == 2);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("QoS 1");
+    test_publish_qos1();
+    test_publish_qos1_puback();
+    test_publish_qos1_reordered();
+    test_publish_qos1_window();
+    test_publish_qos1_resend();
+    test_publish_qos1_store();
+
+    FINISH
+}
@@ -264,6 +264,47 @@ int test_receive_qos1() {
     END_IT
 }
 
+// Reports stale data after the responses like a closed socket of the modem, but reads nothing
+class ClosedClient : public ShimClient {
+public:
+    virtual int available() {
+        int n = ShimClient::available();
+        return n > 0 ? n : 5;
+    }
+    virtual int read() {
+        return ShimClient::available() > 0 ? ShimClient::read() : -1;
+    }
+    virtual int read(uint8_t *buf, size_t size) {
+        size_t n = ShimClient::available();
+        return ShimClient::read(buf, size < n ? size : n);
+    }
+};
+
+int test_receive_closed_socket() {
+    IT("stops reading a message from a closed socket");
+    reset_callback();
+
+    ClosedClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    // Only the first part of the message arrives
+    byte publish[] = {0x30,0xe,0x0,0x5,0x74,0x6f,0x70};
+    shimClient.respond(publish,7);
+
+    client.loop();
+
+    IS_FALSE(callback_called);
+
+    END_IT
+}
+
 int main()
 {
     SUITE("Receive");
@@ -274,6 +315,7 @@ int main()
     test_receive_oversized_message();
     test_receive_oversized_stream_message();
     test_receive_qos1();
+    test_receive_closed_socket();
 
     FINISH
 }
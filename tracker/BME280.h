@@ -23,26 +23,87 @@
 
 #include <Adafruit_BME280.h>
 
-#define BARO_CORR_HPA 34.5879 //!< Correction for 289m above sea level
+#define BARO_CORR_HPA      34.5879 //!< Correction for 289m above sea level
+#define RTC_BME280_OFFSET  (RTC_MQTT_OFFSET + sizeof(MyMqttRtc) / 4) //!< RTC memory block behind the mqtt data.
+#define RTC_BME280_MAGIC   280718  //!< Fantasy value for checking if the calibration is cached.
 
 /**
-  * Communication with the BME280 modul to read temperature, humidity and pressure
+  * Calibration of the BME280 which is stored in the RTC memory,
+  * so it is not read again from the sensor after every power on.
   */
-class MyBME280
+class MyBME280Rtc
 {
+public:
+   uint32_t          magic; //!< Is the RTC memory initialized?
+   bme280_calib_data calib; //!< Cached factory calibration of the sensor.
+};
+
+/**
+  * Sampling profiles of the BME280.
+  */
+enum MyBME280Profile
+{
+   BME280_WEATHER,   //!< x1 oversampling, no filter, switched off between the samples.
+   BME280_CABIN,     //!< Pressure x16 with IIR filter, kept powered so the filter keeps its history.
+   BME280_PRECISE,   //!< x16 oversampling of all values, no filter, switched off between the samples.
+   BME280_PROFILES   //!< Number of sampling profiles.
+};
+
+/**
+  * Oversampling and filter of one sampling profile.
+  */
+class MyBME280ProfileInfo
+{
+public:
+   const char                     *name;          //!< Name for the information page.
+   Adafruit_BME280::sensor_sampling temperature;  //!< Oversampling of the temperature.
+   Adafruit_BME280::sensor_sampling pressure;     //!< Oversampling of the pressure.
+   Adafruit_BME280::sensor_sampling humidity;     //!< Oversampling of the humidity.
+   Adafruit_BME280::sensor_filter   filter;       //!< IIR filter coefficient.
+   bool                             isPowered;    //!< Keep the modul powered between the samples?
+};
+
+/**
+  * Sensor driver of the BME280 modul to read temperature, humidity and pressure.
+  * A sample starts the forced measurement and is read after the conversion time of the profile. 
+  */
+class MyBME280 : public MySensor
+{
+public:
+   static const MyBME280ProfileInfo profiles[BME280_PROFILES]; //!< All the sampling profiles.
+
 protected:
    MyOptions      &myOptions;    //!< Reference to global options
    MyData         &myData;       //!< Reference to global data
    int             pinPower;     //!< Pin connection to switch on the BME280 module
    Adafruit_BME280 bme280;       //!< Adafruit BME280 helper interface
-   long            lastReadSec;  //!< Elapsed time in sec for from the last read.
+   MyBME280Rtc     rtc;          //!< Cached calibration (RTC memory image).
+   int             profile;      //!< Configured profile of the powered modul (-1 = switched off).
+   unsigned long   startMs;      //!< Start of the running conversion.
+
+protected:
+   MyBME280Profile getProfile();
+   void            powerOff();
    
 public:
    MyBME280(MyOptions &options, MyData &data, int pin);
 
    bool begin();
 
-   bool readValues();
+   virtual const char *getName();
+   virtual long getIntervalSec();
+   virtual long start();
+   virtual long poll();
+   virtual bool read(MySamples &samples);
+};
+
+/* ******************************************** */
+
+const MyBME280ProfileInfo MyBME280::profiles[BME280_PROFILES] = {
+   // name       temperature                      pressure                          humidity                         filter                          powered
+   { "Weather",  Adafruit_BME280::SAMPLING_X1,    Adafruit_BME280::SAMPLING_X1,     Adafruit_BME280::SAMPLING_X1,    Adafruit_BME280::FILTER_OFF,    false },
+   { "Cabin",    Adafruit_BME280::SAMPLING_X2,    Adafruit_BME280::SAMPLING_X16,    Adafruit_BME280::SAMPLING_X1,    Adafruit_BME280::FILTER_X16,    true  },
+   { "Precise",  Adafruit_BME280::SAMPLING_X16,   Adafruit_BME280::SAMPLING_X16,    Adafruit_BME280::SAMPLING_X16,   Adafruit_BME280::FILTER_OFF,    false }
 };
 
 /** Constructor */
@@ -50,34 +111,110 @@ MyBME280::MyBME280(MyOptions &options, MyData &data, int pin)
    : pinPower(pin)
    , myOptions(options)
    , myData(data)
-   , lastReadSec(0)
+   , profile(-1)
+   , startMs(0)
 {
 }
 
-/** Switch off the module at startup to safe power. */
+/** Switch off the module at startup to safe power and restore the cached calibration. */
 bool MyBME280::begin()
 {
    pinMode(pinPower, OUTPUT);
    digitalWrite(pinPower, HIGH); 
+   ESP.rtcUserMemoryRead(RTC_BME280_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+   return true;
+}
+
+/** Configured profile. The low power duty cycles always use the weather profile. */
+MyBME280Profile MyBME280::getProfile()
+{
+   if (myData.dutyProfile >= DUTY_SAVE || myOptions.bme280Profile < 0 || myOptions.bme280Profile >= BME280_PROFILES) {
+      return BME280_WEATHER;
+   }
+   return (MyBME280Profile) myOptions.bme280Profile;
+}
+
+/** Name of the sensor. */
+const char *MyBME280::getName()
+{
+   return "BME280";
+}
+
+/** Sample interval from the options. */
+long MyBME280::getIntervalSec()
+{
+   return myOptions.bme280CheckIntervalSec;
 }
 
 /** 
-  * Switch on the modul, read the values and switch off the modul to save power. 
-  * Do this only every bme280CheckIntervalSec
+  * Switch on and configure the modul if needed and start one forced measurement. 
+  * The calibration is only read from the sensor if it is not cached in the RTC memory.
+  * Returns the conversion time in ms or -1 on errors.
   */
-bool MyBME280::readValues()
+long MyBME280::start()
 {
-   long secs = millis() / 1000;
+   MyBME280Profile            newProfile = getProfile();
+   const MyBME280ProfileInfo &info       = profiles[newProfile];
+
+   if (profile != newProfile) {
+      bool isCached = rtc.magic == RTC_BME280_MAGIC;
 
-   if (lastReadSec == 0 || (secs - lastReadSec > myOptions.bme280CheckIntervalSec)) {
-      lastReadSec = secs;
-      
       digitalWrite(pinPower, LOW); 
-      if (bme280.begin()) {
-         myData.temperature = bme280.readTemperature();
-         myData.humidity    = bme280.readHumidity();
-         myData.pressure    = (bme280.readPressure() / 100.0F) + BARO_CORR_HPA;
+      if (!bme280.beginForced(isCached ? &rtc.calib : NULL)) {
+         powerOff();
+         return -1;
+      }
+      if (!isCached) {
+         rtc.magic = RTC_BME280_MAGIC;
+         rtc.calib = bme280.getCalibration();
+         ESP.rtcUserMemoryWrite(RTC_BME280_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
       }
-      digitalWrite(pinPower, HIGH); 
+      bme280.setSampling(Adafruit_BME280::MODE_SLEEP, info.temperature, info.pressure, info.humidity, info.filter);
+      profile = newProfile;
+
+      // Charge of one conversion from the typical currents of the datasheet
+      float tMs = info.temperature ? 2.3 * (1 << (info.temperature - 1))         : 0.0;
+      float pMs = info.pressure    ? 2.3 * (1 << (info.pressure    - 1)) + 0.575 : 0.0;
+      float hMs = info.humidity    ? 2.3 * (1 << (info.humidity    - 1)) + 0.575 : 0.0;
+
+      myData.bme280Profile   = info.name;
+      myData.bme280ChargeUAs = (tMs * 350.0 + pMs * 714.0 + hMs * 340.0) / 1000.0;
    }
+   bme280.startMeasurement();
+   startMs = millis();
+   return ceil(bme280.getMeasurementTimeMs());
+}
+
+/** Is the conversion finished? */
+long MyBME280::poll()
+{
+   return bme280.isMeasuring() ? 1 : 0;
+}
+
+/** Read the values of the finished conversion and switch off the modul if the profile allows it. */
+bool MyBME280::read(MySamples &samples)
+{
+   int32_t  temperature = 0;
+   uint32_t pressure    = 0;
+   uint32_t humidity    = 0;
+   bool     isRead      = bme280.readAll(&temperature, &pressure, &humidity);
+
+   myData.bme280ConversionMs = millis() - startMs;
+   if (!profiles[profile].isPowered || !isRead) {
+      powerOff();
+   }
+   if (!isRead) {
+      return false;
+   }
+   samples.set(getName(), SAMPLE_TEMPERATURE, temperature / 100.0);
+   samples.set(getName(), SAMPLE_HUMIDITY,    humidity    / 1024.0);
+   samples.set(getName(), SAMPLE_PRESSURE,    (pressure   / 25600.0) + BARO_CORR_HPA);
+   return true;
+}
+
+/** Switch off the modul. It has to be configured again after the next power on. */
+void MyBME280::powerOff()
+{
+   digitalWrite(pinPower, HIGH); 
+   profile = -1;
 }
@@ -0,0 +1,161 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file BatteryMonitor.h
+  *
+  * Class to communicate with a DS2438 battery monitor on the 1-wire bus.
+  */
+
+
+#include <OneWire.h>
+#include <DS2438.h>
+
+#define DS2438_FAMILY_CODE 0x26 //!< 1-wire family code of the DS2438.
+
+/**
+  * Steps of one asynchronous DS2438 sample.
+  */
+enum MyDS2438State
+{
+   DS2438_IDLE,        //!< Nothing is running.
+   DS2438_TEMPERATURE, //!< Temperature conversion is running.
+   DS2438_VOLTAGE      //!< Voltage conversion is running.
+};
+
+/**
+  * Sensor driver of the DS2438 to read battery voltage (VAD input), current and temperature.
+  * The temperature and the voltage conversion are started one after the other 
+  * and polled by the sensor registry instead of waiting in DS2438::update().
+  */
+class MyDS2438 : public MySensor
+{
+protected:
+   MyOptions    &myOptions;    //!< Reference to global options
+   OneWire       oneWire;      //!< 1-wire bus.
+   DS2438        ds2438;       //!< DS2438 helper interface.
+   uint8_t       address[8];   //!< 1-wire address of the found DS2438.
+   bool          isFound;      //!< Was a DS2438 found on the bus?
+   MyDS2438State state;        //!< Running conversion.
+
+protected:
+   bool search();
+
+public:
+   MyDS2438(MyOptions &options, int pin);
+
+   bool begin();
+
+   virtual const char *getName();
+   virtual long getIntervalSec();
+   virtual long start();
+   virtual long poll();
+   virtual bool read(MySamples &samples);
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyDS2438::MyDS2438(MyOptions &options, int pin)
+   : myOptions(options)
+   , oneWire(pin)
+   , ds2438(&oneWire, address)
+   , isFound(false)
+   , state(DS2438_IDLE)
+{
+   memset(address, 0, sizeof(address));
+}
+
+/** Find the DS2438 on the 1-wire bus if the monitor is enabled. */
+bool MyDS2438::begin()
+{
+   ds2438.begin(DS2438_MODE_CHA | DS2438_MODE_TEMPERATURE | DS2438_MODE_CURRENT);
+   if (myOptions.isDs2438Enabled) {
+      MyDbg("MyDS2438::begin");
+      search();
+   }
+   return true;
+}
+
+/** Search the first DS2438 on the bus. */
+bool MyDS2438::search()
+{
+   oneWire.reset_search();
+   while (oneWire.search(address)) {
+      if (address[0] == DS2438_FAMILY_CODE && OneWire::crc8(address, 7) == address[7]) {
+         MyDbg("DS2438 found");
+         isFound = true;
+         return true;
+      }
+   }
+   MyDbg("No DS2438 found");
+   return false;
+}
+
+/** Name of the sensor. */
+const char *MyDS2438::getName()
+{
+   return "DS2438";
+}
+
+/** Sample interval from the options (0 if the monitor is disabled). */
+long MyDS2438::getIntervalSec()
+{
+   return myOptions.isDs2438Enabled ? myOptions.ds2438CheckIntervalSec : 0;
+}
+
+/** Start the temperature conversion. The bus is searched again after an error. */
+long MyDS2438::start()
+{
+   state = DS2438_IDLE;
+   if (!isFound && !search()) {
+      return -1;
+   }
+   if (!ds2438.startTemperatureConversion()) {
+      isFound = false;
+      return -1;
+   }
+   state = DS2438_TEMPERATURE;
+   return DS2438_TEMPERATURE_DELAY;
+}
+
+/** Start the voltage conversion after the temperature conversion. The values are ready after it. */
+long MyDS2438::poll()
+{
+   if (state == DS2438_VOLTAGE) {
+      return 0;
+   }
+   if (!ds2438.startVoltageConversion(DS2438_CHA)) {
+      isFound = false;
+      return -1;
+   }
+   state = DS2438_VOLTAGE;
+   return DS2438_VOLTAGE_CONVERSION_DELAY;
+}
+
+/** Read the voltage (with the factor of the external divider), the current and the temperature. */
+bool MyDS2438::read(MySamples &samples)
+{
+   state = DS2438_IDLE;
+   if (!ds2438.readConversion(DS2438_CHA)) {
+      isFound = false;
+      return false;
+   }
+   samples.set(getName(), SAMPLE_VOLTAGE,     ds2438.getVoltage(DS2438_CHA) * myOptions.ds2438VoltageFactor);
+   samples.set(getName(), SAMPLE_CURRENT,     ds2438.getCurrent(myOptions.ds2438SenseOhm));
+   samples.set(getName(), SAMPLE_TEMPERATURE, ds2438.getTemperature());
+   return true;
+}
@@ -0,0 +1,267 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file CellLocator.h
+  *
+  * Position of the serving gsm cell as fallback if the gnss has no fix.
+  */
+
+
+#define RTC_CELL_OFFSET   (RTC_GPS_OFFSET + sizeof(MyGpsRtc) / 4) //!< RTC memory block behind the gps data.
+#define RTC_CELL_MAGIC    121018          //!< Fantasy value for checking if the cell data is initialized.
+#define CELL_CACHE_FILE   "/cells.bin"    //!< SPIFFS file of the known cell positions.
+#define CELL_CACHE_SIZE   32              //!< Number of cached cell positions (the oldest is replaced).
+#define CELL_ACCURACY_M   1000            //!< Assumed accuracy of a cell position in m.
+
+/**
+  * Known position of one gsm cell in the SPIFFS cache.
+  */
+class MyCellRecord
+{
+public:
+   MyCell cell;      //!< Identification of the cell.
+   float  latitude;  //!< Latitude of +CIPGSMLOC.
+   float  longitude; //!< Longitude of +CIPGSMLOC.
+};
+
+/**
+  * Lookup counter which is stored in the RTC memory to survive the deep sleep.
+  */
+class MyCellRtc
+{
+public:
+   uint32_t magic;        //!< Is the RTC memory initialized?
+   uint32_t hourStartSec; //!< Uptime of the energy model at the start of the counted hour.
+   uint32_t lookups;      //!< Network lookups in the counted hour.
+};
+
+/**
+  * Fallback locator for the time without gnss fix.
+  * The serving cell (+CENG) is looked up in the cache first. Only unknown cells
+  * cost a +CIPGSMLOC network request, limited to 'cellLocMaxPerHour'.
+  */
+class MyCellLocator
+{
+protected:
+   MyGsmGps     &myGsmGps;                    //!< Reference to the sim808 communication.
+   MyEnergy     &myEnergy;                    //!< Reference to the energy model.
+   MyOptions    &myOptions;                   //!< Reference to the options.
+   MyData       &myData;                      //!< Reference to the data.
+   MyCellRtc     rtc;                         //!< Lookup counter (RTC memory image).
+   MyCellRecord  cache[CELL_CACHE_SIZE];      //!< Known cell positions.
+   uint32_t      cacheCount;                  //!< Number of valid cache entries.
+   uint32_t      cacheNext;                   //!< Index of the next cache entry to write.
+   MyCell        lastCell;                    //!< Serving cell of the last located position.
+   long          lastCheckSec;                //!< Time of the last +CENG query.
+
+protected:
+   int  find(const MyCell &cell);
+   bool add(const MyCell &cell, float latitude, float longitude);
+   bool loadCache();
+   bool saveCache();
+   bool isLookupAllowed();
+   bool lookup(float &latitude, float &longitude);
+   void setPosition(const MyCell &cell, float latitude, float longitude, const String &source);
+
+public:
+   MyCellLocator(MyGsmGps &gsmGps, MyEnergy &energy, MyOptions &options, MyData &data);
+
+   bool begin();
+   void handleClient();
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyCellLocator::MyCellLocator(MyGsmGps &gsmGps, MyEnergy &energy, MyOptions &options, MyData &data)
+   : myGsmGps(gsmGps)
+   , myEnergy(energy)
+   , myOptions(options)
+   , myData(data)
+   , cacheCount(0)
+   , cacheNext(0)
+   , lastCheckSec(0)
+{
+   memset(&lastCell, 0, sizeof(lastCell));
+}
+
+/** Restore the lookup counter from the RTC memory and read the cache. */
+bool MyCellLocator::begin()
+{
+   MyCellRtc tmp;
+
+   ESP.rtcUserMemoryRead(RTC_CELL_OFFSET, (uint32_t *) &tmp, sizeof(tmp));
+   if (tmp.magic == RTC_CELL_MAGIC) {
+      rtc = tmp;
+   } else {
+      rtc.magic        = RTC_CELL_MAGIC;
+      rtc.hourStartSec = 0;
+      rtc.lookups      = 0;
+   }
+   loadCache();
+   return true;
+}
+
+/**
+  * Locate the serving cell if the gnss has no fix for 'cellLocAfterSec'.
+  * The serving cell is also queried at most every 'cellLocAfterSec'.
+  * Called by the scheduler after the gps check.
+  */
+void MyCellLocator::handleClient()
+{
+   long   sec = millis() / 1000;
+   long   lastFixSec;
+   MyCell cell;
+   float  latitude, longitude;
+   int    index;
+
+   if (myOptions.cellLocAfterSec <= 0 || !myGsmGps.isGsmActive) {
+      return;
+   }
+   lastFixSec = myData.positionSource == "GNSS" ? myData.lastGpsUpdateSec : 0;
+   if (sec - lastFixSec < myOptions.cellLocAfterSec || sec - lastCheckSec < myOptions.cellLocAfterSec) {
+      return;
+   }
+   lastCheckSec = sec;
+   if (!myGsmGps.getServingCell(cell)) {
+      return;
+   }
+   if (myData.positionSource != "GNSS" && myData.positionSource != "" && cell == lastCell) {
+      return; // this cell is already the current position
+   }
+
+   index = find(cell);
+   if (index >= 0) {
+      setPosition(cell, cache[index].latitude, cache[index].longitude, "Cell cache");
+   } else if (!isLookupAllowed()) {
+      MyDbg("cell lookup limit reached");
+   } else if (lookup(latitude, longitude)) {
+      add(cell, latitude, longitude);
+      setPosition(cell, latitude, longitude, "Cell");
+   }
+}
+
+/** Take over a cell position as the current position. The moving state is not changed. */
+void MyCellLocator::setPosition(const MyCell &cell, float latitude, float longitude, const String &source)
+{
+   lastCell                  = cell;
+   myData.latitude           = String(latitude,  6);
+   myData.longitude          = String(longitude, 6);
+   myData.positionSource     = source;
+   myData.positionAccuracyM  = CELL_ACCURACY_M;
+   myData.lastGpsUpdateSec   = millis() / 1000;
+   MyDbg("(" + source + ") " + myData.latitude + "," + myData.longitude);
+}
+
+/** Is one more network lookup in the current hour allowed? */
+bool MyCellLocator::isLookupAllowed()
+{
+   uint32_t uptimeSec = (uint32_t) myEnergy.getUptimeSec();
+
+   if (uptimeSec < rtc.hourStartSec || uptimeSec - rtc.hourStartSec >= 3600) {
+      rtc.hourStartSec = uptimeSec;
+      rtc.lookups      = 0;
+   }
+   return rtc.lookups < (uint32_t) myOptions.cellLocMaxPerHour;
+}
+
+/** Ask the network for the position of the serving cell (+CIPGSMLOC). */
+bool MyCellLocator::lookup(float &latitude, float &longitude)
+{
+   String location;
+
+   rtc.lookups++;
+   ESP.rtcUserMemoryWrite(RTC_CELL_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+
+   MyDbg("cell lookup");
+   myGsmGps.wakeUp();
+   myEnergy.set(ENERGY_GPRS, true);
+   location = myGsmGps.gsmSim808.getGsmLocation();  // <code>,<longitude>,<latitude>,<date>,<time>
+   myEnergy.set(ENERGY_GPRS, false);
+
+   int first  = location.indexOf(',');
+   int second = location.indexOf(',', first + 1);
+   int third  = location.indexOf(',', second + 1);
+
+   if (location.toInt() != 0 || first < 0 || second < 0 || third < 0) {
+      MyDbg("cell lookup failed: " + location);
+      return false;
+   }
+   longitude = location.substring(first  + 1, second).toFloat();
+   latitude  = location.substring(second + 1, third).toFloat();
+   return latitude != 0.0 || longitude != 0.0;
+}
+
+/** Index of a cell in the cache or -1. */
+int MyCellLocator::find(const MyCell &cell)
+{
+   for (uint32_t i = 0; i < cacheCount; i++) {
+      if (cache[i].cell == cell) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+/** Store a new cell position in the cache. The oldest entry is replaced. */
+bool MyCellLocator::add(const MyCell &cell, float latitude, float longitude)
+{
+   cache[cacheNext].cell      = cell;
+   cache[cacheNext].latitude  = latitude;
+   cache[cacheNext].longitude = longitude;
+   cacheNext  = (cacheNext + 1) % CELL_CACHE_SIZE;
+   cacheCount = min(cacheCount + 1, (uint32_t) CELL_CACHE_SIZE);
+   return saveCache();
+}
+
+/** Read the cache file (next index and the entries). */
+bool MyCellLocator::loadCache()
+{
+   File file = SPIFFS.open(CELL_CACHE_FILE, "r");
+
+   cacheCount = 0;
+   cacheNext  = 0;
+   if (!file) {
+      return false;
+   }
+   if (file.read((uint8_t *) &cacheNext, sizeof(cacheNext)) == sizeof(cacheNext) && cacheNext < CELL_CACHE_SIZE) {
+      while (cacheCount < CELL_CACHE_SIZE &&
+             file.read((uint8_t *) &cache[cacheCount], sizeof(MyCellRecord)) == sizeof(MyCellRecord)) {
+         cacheCount++;
+      }
+   } else {
+      cacheNext = 0;
+   }
+   file.close();
+   MyDbg("cell cache: " + String(cacheCount));
+   return true;
+}
+
+/** Write the whole cache file. */
+bool MyCellLocator::saveCache()
+{
+   File file = SPIFFS.open(CELL_CACHE_FILE, "w");
+
+   if (!file) {
+      MyDbg("Failed to write " CELL_CACHE_FILE);
+      return false;
+   }
+   file.write((uint8_t *) &cacheNext, sizeof(cacheNext));
+   file.write((uint8_t *) cache, cacheCount * sizeof(MyCellRecord));
+   file.close();
+   return true;
+}
@@ -21,6 +21,31 @@
   */
 
 
+/**
+  * Power states of the sim808 modul.
+  */
+enum MyModemState
+{
+   MODEM_OFF,    //!< DC-DC modul switched off.
+   MODEM_SLEEP,  //!< Slow clock mode with DTR high.
+   MODEM_IDLE,   //!< Awake but no AT communication.
+   MODEM_ACTIVE, //!< AT communication in progress.
+   MODEM_STATES  //!< Number of modem states.
+};
+
+/**
+  * Duty cycle profiles selected by the supply voltage.
+  * Ordered from the highest to the lowest voltage.
+  */
+enum MyDutyProfile
+{
+   DUTY_CHARGING, //!< Battery is charging (engine is running).
+   DUTY_NORMAL,   //!< Battery is fine.
+   DUTY_SAVE,     //!< Battery is low, use the deep sleep.
+   DUTY_CRITICAL, //!< Battery is very low, long deep sleep without sim808.
+   DUTY_PROFILES  //!< Number of duty cycle profiles.
+};
+
 /**
   * Helper class to store all the global determined data in one place.
   */
@@ -32,10 +57,21 @@ public:
    bool   isOtaActive;        //!< Is OverTheAir update active?
    long   secondsToDeepSleep; //!< Time until next deepsleep
 
-   double voltage;            //!< Current supply voltage
-   double temperature;        //!< Current BME280 temperature
-   double humidity;           //!< Current BME280 humidity
-   double pressure;           //!< Current BME280 pressure
+   double voltage;            //!< Current supply voltage (filtered)
+   double voltageTrend;       //!< Supply voltage trend in V/h
+   double voltageMean;        //!< Mean supply voltage of the last statistics window
+   double voltageMin;         //!< Minimum supply voltage of the last statistics window
+   double voltageMax;         //!< Maximum supply voltage of the last statistics window
+   long   voltageWindows;     //!< Number of finished statistics windows
+   MyDutyProfile dutyProfile; //!< Current duty cycle profile
+   long   gpsCheckIntervalSec; //!< Gps check interval of the current profile
+   long   mqttSendFactor;     //!< Factor to the mqtt send intervals of the current profile
+   long   mqttKeepAliveSec;   //!< Effective mqtt keepalive interval
+   long   mqttNatTimeoutSec;  //!< Measured idle time which lost the mqtt connection (0 = unknown)
+   MySamples samples;         //!< Last values of all the sensors
+   String bme280Profile;      //!< Name of the effective BME280 sampling profile
+   double bme280ConversionMs; //!< Measured BME280 conversion time of the last sample
+   double bme280ChargeUAs;    //!< Estimated BME280 charge of one sample in uAs
 
    String softAPIP;           //!< registered ip of the access point
    String softAPmacAddress;   //!< module mac address
@@ -48,6 +84,8 @@ public:
    String signalQuality;      //!< Quality of the signal
    String batteryLevel;       //!< Battery level of the sim808 module
    String batteryVolt;        //!< Battery volt of the sim808 module
+
+   MyModemState modemState;   //!< Current power state of the sim808 module
    
    String longitude;          //!< Current GPS longitude
    String latitude;           //!< Current GPS latitude
@@ -58,9 +96,19 @@ public:
    String gpsDate;            //!< Date from GPS (UTC)
    String gpsTime;            //!< Time from GPS (UTC)
    long   lastGpsUpdateSec;   //!< Elapsed Time of last read
+   String positionSource;     //!< Source of the position (GNSS, Cell, Cell cache)
+   double positionAccuracyM;  //!< Estimated accuracy of the position in m
+   double gpsTtffSec;         //!< Time to first fix of the last gps start
+   long   gpsTtffCount;       //!< Number of measured times to first fix
+   String gpsAssist;          //!< Assistance of the last gps start (cold, position, EPO)
+   long   epoAgeSec;          //!< Age of the EPO data in the sim808 (-1 = none or unknown)
+   long   nmeaSentences;      //!< Parsed sentences of the nmea stream
+   long   nmeaErrors;         //!< Nmea sentences with checksum errors
    
-   bool   isMoving;           //!< Is moving recognized
-   double movingDistance;     //!< Minimum distance for moving flag
+   bool   isMoving;           //!< Is moving recognized (moving or stopping)
+   double movingDistance;     //!< Distance of the filtered position to the park position
+   String motionState;        //!< Motion state (Parked, Moving, Stopping)
+   long   rejectedFixes;      //!< Gps fixes rejected by the position filter
    
    StringList consoleCmds;    //!< open commands to send to the sim808 module
    StringList logInfos;       //!< received sim808 answers or other logs
@@ -70,12 +118,29 @@ public:
       : isOtaActive(false)
       , secondsToDeepSleep(-1)
       , voltage(0.0)
-      , temperature(0.0)
-      , humidity(0.0)
-      , pressure(0.0)
+      , voltageTrend(0.0)
+      , voltageMean(0.0)
+      , voltageMin(0.0)
+      , voltageMax(0.0)
+      , voltageWindows(0)
+      , dutyProfile(DUTY_NORMAL)
+      , gpsCheckIntervalSec(10)
+      , mqttSendFactor(1)
+      , mqttKeepAliveSec(0)
+      , mqttNatTimeoutSec(0)
+      , bme280ConversionMs(0.0)
+      , bme280ChargeUAs(0.0)
       , isMoving(false)
       , movingDistance(0.0)
+      , rejectedFixes(0)
       , lastGpsUpdateSec(0)
+      , positionAccuracyM(0.0)
+      , gpsTtffSec(0.0)
+      , gpsTtffCount(0)
+      , epoAgeSec(-1)
+      , nmeaSentences(0)
+      , nmeaErrors(0)
+      , modemState(MODEM_OFF)
    {
    }
 };
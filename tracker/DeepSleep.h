@@ -23,23 +23,25 @@
 
 /**
   * Class to read/save a deepsleep counter and start the deepsleep mode
-  * if the voltage is too low.
+  * if the duty cycle profile of the voltage estimator needs it.
   */
 class MyDeepSleep
 {
 protected:
    MyOptions &myOptions;           //!< Reference to the options
    MyData    &myData;              //!< Reference to the data
+   MyEnergy  &myEnergy;            //!< Reference to the energy model
 
    long      wakeTimeStartSec;     //!< Second counter since wakeup
    uint32_t  deepSleepCounter;     //!< Counter of the deepsleep cycles
    uint32_t  deepSleepCounterInit; //!< Check if the counter was initialized
 
 public:
-   MyDeepSleep(MyOptions &options, MyData &data);
+   MyDeepSleep(MyOptions &options, MyData &data, MyEnergy &energy);
 
    bool begin();
 
+   long getSleepTimeSec();
    bool haveToSleep();
    void sleep();
 };
@@ -49,9 +51,10 @@ public:
 #define RTC_CRC_VALUE 210665 //!< Fantasy value for checking if the counter is initialized (instead of a crc).
 
 /** Constructor */
-MyDeepSleep::MyDeepSleep(MyOptions &options, MyData &data)
+MyDeepSleep::MyDeepSleep(MyOptions &options, MyData &data, MyEnergy &energy)
    : myOptions(options)
    , myData(data)
+   , myEnergy(energy)
    , wakeTimeStartSec(0)
    , deepSleepCounter(0)
    , deepSleepCounterInit(0)
@@ -78,9 +81,9 @@ bool MyDeepSleep::begin()
    ESP.rtcUserMemoryWrite(0, &deepSleepCounter, sizeof(uint32_t));
 
    if (myOptions.isDeepSleepEnabled) {
-      if (myData.voltage < myOptions.powerSaveModeVoltage) {
+      if (getSleepTimeSec() > 0) {
          MyDbg("DepSleepCounter: " + String(deepSleepCounter));
-         if (deepSleepCounter * myOptions.powerCheckIntervalSec < myOptions.deepSleepTimeSec) {
+         if (deepSleepCounter * myOptions.powerCheckIntervalSec < getSleepTimeSec()) {
             sleep();
          }
       }
@@ -93,24 +96,35 @@ bool MyDeepSleep::begin()
    return true;
 }
 
-/** Check if the configured time has elapsed and the voltage is too low then go into deep sleep. */
+/** Overall deep sleep time of the current duty cycle profile (0 = stay awake). */
+long MyDeepSleep::getSleepTimeSec()
+{
+   return myOptions.deepSleepTimeSec * MyVoltage::profiles[myData.dutyProfile].sleepFactor;
+}
+
+/** Check if the configured time has elapsed and the duty cycle profile needs the deep sleep. */
 bool MyDeepSleep::haveToSleep()
 {
    long wakeTimeSec = millis() / 1000 - wakeTimeStartSec;
 
    myData.secondsToDeepSleep = -1;
-   if (myOptions.isDeepSleepEnabled && myData.voltage < myOptions.powerSaveModeVoltage) {
+   if (myOptions.isDeepSleepEnabled && getSleepTimeSec() > 0) {
       myData.secondsToDeepSleep = myOptions.wakeTimeSec - wakeTimeSec;
    }
 
    return (myOptions.isDeepSleepEnabled && 
-           wakeTimeSec    > myOptions.wakeTimeSec &&
-           myData.voltage < myOptions.powerSaveModeVoltage);
+           wakeTimeSec       > myOptions.wakeTimeSec &&
+           getSleepTimeSec() > 0);
 }
 
-/** Entering the DeepSleep mode. Be sure we have connected the RST pin to the D0 pin for wakup. */
+/** 
+  * Entering the DeepSleep mode. Be sure we have connected the RST pin to the D0 pin for wakup.
+  * The planned sleep time is booked to the energy model before.
+  */
 void MyDeepSleep::sleep()
 {
    MyDbg("Entering DeepSleep: " + String(myOptions.powerCheckIntervalSec) + "Sec");
+   myEnergy.addDeepSleep(myOptions.powerCheckIntervalSec);
+   myEnergy.save();
    ESP.deepSleep(myOptions.powerCheckIntervalSec * 1000000);  
 }
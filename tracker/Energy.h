@@ -0,0 +1,251 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Energy.h
+  *
+  * Energy model to find out where the battery charge goes.
+  */
+
+
+#define RTC_ENERGY_OFFSET 8      //!< RTC memory block (4 bytes) of the energy data. 0-7 are used by the deepsleep counter.
+#define RTC_ENERGY_MAGIC  310718 //!< Fantasy value for checking if the energy data is initialized (instead of a crc).
+
+/**
+  * All the consumers of the energy model.
+  * They can be active at the same time.
+  */
+enum MyEnergyItem
+{
+   ENERGY_ESP,          //!< ESP8266 is awake.
+   ENERGY_WIFI,         //!< WiFi is switched on.
+   ENERGY_MODEM_SLEEP,  //!< sim808 is powered and in slow clock mode.
+   ENERGY_MODEM_IDLE,   //!< sim808 is powered and awake.
+   ENERGY_MODEM_ACTIVE, //!< sim808 is powered and communicates.
+   ENERGY_GNSS,         //!< GNSS part of the sim808 is switched on.
+   ENERGY_GPRS,         //!< GPRS data transfer.
+   ENERGY_DEEP_SLEEP,   //!< ESP8266 is in deep sleep.
+   ENERGY_ITEMS         //!< Number of energy items.
+};
+
+/**
+  * Energy data which are stored in the RTC memory to survive the deep sleep.
+  */
+class MyEnergyRtc
+{
+public:
+   uint32_t magic;              //!< Is the RTC memory initialized?
+   uint32_t reserved;           //!< Alignment of the double values.
+   double   sec[ENERGY_ITEMS];  //!< Active time of every consumer.
+   double   mAh[ENERGY_ITEMS];  //!< Used charge of every consumer.
+};
+
+/**
+  * Energy accounting. Every consumer is switched on and off by its subsystem.
+  * The active time is weighted with the current from the options.
+  */
+class MyEnergy
+{
+public:
+   static const char *names[ENERGY_ITEMS]; //!< Names of the consumers.
+
+protected:
+   MyOptions    &myOptions;                //!< Reference to the options.
+   MyData       &myData;                   //!< Reference to the data.
+   MyEnergyRtc   rtc;                      //!< Accumulated values (RTC memory image).
+   bool          active[ENERGY_ITEMS];     //!< Is the consumer currently active?
+   unsigned long activeSinceMs[ENERGY_ITEMS]; //!< Start of the not yet accumulated active time.
+
+protected:
+   void add(MyEnergyItem item, unsigned long ms);
+
+public:
+   MyEnergy(MyOptions &options, MyData &data);
+
+   bool begin();
+
+   void   set(MyEnergyItem item, bool isActive);
+   void   addDeepSleep(long sec);
+   void   update();
+   void   save();
+   void   reset();
+
+   double getMA(MyEnergyItem item);
+   double getSec(MyEnergyItem item);
+   double getMAh(MyEnergyItem item);
+   double getUptimeSec();
+   double getTotalMAh();
+   double getAverageMA();
+   String getProfile();
+};
+
+/* ******************************************** */
+
+const char *MyEnergy::names[ENERGY_ITEMS] = {
+   "ESP", "WiFi", "Modem Sleep", "Modem Idle", "Modem Active", "GNSS", "GPRS", "DeepSleep"
+};
+
+/** Constructor */
+MyEnergy::MyEnergy(MyOptions &options, MyData &data)
+   : myOptions(options)
+   , myData(data)
+{
+   reset();
+}
+
+/** Read the accumulated values from the RTC memory and start the ESP consumer. */
+bool MyEnergy::begin()
+{
+   MyDbg("MyEnergy::begin");
+
+   MyEnergyRtc tmp;
+
+   ESP.rtcUserMemoryRead(RTC_ENERGY_OFFSET, (uint32_t *) &tmp, sizeof(tmp));
+   if (tmp.magic == RTC_ENERGY_MAGIC) {
+      rtc = tmp;
+   }
+   set(ENERGY_ESP, true);
+   return true;
+}
+
+/** Clear all the accumulated values. */
+void MyEnergy::reset()
+{
+   memset(&rtc, 0, sizeof(rtc));
+   rtc.magic = RTC_ENERGY_MAGIC;
+   for (int i = 0; i < ENERGY_ITEMS; i++) {
+      active[i]        = false;
+      activeSinceMs[i] = 0;
+   }
+}
+
+/** Configured current of one consumer in mA. */
+double MyEnergy::getMA(MyEnergyItem item)
+{
+   switch (item) {
+      case ENERGY_ESP:          return myOptions.energyEspMA;
+      case ENERGY_WIFI:         return myOptions.energyWifiMA;
+      case ENERGY_MODEM_SLEEP:  return myOptions.energyModemSleepMA;
+      case ENERGY_MODEM_IDLE:   return myOptions.energyModemIdleMA;
+      case ENERGY_MODEM_ACTIVE: return myOptions.energyModemActiveMA;
+      case ENERGY_GNSS:         return myOptions.energyGnssMA;
+      case ENERGY_GPRS:         return myOptions.energyGprsMA;
+      case ENERGY_DEEP_SLEEP:   return myOptions.energyDeepSleepMA;
+      default:                  return 0.0;
+   }
+}
+
+/** Accumulate time and charge of one consumer. */
+void MyEnergy::add(MyEnergyItem item, unsigned long ms)
+{
+   rtc.sec[item] += ms / 1000.0;
+   rtc.mAh[item] += getMA(item) * ms / 3600000.0;
+}
+
+/** Switch on or off one consumer. */
+void MyEnergy::set(MyEnergyItem item, bool isActive)
+{
+   unsigned long currMs = millis();
+
+   if (active[item] && !isActive) {
+      add(item, currMs - activeSinceMs[item]);
+   }
+   if (!active[item] && isActive) {
+      activeSinceMs[item] = currMs;
+   }
+   active[item] = isActive;
+}
+
+/** Add the planned deep sleep time before entering the deep sleep. */
+void MyEnergy::addDeepSleep(long sec)
+{
+   add(ENERGY_DEEP_SLEEP, sec * 1000);
+}
+
+/** Accumulate the time of all the active consumers. */
+void MyEnergy::update()
+{
+   unsigned long currMs = millis();
+
+   for (int i = 0; i < ENERGY_ITEMS; i++) {
+      if (active[i]) {
+         add((MyEnergyItem) i, currMs - activeSinceMs[i]);
+         activeSinceMs[i] = currMs;
+      }
+   }
+}
+
+/** Write the accumulated values into the RTC memory. */
+void MyEnergy::save()
+{
+   update();
+   ESP.rtcUserMemoryWrite(RTC_ENERGY_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+}
+
+/** Active time of one consumer in seconds. */
+double MyEnergy::getSec(MyEnergyItem item)
+{
+   return rtc.sec[item];
+}
+
+/** Used charge of one consumer in mAh. */
+double MyEnergy::getMAh(MyEnergyItem item)
+{
+   return rtc.mAh[item];
+}
+
+/** Time since power on (awake and deep sleep) in seconds. */
+double MyEnergy::getUptimeSec()
+{
+   update();
+   return rtc.sec[ENERGY_ESP] + rtc.sec[ENERGY_DEEP_SLEEP];
+}
+
+/** Used charge of all consumers in mAh. */
+double MyEnergy::getTotalMAh()
+{
+   double ret = 0.0;
+
+   for (int i = 0; i < ENERGY_ITEMS; i++) {
+      ret += rtc.mAh[i];
+   }
+   return ret;
+}
+
+/** Average current over the awake and deep sleep time in mA. */
+double MyEnergy::getAverageMA()
+{
+   double hours = getUptimeSec() / 3600.0;
+
+   if (hours <= 0.0) {
+      return 0.0;
+   }
+   return getTotalMAh() / hours;
+}
+
+/** Comma separated charge of all consumers in mAh (in the order of MyEnergyItem). */
+String MyEnergy::getProfile()
+{
+   String ret;
+
+   for (int i = 0; i < ENERGY_ITEMS; i++) {
+      if (i > 0) {
+         ret += ',';
+      }
+      ret += String(rtc.mAh[i], 1);
+   }
+   return ret;
+}
@@ -34,8 +34,11 @@ public:
    MyDegrees();
    MyDegrees(const MyDegrees &myDegrees);
 
+   MyDegrees &operator=(const MyDegrees &myDegrees);
+
    double value();
    bool   set(const String &data);
+   bool   setNmea(const char *term);
 };
 
 /**
@@ -44,6 +47,7 @@ public:
 class MyLocation
 {
 friend class MyGps;
+friend class MyNmeaParser;
 protected:
    MyDegrees latitude_;  //!< Latitude
    MyDegrees longitude_; //!< Longitude
@@ -66,6 +70,7 @@ public:
 class MyDate
 {
 friend class MyGps;
+friend class MyNmeaParser;
 protected:
    int date; //!< Date in the form of YearMonthDay i.e. 20170115
       
@@ -86,6 +91,7 @@ public:
 class MyTime
 {
 friend class MyGps;
+friend class MyNmeaParser;
 protected:
   int time; //!< Time in the form of HoursMinutesSecons i.e. 120135
   
@@ -163,6 +169,15 @@ MyDegrees::MyDegrees(const MyDegrees &myDegrees)
 {
 }
 
+/** Assignment operator matching the copy constructor. */
+MyDegrees &MyDegrees::operator=(const MyDegrees &myDegrees)
+{
+   predecimal = myDegrees.predecimal;
+   billionths = myDegrees.billionths;
+   negative   = myDegrees.negative;
+   return *this;
+}
+
 /** Recalculate the value from the pre and post decimal to double. */
 double MyDegrees::value()
 {
@@ -195,6 +210,32 @@ bool MyDegrees::set(const String &data)
    return true;
 }
 
+/** 
+  * Sets the internal format from the nmea format (dddmm.mmmm). 
+  * The sign is given by the hemisphere term.
+  */
+bool MyDegrees::setNmea(const char *term)
+{
+   uint32_t leftOfDecimal = (uint32_t) atol(term);
+   uint32_t multiplier    = 10000000UL;
+   uint32_t tenMillionths = (leftOfDecimal % 100) * multiplier; // of the minutes
+
+   predecimal = (int16_t) (leftOfDecimal / 100);
+
+   while (isdigit(*term)) {
+      ++term;
+   }
+
+   if (*term == '.') {
+      while (isdigit(*++term)) {
+         multiplier /= 10;
+         tenMillionths += (*term - '0') * multiplier;
+      }
+   }
+   billionths = (5 * tenMillionths + 1) / 3;
+   return true;
+}
+
 /** Calculate the distance between two gps positions in meter */
 double MyLocation::distanceBetween(double lat1, double long1, double lat2, double long2)
 {
@@ -23,8 +23,34 @@
 
 #define  TINY_GSM_YIELD() { myDelay(1); } //!< Overwrite the yield macro with our own delay function.
 #include "Sim808.h"
+#include "Nmea.h"
+#include "Motion.h"
 #include "Serial.h"
 
+#define RTC_GPS_OFFSET    (RTC_HISTORY_OFFSET + sizeof(MyHistoryRtc) / 4) //!< RTC memory block behind the history data.
+#define RTC_GPS_MAGIC     181026       //!< Fantasy value for checking if the gps data is initialized.
+#define EPO_FILE_NAME     "/epo.txt"   //!< SPIFFS file with the download time of the EPO data in the sim808.
+#define EPO_UNKNOWN_UTC   1            //!< Download time of EPO data which was fetched before the time was known.
+#define EPO_RETRY_SEC     3600         //!< Wait time after a failed EPO download.
+
+/**
+  * Last gps fix which is stored in the RTC memory to survive the deep sleep.
+  * Together with the uptime of the energy model it gives the time for the next gps start.
+  */
+class MyGpsRtc
+{
+public:
+   uint32_t magic;         //!< Is the RTC memory initialized?
+   float    latitude;      //!< Latitude of the last fix.
+   float    longitude;     //!< Longitude of the last fix.
+   float    altitude;      //!< Altitude of the last fix.
+   uint32_t fixUtc;        //!< UTC of the last fix in seconds since 1970 (0 = no fix).
+   uint32_t fixUptimeSec;  //!< Uptime of the energy model at the last fix.
+   uint32_t motionState;   //!< Motion state of the last fix.
+   float    parkLatitude;  //!< Park position of the motion detection.
+   float    parkLongitude; //!< Park position of the motion detection.
+};
+
 /**
   * SIM808 Communication class to handle gprs and gps activities.
   */
@@ -34,48 +60,87 @@ public:
    MySerial         gsmSerial;         //!< Serial interface to the sim808 modul.
    MyGsmSim808      gsmSim808;         //!< SIM808 interface class 
    TinyGsmClient    gsmClient;         //!< Gsm client interface
+   TinyGsmClientUdp gsmUdpClient;      //!< Gsm datagram interface for MQTT-SN
    
    bool             isSimActive;      //!< Is the sim808 modul started?
    bool             isGsmActive;      //!< Is the gsm part of the sim808 activated?
    bool             isGpsActive;      //!< Is the gs part of the sim808 activated?
-   long             gpsLastCheckSec;  //!< Timestamps of the last gps check.
+   bool             isNmeaActive;     //!< Is the nmea stream of the gnss engine switched on?
 
    MyGps            gps;              //!< Last gps values.
-   MyLocation       lastLocation;     //!< Last gps location to check for moving.
-
+   MyMotionFilter   motion;           //!< Position filter and motion detection.
+   MyNmeaParser     nmeaParser;       //!< Parser of the nmea stream.
+   MyGpsRtc         rtc;              //!< Last fix for the assisted start (RTC memory image).
+   uint32_t         epoUtc;           //!< Download time of the EPO data in the sim808 (0 = none).
+   long             epoNextTrySec;    //!< Earliest time of the next EPO download.
+   long             epoStartSec;      //!< Start time of the running EPO download (-1 = none).
+   unsigned long    gpsStartMs;       //!< Start time of the gnss for the time to first fix.
+   bool             isTtffPending;    //!< Is the first fix after the gnss start outstanding?
+
+   MyGsmPower      &myGsmPower;       //!< Reference to the power state machine.
+   MyEnergy        &myEnergy;         //!< Reference to the energy model.
    MyOptions       &myOptions;        //!< Reference to the options.
    MyData          &myData;           //!< Reference to the data.
 
 protected:
    void enableGps(bool enable);
+   void enableNmea(bool enable);
+   void assistGps();
+   void updateEpo();
+   void checkEpo(uint32_t utc, long sec);
+   bool loadEpoInfo();
+   bool saveEpoInfo();
+   void saveFix();
+   uint32_t getUtc();
    bool getGps();
+   bool setGpsData();
    bool sleepMode2();
 
 public:
-   MyGsmGps(MyOptions &options, MyData &data, short pinRx, short pinTx);
+   MyGsmGps(MyGsmPower &gsmPower, MyEnergy &energy, MyOptions &options, MyData &data, short pinRx, short pinTx);
 
    bool begin();
    void handleClient();
+   void handlePower();
+   void handleNmea();
    bool stop();
 
+   void wakeUp();
+
    bool sendAT(String cmd);
 
-   bool getSMS(SmsData &sms);
+   bool getServingCell(MyCell &cell);
+
+   int  listSMS(bool isUnread, int skip, SmsData *list, int maxCount, int &total);
+   bool readSMS(long index, SmsData &sms);
+   bool hasNewSms();
+   long getNewSmsIndex();
    bool sendSMS(String phoneNumber, String message);
    bool deleteSMS(long index);
+   bool deleteReadSMS();
 };
 
 /* ******************************************** */
 
 /** Constructor */
-MyGsmGps::MyGsmGps(MyOptions &options, MyData &data, short pinRx, short pinTx)
+MyGsmGps::MyGsmGps(MyGsmPower &gsmPower, MyEnergy &energy, MyOptions &options, MyData &data, short pinRx, short pinTx)
    : gsmSerial(data.logInfos, options.isDebugActive, pinRx, pinTx)
    , gsmSim808(gsmSerial)
    , gsmClient(gsmSim808)
+   , gsmUdpClient(gsmSim808, 2)
    , isSimActive(false)
    , isGsmActive(false)
    , isGpsActive(false)
-   , gpsLastCheckSec(0)
+   , isNmeaActive(false)
+   , motion(options)
+   , nmeaParser(gps)
+   , epoUtc(0)
+   , epoNextTrySec(0)
+   , epoStartSec(-1)
+   , gpsStartMs(0)
+   , isTtffPending(false)
+   , myGsmPower(gsmPower)
+   , myEnergy(energy)
    , myOptions(options)
    , myData(data)
 {
@@ -90,6 +155,19 @@ bool MyGsmGps::begin()
       return false;
    }
 
+   MyGpsRtc tmp;
+
+   ESP.rtcUserMemoryRead(RTC_GPS_OFFSET, (uint32_t *) &tmp, sizeof(tmp));
+   if (tmp.magic == RTC_GPS_MAGIC) {
+      rtc = tmp;
+      motion.begin((MyMotionState) rtc.motionState, rtc.parkLatitude, rtc.parkLongitude);
+   } else {
+      memset(&rtc, 0, sizeof(rtc));
+      rtc.magic = RTC_GPS_MAGIC;
+   }
+   loadEpoInfo();
+
+   myGsmPower.activity();
    if (!isSimActive) {
       MyDbg("MyGsmGps::begin");
       myData.status = "Sim808 Initializing...";
@@ -141,7 +219,8 @@ bool MyGsmGps::begin()
       }
 
       MyDbg((String) "GPRS: " + myOptions.gprsAP);
-      if (!gsmSim808.gprsConnect(myOptions.gprsAP.c_str(), "", "")) {
+      // Keep an existing gprs context instead of attaching again
+      if (!gsmSim808.isGprsConnected() && !gsmSim808.gprsConnect(myOptions.gprsAP.c_str(), "", "")) {
          myData.status = "Sim808 gprs connection failed!";
          MyDbg(myData.status);
          while (true);
@@ -161,29 +240,92 @@ bool MyGsmGps::begin()
       myData.cop = gsmSim808.getOperator();
       MyDbg("cop: " + myData.modemInfo);
 
+      if (!gsmSim808.setNewSmsIndication()) {
+         MyDbg("Sim808 sms indication failed");
+      }
+
       isGsmActive = true;
+      updateEpo();
    }
+   myGsmPower.activity();
    return true;
 }
 
-/** Checks the gps from time to time if enabled. */
+/** Checks the gps if enabled. Called by the scheduler every gpsCheckIntervalSec. */
 void MyGsmGps::handleClient()
 {
    if (!isSimActive) {
       return;
    }
 
-   long currSec = millis() / 1000;
+   if (myOptions.isGpsEnabled && !isGpsActive) {
+      enableGps(true);
+   }
+   if (isGpsActive && myOptions.isGpsStreamEnabled != isNmeaActive) {
+      enableNmea(myOptions.isGpsStreamEnabled);
+   }
+   getGps();
+   updateEpo();
+}
+
+/** 
+  * Enable or disable the slow clock mode (AT+CSCLK=1) like in the options and 
+  * process the unsolicited result codes (sms, gprs data, ...). A sleeping sim808 is woken up.
+  * Buffered socket data older than TINY_GSM_TX_TIMEOUT is sent by the maintain() call.
+  * The nmea stream keeps the serial interface busy, so there is no slow clock mode with it.
+  */
+void MyGsmGps::handlePower()
+{
+   if (!isSimActive) {
+      return;
+   }
+
+   bool isSleepEnabled = myOptions.isModemSleepEnabled && !isNmeaActive;
 
-   if (currSec - gpsLastCheckSec > myOptions.gpsCheckIntervalSec) {
-      gpsLastCheckSec = currSec;
-      if (myOptions.isGpsEnabled && !isGpsActive) {
-         enableGps(true);
+   if (isSleepEnabled != myGsmPower.hasSlowClock()) {
+      wakeUp();
+      if (gsmSim808.sleepEnable(isSleepEnabled)) {
+         MyDbg(isSleepEnabled ? "Sim808 slow clock enabled" : "Sim808 slow clock disabled");
+         myGsmPower.setSlowClock(isSleepEnabled);
       }
-      getGps();
+   }
+   gsmSerial.readNmea();
+   if (gsmSerial.available() || gsmClient.isTxStale()) {
+      if (myGsmPower.isSleeping() && gsmSerial.available()) {
+         MyDbg("Sim808 wakeup on URC");
+      }
+      wakeUp();
+      gsmSim808.maintain();
+   }
+}
+
+/** 
+  * Parse the received nmea sentences and take over a new fix without any AT command.
+  * Called by the scheduler every NMEA_TASK_MS.
+  */
+void MyGsmGps::handleNmea()
+{
+   if (!isNmeaActive) {
+      return;
+   }
+
+   gsmSerial.readNmea();
+   myData.nmeaSentences = nmeaParser.sentences;
+   myData.nmeaErrors    = nmeaParser.checksumErrors;
+   if (nmeaParser.getNewFix()) {
+      setGpsData();
    }
 }
 
+/** Wakeup the sim808 from the slow clock mode and mark the AT communication. */
+void MyGsmGps::wakeUp()
+{
+   if (myGsmPower.wake()) {
+      gsmSim808.testAT(1000);
+   }
+   myGsmPower.activity();
+}
+
 /** Stops the sim808 modul and go to deep sleep mode. */
 bool MyGsmGps::stop()
 {
@@ -191,6 +333,9 @@ bool MyGsmGps::stop()
    
    MyDbg("gprs gps stopping");
    enableGps(false);
+   if (epoStartSec >= 0) {
+      gsmSim808.stopEpoDownload();
+   }
    if (gsmSim808.isGprsConnected()) {
       ret = gsmSim808.gprsDisconnect();
    }  
@@ -198,6 +343,10 @@ bool MyGsmGps::stop()
       isGsmActive = false;
       isGpsActive = false;
       isSimActive = false;
+      if (epoStartSec >= 0) {
+         epoStartSec = -1;
+         myEnergy.set(ENERGY_GPRS, false);
+      }
       MyDbg("gprs gps stopped");
       myData.status = "Sim808 stopped!";
       sleepMode2();
@@ -215,6 +364,7 @@ bool MyGsmGps::sendAT(String cmd)
 
    String response;
 
+   wakeUp();
    gsmSerial.print(cmd);
    gsmSerial.print("\r\n");
    gsmSim808.waitResponse(1000, response);
@@ -229,16 +379,55 @@ bool MyGsmGps::sleepMode2()
    return sendAT(GF("+CSCLK=2"));
 }
 
-/** Read one sms if available. */
-bool MyGsmGps::getSMS(SmsData &sms)
+/** Identification of the serving gsm cell. */
+bool MyGsmGps::getServingCell(MyCell &cell)
+{
+   if (!isGsmActive) {
+      MyDbg("gsm not active!");
+      return false;
+   }
+
+   wakeUp();
+   return gsmSim808.getServingCell(cell);
+}
+
+/** Read the unread or read sms (maximum maxCount behind skip) with one listing. */
+int MyGsmGps::listSMS(bool isUnread, int skip, SmsData *list, int maxCount, int &total)
+{
+   total = 0;
+   if (!isGsmActive) {
+      MyDbg("gsm not active!");
+      return 0;
+   }
+
+   MyDbg("listSMS");
+   wakeUp();
+   return gsmSim808.listSMS(isUnread, skip, list, maxCount, total);
+}
+
+/** Read one sms with a known index from the sim card. */
+bool MyGsmGps::readSMS(long index, SmsData &sms)
 {
    if (!isGsmActive) {
       MyDbg("gsm not active!");
       return false;
    }
 
-   MyDbg("getSMS");
-   return gsmSim808.getSMS(sms);
+   MyDbg("readSMS: " + String(index));
+   wakeUp();
+   return gsmSim808.readSMS(index, sms);
+}
+
+/** Was a new sms indicated by the sim808 (+CMTI)? No AT communication. */
+bool MyGsmGps::hasNewSms()
+{
+   return isGsmActive && gsmSim808.hasNewSms();
+}
+
+/** Index of the next indicated sms or -1. */
+long MyGsmGps::getNewSmsIndex()
+{
+   return gsmSim808.getNewSmsIndex();
 }
 
 /** Send one sms to a specific phone number via gsm. */
@@ -250,6 +439,7 @@ bool MyGsmGps::sendSMS(String phoneNumber, String message)
    }
 
    MyDbg("sendSMS: " + message);
+   wakeUp();
    return gsmSim808.sendSMS(phoneNumber, message);
 }
 
@@ -262,9 +452,23 @@ bool MyGsmGps::deleteSMS(long index)
    }
 
    MyDbg("deleteSMS: " + String(index));
+   wakeUp();
    return gsmSim808.deleteSMS(index);
 }
 
+/** Delete all the read sms with one command. */
+bool MyGsmGps::deleteReadSMS()
+{
+   if (!isGsmActive) {
+      MyDbg("gsm not active!");
+      return false;
+   }
+
+   MyDbg("deleteReadSMS");
+   wakeUp();
+   return gsmSim808.deleteReadSMS();
+}
+
 /** Switch on the gps part of the sim808 modul. */
 void MyGsmGps::enableGps(bool enable)
 {
@@ -273,17 +477,221 @@ void MyGsmGps::enableGps(bool enable)
       return;
    }
 
+   wakeUp();
    if (enable) {
       gsmSim808.enableGPS();
       myData.status = "Sim808 gps enabled!";
       MyDbg(myData.status);
-      isGpsActive = true;
+      isGpsActive   = true;
+      gpsStartMs    = millis();
+      isTtffPending = true;
+      assistGps();
+      if (myOptions.isGpsStreamEnabled) {
+         enableNmea(true);
+      }
    } else {
+      if (isNmeaActive) {
+         enableNmea(false);
+      }
       gsmSim808.disableGPS();
       myData.status = "Sim808 gps disabled!";
       MyDbg(myData.status);
       isGpsActive = false;
    }
+   myEnergy.set(ENERGY_GNSS, isGpsActive);
+}
+
+/** 
+  * Switch the nmea output of the gnss engine to the serial interface on or off.
+  * Only the RMC, GGA and GSA sentences are sent (PMTK314) once per second.
+  */
+void MyGsmGps::enableNmea(bool enable)
+{
+   wakeUp();
+   if (enable) {
+      gsmSim808.sendGnssCmd("PMTK314,0,1,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0");
+      gsmSerial.setNmeaParser(&nmeaParser);
+      gsmSim808.sendAT(GF("+CGNSTST=1"));
+      gsmSim808.waitResponse();
+      MyDbg("Sim808 nmea stream enabled");
+   } else {
+      gsmSim808.sendAT(GF("+CGNSTST=0"));
+      gsmSim808.waitResponse();
+      gsmSerial.setNmeaParser(NULL);
+      MyDbg("Sim808 nmea stream disabled");
+   }
+   isNmeaActive = enable;
+}
+
+/** 
+  * Current UTC from the last fix and the uptime of the energy model since then.
+  * Returns 0 if there was no fix since the power on.
+  */
+uint32_t MyGsmGps::getUtc()
+{
+   uint32_t uptimeSec = (uint32_t) myEnergy.getUptimeSec();
+
+   if (rtc.fixUtc == 0 || uptimeSec < rtc.fixUptimeSec) {
+      return 0;
+   }
+   return rtc.fixUtc + (uptimeSec - rtc.fixUptimeSec);
+}
+
+/**
+  * Speed up the first fix of a gps start: The EPO data (satellite orbits) is handed 
+  * over to the gnss engine if it is not outdated and the last position with the 
+  * current time is injected (PMTK741) for a hot start.
+  */
+void MyGsmGps::assistGps()
+{
+   uint32_t utc      = getUtc();
+   long     validSec = myOptions.agpsValidHours * 3600;
+   String   assist;
+
+   myData.gpsAssist = "cold";
+   if (!myOptions.isAgpsEnabled) {
+      return;
+   }
+   if (epoUtc != 0 && (utc == 0 || epoUtc == EPO_UNKNOWN_UTC || utc < epoUtc + validSec)) {
+      if (gsmSim808.loadEpo()) {
+         assist = "EPO";
+      } else {
+         MyDbg("EPO data invalid");
+         epoUtc = 0;
+         saveEpoInfo();
+      }
+   }
+   if (utc != 0) {
+      int year, month, day, hour, minute, second;
+
+      FromEpoch(utc, year, month, day, hour, minute, second);
+      if (gsmSim808.sendGnssCmd("PMTK741," + String(rtc.latitude, 6) + "," + String(rtc.longitude, 6) + "," + 
+                                String(rtc.altitude, 0) + "," + String(year) + "," + String(month) + "," + 
+                                String(day) + "," + String(hour) + "," + String(minute) + "," + String(second))) {
+         assist += assist != "" ? " + position" : "position";
+      }
+   }
+   if (assist != "") {
+      myData.gpsAssist = assist;
+   }
+   MyDbg("gps start: " + myData.gpsAssist);
+}
+
+/** 
+  * Start a download of new EPO data into the sim808 if it is missing or outdated and the gprs is connected.
+  * A running download is only polled, so the scheduler is not blocked by the ftp transfer.
+  * Data which was fetched before the time was known gets its time with the next fix.
+  */
+void MyGsmGps::updateEpo()
+{
+   uint32_t utc      = getUtc();
+   long     validSec = myOptions.agpsValidHours * 3600;
+   long     sec      = millis() / 1000;
+
+   if (epoUtc == EPO_UNKNOWN_UTC && utc != 0) {
+      epoUtc = utc;
+      saveEpoInfo();
+   }
+   myData.epoAgeSec = (epoUtc > EPO_UNKNOWN_UTC && utc != 0) ? (long) (utc - epoUtc) : -1;
+
+   if (epoStartSec >= 0) {
+      checkEpo(utc, sec);
+      return;
+   }
+   if (!myOptions.isAgpsEnabled || myOptions.agpsServer == "" || !isGsmActive || sec < epoNextTrySec) {
+      return;
+   }
+   if (epoUtc != 0 && (utc == 0 || epoUtc == EPO_UNKNOWN_UTC || utc < epoUtc + validSec)) {
+      return;
+   }
+
+   MyDbg("EPO download: " + myOptions.agpsFile);
+   wakeUp();
+   if (!gsmSim808.startEpoDownload(myOptions.agpsServer, myOptions.agpsUser, myOptions.agpsPassword, myOptions.agpsFile)) {
+      MyDbg("EPO download failed");
+      gsmSim808.stopEpoDownload();
+      epoNextTrySec = sec + EPO_RETRY_SEC;
+      return;
+   }
+   epoStartSec = sec;
+   myEnergy.set(ENERGY_GPRS, true);
+}
+
+/** Poll the running EPO download and take over the data when it is finished. */
+void MyGsmGps::checkEpo(uint32_t utc, long sec)
+{
+   bool ok = false;
+
+   if (!gsmSim808.checkEpoDownload(ok) && sec - epoStartSec < EPO_DOWNLOAD_SEC) {
+      return;
+   }
+   epoStartSec = -1;
+   myEnergy.set(ENERGY_GPRS, false);
+   if (!ok) {
+      MyDbg("EPO download failed");
+      gsmSim808.stopEpoDownload();
+      epoNextTrySec = sec + EPO_RETRY_SEC;
+      return;
+   }
+   epoUtc = utc != 0 ? utc : EPO_UNKNOWN_UTC;
+   saveEpoInfo();
+   myData.epoAgeSec = utc != 0 ? 0 : -1;
+   if (isGpsActive && isTtffPending && gsmSim808.loadEpo()) {
+      myData.gpsAssist = myData.gpsAssist == "cold" ? "EPO" : myData.gpsAssist + " + EPO";
+   }
+}
+
+/** Read the download time of the EPO data in the sim808 from the SPIFFS. */
+bool MyGsmGps::loadEpoInfo()
+{
+   File file = SPIFFS.open(EPO_FILE_NAME, "r");
+
+   epoUtc = 0;
+   if (!file) {
+      return false;
+   }
+   epoUtc = (uint32_t) atol(file.readStringUntil('\n').c_str());
+   file.close();
+   return true;
+}
+
+/** Save the download time of the EPO data (the data itself stays in the file system of the sim808). */
+bool MyGsmGps::saveEpoInfo()
+{
+   File file = SPIFFS.open(EPO_FILE_NAME, "w");
+
+   if (!file) {
+      MyDbg("Failed to write " EPO_FILE_NAME);
+      return false;
+   }
+   file.println(String(epoUtc));
+   file.close();
+   return true;
+}
+
+/** 
+  * Keep the current fix in the RTC memory for the next gps start and 
+  * measure the time to first fix of the running gps start.
+  */
+void MyGsmGps::saveFix()
+{
+   rtc.latitude     = gps.location.latitude();
+   rtc.longitude    = gps.location.longitude();
+   rtc.altitude     = gps.altitude;
+   rtc.fixUtc       = ToEpoch(gps.date.year(), gps.date.month(), gps.date.day(), 
+                              gps.time.hour(), gps.time.minute(), gps.time.second());
+   rtc.fixUptimeSec  = (uint32_t) myEnergy.getUptimeSec();
+   rtc.motionState   = motion.getState();
+   rtc.parkLatitude  = motion.getParkLatitude();
+   rtc.parkLongitude = motion.getParkLongitude();
+   ESP.rtcUserMemoryWrite(RTC_GPS_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+
+   if (isTtffPending) {
+      isTtffPending       = false;
+      myData.gpsTtffSec   = (millis() - gpsStartMs) / 1000.0;
+      myData.gpsTtffCount++;
+      MyDbg("(gps) ttff: " + String(myData.gpsTtffSec, 1) + " s (" + myData.gpsAssist + ")");
+   }
 }
 
 /** Read one gps position with the sim808 modul and save the values in the global data. */
@@ -298,20 +706,17 @@ bool MyGsmGps::getGps()
 
    if (isGpsActive) {
       MyDbg("getGPS");
-      if (gsmSim808.getGPS(gps)) {
+      wakeUp();
+      if (isNmeaActive) {
+         // The gps values come with the nmea stream, only the modem values are polled
          myData.signalQuality    = String(gsmSim808.getSignalQuality());
          myData.batteryLevel     = String(gsmSim808.getBattPercent());
          myData.batteryVolt      = String(gsmSim808.getBattVoltage() / 1000.0F, 6);
-            
-         myData.longitude        = String(gps.location.longitude(), 6);
-         myData.latitude         = String(gps.location.latitude(),  6);
-         myData.altitude         = String(gps.altitude, 2); 
-         myData.kmph             = String(gps.speed,    2); 
-         myData.satellites       = String(gps.satellitesUsed); 
-         myData.course           = String(gps.course); 
-         myData.gpsDate          = String(gps.date.day())  + '-' + String(gps.date.month())  + '-' + String(gps.date.year());
-         myData.gpsTime          = String(gps.time.hour()) + ':' + String(gps.time.minute()) + ':' + String(gps.time.second());
-         myData.lastGpsUpdateSec = millis() / 1000;
+      } else if (gsmSim808.getGPS(gps)) {
+         myData.signalQuality    = String(gsmSim808.getSignalQuality());
+         myData.batteryLevel     = String(gsmSim808.getBattPercent());
+         myData.batteryVolt      = String(gsmSim808.getBattVoltage() / 1000.0F, 6);
+         ret = setGpsData();
    
          MyDbg("(sim808) signalQuality: " + myData.signalQuality);
          MyDbg("(sim808) batteryLevel: "  + myData.batteryLevel);
@@ -324,14 +729,38 @@ bool MyGsmGps::getGps()
          MyDbg("(gps) course: "           + myData.course);
          MyDbg("(gps) gpsDate: "          + myData.gpsDate);
          MyDbg("(gps) gpsTime: "          + myData.gpsTime);
-    
-         if (lastLocation.latitude() != 0) {
-            myData.movingDistance = gps.location.distanceTo(lastLocation);
-            myData.isMoving       = myData.movingDistance > myOptions.minMovingDistance;
-            lastLocation          = gps.location;
-            ret = true;
-         }
       }
    }
    return ret;
 }
+
+/**
+  * Save the values of a new fix in the global data. The position is filtered
+  * and gives the motion state. Returns false if the fix was rejected as outlier.
+  */
+bool MyGsmGps::setGpsData()
+{
+   if (!motion.update(gps.location.latitude(), gps.location.longitude(), gps.hdop, gps.pdop, millis(), 
+                      myData.gpsCheckIntervalSec)) {
+      myData.rejectedFixes++;
+      MyDbg("(gps) fix rejected, hdop " + String(gps.hdop, 1) + ", pdop " + String(gps.pdop, 1));
+      return false;
+   }
+
+   myData.longitude         = String(motion.getLongitude(), 6);
+   myData.latitude          = String(motion.getLatitude(),  6);
+   myData.altitude          = String(gps.altitude, 2); 
+   myData.kmph              = String(gps.speed,    2); 
+   myData.satellites        = String(gps.satellitesUsed); 
+   myData.course            = String(gps.course); 
+   myData.gpsDate           = String(gps.date.day())  + '-' + String(gps.date.month())  + '-' + String(gps.date.year());
+   myData.gpsTime           = String(gps.time.hour()) + ':' + String(gps.time.minute()) + ':' + String(gps.time.second());
+   myData.lastGpsUpdateSec  = millis() / 1000;
+   myData.positionSource    = "GNSS";
+   myData.positionAccuracyM = gps.hdop * GPS_UERE_M;
+   myData.motionState       = MyMotionFilter::names[motion.getState()];
+   myData.isMoving          = motion.isMoving();
+   myData.movingDistance    = motion.getParkDistance();
+   saveFix();
+   return true;
+}
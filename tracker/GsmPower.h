@@ -21,28 +21,60 @@
   */
 
 
+#define MODEM_DTR_WAKEUP_MS     100  //!< Time for DTR low to wakeup the sim808 from slow clock mode.
+#define MODEM_ACTIVE_TIMEOUT_MS 1000 //!< Time without AT communication to switch from active to idle.
+#define MODEM_SLEEP_TIMEOUT_MS  5000 //!< Time without AT communication to switch from idle to sleep.
+
 /**
-  * Class to switch on/off the DC-DC modul LM2596.
+  * Power state machine of the sim808 modul.
+  * Switch on/off the DC-DC modul LM2596 and use the DTR pin to enter or leave the 
+  * slow clock mode (AT+CSCLK=1) between the AT bursts. The time and the charge 
+  * spent in every state is collected in the energy model.
   */
 class MyGsmPower
 {
 protected:
-   int pinPower; //!< esp8266 pin connected with pin 5 of the LM2596 modul. 
+   MyOptions    &myOptions;      //!< Reference to the options.
+   MyData       &myData;         //!< Reference to the data.
+   MyEnergy     &myEnergy;       //!< Reference to the energy model.
+   int           pinPower;       //!< esp8266 pin connected with pin 5 of the LM2596 modul. 
+   int           pinDtr;         //!< esp8266 pin connected with the DTR pin of the sim808 modul.
+   bool          isSlowClock;    //!< Is the slow clock mode (AT+CSCLK=1) enabled on the sim808?
+   unsigned long lastActivityMs; //!< Time of the last AT communication.
       
+protected:
+   void setState(MyModemState state);
+   void setEnergy(MyModemState state, bool isActive);
+
 public:
-   MyGsmPower(int pin);
+   MyGsmPower(MyOptions &options, MyData &data, MyEnergy &energy, int pinPower, int pinDtr);
    
    bool begin();
 
    void on();
    void off();   
+
+   void setSlowClock(bool enable);
+   bool hasSlowClock();
+   bool sleep();
+   bool wake();
+   bool isSleeping();
+   void activity();
+
+   void handleClient();
 };
 
 /* ******************************************** */
 
 /** Constructor */
-MyGsmPower::MyGsmPower(int pin)
-   : pinPower(pin)
+MyGsmPower::MyGsmPower(MyOptions &options, MyData &data, MyEnergy &energy, int pinPower, int pinDtr)
+   : myOptions(options)
+   , myData(data)
+   , myEnergy(energy)
+   , pinPower(pinPower)
+   , pinDtr(pinDtr)
+   , isSlowClock(false)
+   , lastActivityMs(0)
 {
 }
 
@@ -51,6 +83,7 @@ bool MyGsmPower::begin()
 {
    MyDbg("MyGsmPower::begin");
    pinMode(pinPower, INPUT);
+   pinMode(pinDtr,   INPUT);
    return true;
 }
 
@@ -58,8 +91,11 @@ bool MyGsmPower::begin()
 void MyGsmPower::on()
 {
    MyDbg("MyGsmPower::on");
+   pinMode(pinDtr, OUTPUT);
+   digitalWrite(pinDtr, LOW); 
    pinMode(pinPower, OUTPUT);
    digitalWrite(pinPower, LOW); 
+   setState(MODEM_IDLE);
    myDelay(1000);
 }
 
@@ -69,4 +105,94 @@ void MyGsmPower::off()
    MyDbg("MyGsmPower::off");
    pinMode(pinPower, INPUT);
    digitalWrite(pinPower, HIGH); 
+   pinMode(pinDtr, INPUT);
+   isSlowClock = false;
+   setState(MODEM_OFF);
+   myEnergy.set(ENERGY_GNSS, false);
+   myEnergy.set(ENERGY_GPRS, false);
+}
+
+/** Switch on or off the energy consumer of one modem state. */
+void MyGsmPower::setEnergy(MyModemState state, bool isActive)
+{
+   switch (state) {
+      case MODEM_SLEEP:  myEnergy.set(ENERGY_MODEM_SLEEP,  isActive); break;
+      case MODEM_IDLE:   myEnergy.set(ENERGY_MODEM_IDLE,   isActive); break;
+      case MODEM_ACTIVE: myEnergy.set(ENERGY_MODEM_ACTIVE, isActive); break;
+      default:           break;
+   }
+}
+
+/** Switch to a new state and move the energy accounting to it. */
+void MyGsmPower::setState(MyModemState state)
+{
+   setEnergy(myData.modemState, false);
+   myData.modemState = state;
+   setEnergy(myData.modemState, true);
+}
+
+/** The sim808 has (or has not) accepted the slow clock mode AT+CSCLK=1. */
+void MyGsmPower::setSlowClock(bool enable)
+{
+   isSlowClock = enable;
+}
+
+/** Is the slow clock mode enabled on the sim808? */
+bool MyGsmPower::hasSlowClock()
+{
+   return isSlowClock;
+}
+
+/** Release the DTR pin so that the sim808 can enter the slow clock mode. */
+bool MyGsmPower::sleep()
+{
+   if (!isSlowClock || myData.modemState == MODEM_OFF || myData.modemState == MODEM_SLEEP) {
+      return false;
+   }
+   MyDbg("MyGsmPower::sleep");
+   digitalWrite(pinDtr, HIGH); 
+   setState(MODEM_SLEEP);
+   return true;
+}
+
+/** Pull the DTR pin low to wakeup the sim808. Returns true if the modul was sleeping. */
+bool MyGsmPower::wake()
+{
+   if (myData.modemState != MODEM_SLEEP) {
+      return false;
+   }
+   MyDbg("MyGsmPower::wake");
+   digitalWrite(pinDtr, LOW); 
+   setState(MODEM_IDLE);
+   lastActivityMs = millis();
+   myDelay(MODEM_DTR_WAKEUP_MS);
+   return true;
+}
+
+/** Is the sim808 modul in slow clock mode? */
+bool MyGsmPower::isSleeping()
+{
+   return myData.modemState == MODEM_SLEEP;
+}
+
+/** Marks an AT communication with the sim808 modul. */
+void MyGsmPower::activity()
+{
+   lastActivityMs = millis();
+   if (myData.modemState == MODEM_IDLE) {
+      setState(MODEM_ACTIVE);
+   }
+}
+
+/** Switch from active to idle to sleep if there is no communication. */
+void MyGsmPower::handleClient()
+{
+   unsigned long inactiveMs = millis() - lastActivityMs;
+
+   if (myData.modemState == MODEM_ACTIVE && inactiveMs > MODEM_ACTIVE_TIMEOUT_MS) {
+      setState(MODEM_IDLE);
+   }
+   if (myData.modemState == MODEM_IDLE && inactiveMs > MODEM_SLEEP_TIMEOUT_MS && myOptions.isModemSleepEnabled) {
+      sleep();
+   }
 }
@@ -0,0 +1,446 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file History.h
+  *
+  * Time series history of the main values in ring files on the SPIFFS
+  * with raw values and 1 min, 15 min and 1 h aggregates (like a RRD).
+  */
+
+
+#include <ESP8266WebServer.h>
+
+#define HISTORY_FILE        "/history%d.bin" //!< SPIFFS ring file of one resolution.
+#define HISTORY_EMPTY       0xFFFFFFFF       //!< Timestamp of an unused record (erased file).
+#define HISTORY_CHUNK       1024             //!< Size of the streamed http chunks.
+#define RTC_HISTORY_OFFSET  (RTC_VOLTAGE_OFFSET + sizeof(MyVoltageRtc) / 4) //!< RTC memory block behind the voltage data.
+#define RTC_HISTORY_MAGIC   460818           //!< Fantasy value for checking if the history data is initialized.
+
+/**
+  * Values of the history.
+  */
+enum MyHistoryField
+{
+   HISTORY_VOLTAGE,     //!< Filtered supply voltage.
+   HISTORY_TEMPERATURE, //!< BME280 temperature.
+   HISTORY_HUMIDITY,    //!< BME280 humidity.
+   HISTORY_PRESSURE,    //!< BME280 pressure.
+   HISTORY_LATITUDE,    //!< Gps latitude.
+   HISTORY_LONGITUDE,   //!< Gps longitude.
+   HISTORY_FIELDS       //!< Number of fields.
+};
+
+/**
+  * Resolutions of the history.
+  */
+enum MyHistoryResolution
+{
+   HISTORY_RAW,         //!< Every historyRawSec.
+   HISTORY_1MIN,        //!< Mean of one minute.
+   HISTORY_15MIN,       //!< Mean of 15 minutes.
+   HISTORY_1H,          //!< Mean of one hour.
+   HISTORY_LEVELS       //!< Number of resolutions.
+};
+
+/**
+  * Fixed size record of the ring files.
+  */
+class MyHistoryRecord
+{
+public:
+   uint32_t sec;                    //!< Start of the interval in history seconds (HISTORY_EMPTY = unused).
+   float    values[HISTORY_FIELDS]; //!< Values or means of the interval (NAN = unknown).
+};
+
+/**
+  * Name, interval and ring size of one resolution.
+  */
+class MyHistoryLevel
+{
+public:
+   const char *name;    //!< Name in the http requests.
+   long        sec;     //!< Interval of one record (0 = historyRawSec).
+   int         records; //!< Number of records in the ring file.
+};
+
+/**
+  * Running aggregate of one resolution.
+  */
+class MyHistoryAccu
+{
+public:
+   uint32_t slot;                   //!< Interval number of the running aggregate.
+   float    sum  [HISTORY_FIELDS];  //!< Sum of the known values.
+   uint16_t count[HISTORY_FIELDS];  //!< Number of the known values.
+};
+
+/**
+  * History data which are stored in the RTC memory to survive the deep sleep.
+  */
+class MyHistoryRtc
+{
+public:
+   uint32_t      magic;                       //!< Is the RTC memory initialized?
+   uint32_t      offsetSec;                   //!< History seconds at uptime 0 (continues the files after a power loss).
+   uint32_t      rawSec;                      //!< History seconds of the last raw record.
+   uint16_t      next [HISTORY_LEVELS];       //!< Next record index of every ring file.
+   MyHistoryAccu accus[HISTORY_LEVELS - 1];   //!< Running aggregates of the 1 min, 15 min and 1 h resolution.
+};
+
+/**
+  * Stores the main values every historyRawSec and aggregates them into the coarser
+  * resolutions. Every resolution is one ring file with fixed size records, so a
+  * write is a single record at a known position and the files never grow.
+  */
+class MyHistory
+{
+public:
+   static const char          *fieldNames[HISTORY_FIELDS]; //!< Names of the fields in the http requests.
+   static const MyHistoryLevel levels[HISTORY_LEVELS];     //!< All the resolutions.
+
+protected:
+   MyOptions   &myOptions;  //!< Reference to the options.
+   MyData      &myData;     //!< Reference to the data.
+   MyEnergy    &myEnergy;   //!< Reference to the energy model (uptime over deep sleeps).
+   MyHistoryRtc rtc;        //!< Ring positions and aggregates (RTC memory image).
+
+protected:
+   String   getFileName(int level);
+   uint32_t getSec();
+   bool     createFile(int level);
+   uint32_t scanFile(int level);
+   void     getRecord(MyHistoryRecord &record);
+   void     write(int level, const MyHistoryRecord &record);
+   void     aggregate(int level, const MyHistoryRecord &record);
+   bool     readRecord(File &file, int level, int i, uint32_t sec, long fromSec, int field, MyHistoryRecord &record);
+
+public:
+   static int getField(const String &name);
+   static int getLevel(const String &name);
+
+public:
+   MyHistory(MyOptions &options, MyData &data, MyEnergy &energy);
+
+   bool begin();
+   void handleClient();
+
+   void stream(ESP8266WebServer &server, int field, int level, long fromSec, bool isBinary);
+};
+
+/* ******************************************** */
+
+const char *MyHistory::fieldNames[HISTORY_FIELDS] = {
+   "voltage", "temperature", "humidity", "pressure", "latitude", "longitude"
+};
+
+const MyHistoryLevel MyHistory::levels[HISTORY_LEVELS] = {
+   // name   sec   records
+   { "raw",  0,    360  },
+   { "1m",   60,   1440 },
+   { "15m",  900,  672  },
+   { "1h",   3600, 720  }
+};
+
+/** Constructor */
+MyHistory::MyHistory(MyOptions &options, MyData &data, MyEnergy &energy)
+   : myOptions(options)
+   , myData(data)
+   , myEnergy(energy)
+{
+   memset(&rtc, 0, sizeof(rtc));
+}
+
+/** Index of a field name or -1. */
+int MyHistory::getField(const String &name)
+{
+   for (int i = 0; i < HISTORY_FIELDS; i++) {
+      if (name == fieldNames[i]) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+/** Index of a resolution name or -1. */
+int MyHistory::getLevel(const String &name)
+{
+   for (int i = 0; i < HISTORY_LEVELS; i++) {
+      if (name == levels[i].name) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+/** SPIFFS file name of one resolution. */
+String MyHistory::getFileName(int level)
+{
+   char fileName[20];
+
+   snprintf(fileName, sizeof(fileName), HISTORY_FILE, level);
+   return fileName;
+}
+
+/** Monotonic history seconds (uptime over the deep sleeps continued after a power loss). */
+uint32_t MyHistory::getSec()
+{
+   return (uint32_t) myEnergy.getUptimeSec() + rtc.offsetSec;
+}
+
+/** Create an empty ring file with all the records unused. */
+bool MyHistory::createFile(int level)
+{
+   File file = SPIFFS.open(getFileName(level), "w");
+
+   if (!file) {
+      return false;
+   }
+
+   MyHistoryRecord empty;
+
+   memset(&empty, 0xFF, sizeof(empty));
+   for (int i = 0; i < levels[level].records; i++) {
+      file.write((const uint8_t *) &empty, sizeof(empty));
+   }
+   file.close();
+   return true;
+}
+
+/**
+  * Search the newest record of a ring file to continue behind it.
+  * The file is created if it is missing or has the wrong size.
+  * Returns the timestamp of the newest record (0 = empty).
+  */
+uint32_t MyHistory::scanFile(int level)
+{
+   uint32_t newestSec = 0;
+   File     file      = SPIFFS.open(getFileName(level), "r");
+
+   rtc.next[level] = 0;
+   if (!file || file.size() != levels[level].records * sizeof(MyHistoryRecord)) {
+      if (file) {
+         file.close();
+      }
+      createFile(level);
+      return 0;
+   }
+   for (int i = 0; i < levels[level].records; i++) {
+      MyHistoryRecord record;
+
+      if (file.read((uint8_t *) &record, sizeof(record)) != sizeof(record)) {
+         break;
+      }
+      if (record.sec != HISTORY_EMPTY && record.sec >= newestSec) {
+         newestSec       = record.sec;
+         rtc.next[level] = (i + 1) % levels[level].records;
+      }
+   }
+   file.close();
+   return newestSec;
+}
+
+/**
+  * Restore the ring positions and aggregates from the RTC memory.
+  * After a power loss the files are scanned and the history time continues behind the newest record.
+  */
+bool MyHistory::begin()
+{
+   MyHistoryRtc tmp;
+
+   ESP.rtcUserMemoryRead(RTC_HISTORY_OFFSET, (uint32_t *) &tmp, sizeof(tmp));
+   if (tmp.magic == RTC_HISTORY_MAGIC) {
+      rtc = tmp;
+   } else {
+      uint32_t newestSec = 0;
+
+      MyDbg("MyHistory::begin");
+      memset(&rtc, 0, sizeof(rtc));
+      rtc.magic = RTC_HISTORY_MAGIC;
+      for (int i = 0; i < HISTORY_LEVELS; i++) {
+         newestSec = max(newestSec, scanFile(i));
+      }
+      rtc.offsetSec = newestSec;
+      ESP.rtcUserMemoryWrite(RTC_HISTORY_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+   }
+   return true;
+}
+
+/** Current values of the main data (NAN if not known). */
+void MyHistory::getRecord(MyHistoryRecord &record)
+{
+   double value = 0.0;
+
+   for (int i = 0; i < HISTORY_FIELDS; i++) {
+      record.values[i] = NAN;
+   }
+   record.values[HISTORY_VOLTAGE] = myData.voltage;
+   if (myData.samples.getValue("BME280", SAMPLE_TEMPERATURE, value)) {
+      record.values[HISTORY_TEMPERATURE] = value;
+   }
+   if (myData.samples.getValue("BME280", SAMPLE_HUMIDITY, value)) {
+      record.values[HISTORY_HUMIDITY] = value;
+   }
+   if (myData.samples.getValue("BME280", SAMPLE_PRESSURE, value)) {
+      record.values[HISTORY_PRESSURE] = value;
+   }
+   if (myData.latitude != "" && myData.longitude != "") {
+      record.values[HISTORY_LATITUDE]  = atof(myData.latitude.c_str());
+      record.values[HISTORY_LONGITUDE] = atof(myData.longitude.c_str());
+   }
+}
+
+/** Write one record at the ring position of the resolution. */
+void MyHistory::write(int level, const MyHistoryRecord &record)
+{
+   File file = SPIFFS.open(getFileName(level), "r+");
+
+   if (!file) {
+      return;
+   }
+   file.seek(rtc.next[level] * sizeof(record), SeekSet);
+   file.write((const uint8_t *) &record, sizeof(record));
+   file.close();
+   rtc.next[level] = (rtc.next[level] + 1) % levels[level].records;
+}
+
+/**
+  * Add a record of the finer resolution to the running aggregate.
+  * When the interval is over the mean is written and passed to the next coarser resolution.
+  */
+void MyHistory::aggregate(int level, const MyHistoryRecord &record)
+{
+   MyHistoryAccu &accu = rtc.accus[level - 1];
+   uint32_t       slot = record.sec / levels[level].sec;
+   bool           any  = false;
+
+   for (int i = 0; i < HISTORY_FIELDS; i++) {
+      any = any || accu.count[i] > 0;
+   }
+   if (any && slot != accu.slot) {
+      MyHistoryRecord mean;
+
+      mean.sec = accu.slot * levels[level].sec;
+      for (int i = 0; i < HISTORY_FIELDS; i++) {
+         mean.values[i] = accu.count[i] ? accu.sum[i] / accu.count[i] : NAN;
+      }
+      write(level, mean);
+      if (level + 1 < HISTORY_LEVELS) {
+         aggregate(level + 1, mean);
+      }
+      memset(&accu, 0, sizeof(accu));
+   }
+   accu.slot = slot;
+   for (int i = 0; i < HISTORY_FIELDS; i++) {
+      if (!isnan(record.values[i])) {
+         accu.sum[i] += record.values[i];
+         accu.count[i]++;
+      }
+   }
+}
+
+/** Store a raw record every historyRawSec (0 = switched off). */
+void MyHistory::handleClient()
+{
+   uint32_t sec = getSec();
+
+   if (myOptions.historyRawSec <= 0 || sec - rtc.rawSec < (uint32_t) myOptions.historyRawSec) {
+      return;
+   }
+
+   MyHistoryRecord record;
+
+   record.sec = sec;
+   getRecord(record);
+   write(HISTORY_RAW, record);
+   aggregate(HISTORY_1MIN, record);
+   rtc.rawSec = sec;
+   ESP.rtcUserMemoryWrite(RTC_HISTORY_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+}
+
+/** Read the i-th oldest record of a ring file. Returns false if it is unused, too old or its field is unknown. */
+bool MyHistory::readRecord(File &file, int level, int i, uint32_t sec, long fromSec, int field, MyHistoryRecord &record)
+{
+   int records = levels[level].records;
+
+   // The oldest record is at the write position
+   file.seek(((rtc.next[level] + i) % records) * sizeof(record), SeekSet);
+   if (file.read((uint8_t *) &record, sizeof(record)) != sizeof(record)) {
+      return false;
+   }
+   return record.sec != HISTORY_EMPTY && record.sec <= sec && sec - record.sec <= (uint32_t) fromSec && !isnan(record.values[field]);
+}
+
+/**
+  * Send the known values of one field of the last fromSec seconds from the oldest to the newest.
+  * CSV lines are 'age in seconds,value'. The binary records are the int32 age and the float value 
+  * (8 bytes, little endian) and are counted first to send them with the content length.
+  */
+void MyHistory::stream(ESP8266WebServer &server, int field, int level, long fromSec, bool isBinary)
+{
+   MyHistoryRecord record;
+   uint32_t        sec  = getSec();
+   File            file = SPIFFS.open(getFileName(level), "r");
+
+   if (!file) {
+      server.send(404, "text/plain", "No history");
+      return;
+   }
+   if (isBinary) {
+      uint8_t buf[HISTORY_CHUNK];
+      size_t  len   = 0;
+      int     count = 0;
+
+      for (int i = 0; i < levels[level].records; i++) {
+         count += readRecord(file, level, i, sec, fromSec, field, record);
+      }
+      server.setContentLength(count * 8);
+      server.send(200, "application/octet-stream", "");
+      for (int i = 0; i < levels[level].records; i++) {
+         if (readRecord(file, level, i, sec, fromSec, field, record)) {
+            int32_t age = sec - record.sec;
+
+            memcpy(buf + len,     &age,                  4);
+            memcpy(buf + len + 4, &record.values[field], 4);
+            len += 8;
+            if (len + 8 > sizeof(buf)) {
+               server.client().write(buf, len);
+               len = 0;
+            }
+         }
+      }
+      if (len > 0) {
+         server.client().write(buf, len);
+      }
+   } else {
+      String chunk = String("age,") + fieldNames[field] + "\n";
+
+      server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+      server.send(200, "text/csv", "");
+      for (int i = 0; i < levels[level].records; i++) {
+         if (readRecord(file, level, i, sec, fromSec, field, record)) {
+            chunk += String(sec - record.sec) + "," + String(record.values[field], field >= HISTORY_LATITUDE ? 5 : 2) + "\n";
+            if (chunk.length() >= HISTORY_CHUNK) {
+               server.sendContent(chunk);
+               chunk = "";
+            }
+         }
+      }
+      server.sendContent(chunk);
+      server.sendContent("");
+   }
+   file.close();
+}
@@ -0,0 +1,377 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Motion.h
+  *
+  * Kalman filter of the gps positions and the parked/moving/stopping detection.
+  */
+
+
+#define KALMAN_ONE          65536L        //!< Fixed point 1.0 of the kalman gains.
+#define KALMAN_ACCEL_CM     100           //!< Standard deviation of the acceleration in cm/s^2 (process noise).
+#define GPS_UERE_M          5.0           //!< User equivalent range error in m (accuracy and measurement noise = hdop * UERE).
+#define KALMAN_INIT_VEL_VAR 1000000LL     //!< Variance of the unknown velocity after a reset in (cm/s)^2.
+#define KALMAN_MAX_VAR      1000000000000LL //!< Upper limit of the variances against overflows.
+#define KALMAN_RESET_MS     60000         //!< Minimum gap between two fixes which restarts the filter.
+#define KALMAN_RESET_FIXES  3             //!< Missing fixes of the gps interval which restart the filter.
+#define KALMAN_GATE         3             //!< Outlier gate in standard deviations of the innovation.
+#define KALMAN_MAX_PDOP     10.0          //!< Fixes with a larger pdop are rejected.
+#define KALMAN_MAX_REJECTS  5             //!< Rejected fixes in a row which restart the filter.
+#define METER_PER_DEGREE    111319.49     //!< Length of one degree latitude in m.
+
+/**
+  * States of the motion detection.
+  */
+enum MyMotionState
+{
+   MOTION_PARKED,   //!< Standing at the park position.
+   MOTION_MOVING,   //!< Driving.
+   MOTION_STOPPING, //!< Slow or standing, but not yet for 'motionStopSec'.
+   MOTION_STATES    //!< Number of motion states.
+};
+
+/**
+  * Constant velocity kalman filter of one axis in fixed point.
+  * Position in cm, velocity in cm/s and the covariances in the squares of it.
+  */
+class MyKalmanAxis
+{
+public:
+   int32_t x;   //!< Position in cm.
+   int32_t v;   //!< Velocity in cm/s.
+   int64_t p00; //!< Variance of the position.
+   int64_t p01; //!< Covariance of the position and the velocity.
+   int64_t p11; //!< Variance of the velocity.
+
+public:
+   void    reset(int32_t z, int64_t r);
+   void    predict(int32_t dtDs);
+   int64_t getInnovation(int32_t z, int64_t r, int64_t &s);
+   void    update(int32_t z, int64_t r);
+};
+
+/**
+  * Filters the gps fixes and detects the motion state.
+  * Outliers are rejected by the pdop and by the innovation of the filter.
+  * Parked means the filtered position stays within 'minMovingDistance' of the
+  * park position and the speed is below 'motionSpeedKmph'. A vehicle is parked
+  * again after it was slow for 'motionStopSec'.
+  */
+class MyMotionFilter
+{
+public:
+   static const char *names[MOTION_STATES]; //!< Names of the motion states.
+
+protected:
+   MyOptions     &myOptions;      //!< Reference to the options.
+   MyKalmanAxis   east;           //!< East axis relative to the reference.
+   MyKalmanAxis   north;          //!< North axis relative to the reference.
+   bool           isStarted;      //!< Has the filter a valid state?
+   double         refLatitude;    //!< Reference point of the local axes.
+   double         refLongitude;   //!< Reference point of the local axes.
+   double         cmPerDegreeLon; //!< Length of one degree longitude at the reference in cm.
+   unsigned long  lastMs;         //!< Time of the last accepted fix.
+   unsigned long  stopStartMs;    //!< Start of the stopping state.
+   int            rejects;        //!< Rejected fixes in a row.
+   MyMotionState  state;          //!< Current motion state.
+   double         parkLatitude;   //!< Park position.
+   double         parkLongitude;  //!< Park position.
+
+protected:
+   void    toLocal(double latitude, double longitude, int32_t &e, int32_t &n);
+   void    restart(double latitude, double longitude, int64_t r, unsigned long ms);
+   int64_t getSpeed2();
+   int64_t getParkDistance2();
+   void    updateState(unsigned long ms);
+
+public:
+   MyMotionFilter(MyOptions &options);
+
+   void   begin(MyMotionState state, double parkLatitude, double parkLongitude);
+   bool   update(double latitude, double longitude, double hdop, double pdop, unsigned long ms, long intervalSec);
+
+   double getLatitude();
+   double getLongitude();
+   double getParkLatitude();
+   double getParkLongitude();
+   double getParkDistance();
+
+   MyMotionState getState();
+   bool   isMoving();
+};
+
+/* ******************************************** */
+
+/** Start the filter at one measured position with its variance. */
+void MyKalmanAxis::reset(int32_t z, int64_t r)
+{
+   x   = z;
+   v   = 0;
+   p00 = r;
+   p01 = 0;
+   p11 = KALMAN_INIT_VEL_VAR;
+}
+
+/**
+  * Move the state by the velocity for dtDs (1/10 seconds) and add the
+  * process noise of a random acceleration (KALMAN_ACCEL_CM).
+  * dtDs is limited to KALMAN_RESET_MS, which keeps dt^4 and p11 * dt^2 in the int64 range.
+  */
+void MyKalmanAxis::predict(int32_t dtDs)
+{
+   int64_t dt = min(dtDs, (int32_t) (KALMAN_RESET_MS / 100));
+   int64_t qa = (int64_t) KALMAN_ACCEL_CM * KALMAN_ACCEL_CM;
+
+   x   += (int32_t) ((int64_t) v * dt / 10);
+   p00 += 2 * p01 * dt / 10 + p11 * dt * dt / 100 + qa * dt * dt * dt * dt / 40000;
+   p01 += p11 * dt / 10 + qa * dt * dt * dt / 2000;
+   p11 += qa * dt * dt / 100;
+
+   p00 = min(p00, (int64_t) KALMAN_MAX_VAR);
+   p11 = min(p11, (int64_t) KALMAN_MAX_VAR);
+   p01 = constrain(p01, (int64_t) -KALMAN_MAX_VAR, (int64_t) KALMAN_MAX_VAR);
+}
+
+/** Difference of the measurement to the predicted position and its variance s. */
+int64_t MyKalmanAxis::getInnovation(int32_t z, int64_t r, int64_t &s)
+{
+   s = p00 + r;
+   return (int64_t) z - x;
+}
+
+/** Correct the state by one measured position with the variance r. */
+void MyKalmanAxis::update(int32_t z, int64_t r)
+{
+   int64_t s;
+   int64_t y  = getInnovation(z, r, s);
+   int64_t k0 = p00 * KALMAN_ONE / s;
+   int64_t k1 = p01 * KALMAN_ONE / s;
+
+   x   += (int32_t) (k0 * y / KALMAN_ONE);
+   v   += (int32_t) (k1 * y / KALMAN_ONE);
+   p11 -= k1 * p01 / KALMAN_ONE;
+   p01 -= k0 * p01 / KALMAN_ONE;
+   p00 -= k0 * p00 / KALMAN_ONE;
+}
+
+/* ******************************************** */
+
+const char *MyMotionFilter::names[MOTION_STATES] = {
+   "Parked", "Moving", "Stopping"
+};
+
+/** Constructor */
+MyMotionFilter::MyMotionFilter(MyOptions &options)
+   : myOptions(options)
+   , isStarted(false)
+   , refLatitude(0.0)
+   , refLongitude(0.0)
+   , cmPerDegreeLon(0.0)
+   , lastMs(0)
+   , stopStartMs(0)
+   , rejects(0)
+   , state(MOTION_PARKED)
+   , parkLatitude(0.0)
+   , parkLongitude(0.0)
+{
+}
+
+/** Restore the motion state and the park position after a deep sleep. */
+void MyMotionFilter::begin(MyMotionState state, double parkLatitude, double parkLongitude)
+{
+   this->state         = state < MOTION_STATES ? state : MOTION_PARKED;
+   this->parkLatitude  = parkLatitude;
+   this->parkLongitude = parkLongitude;
+   stopStartMs         = millis();
+}
+
+/** Position in cm on the local axes around the reference point. */
+void MyMotionFilter::toLocal(double latitude, double longitude, int32_t &e, int32_t &n)
+{
+   e = (int32_t) ((longitude - refLongitude) * cmPerDegreeLon);
+   n = (int32_t) ((latitude  - refLatitude)  * METER_PER_DEGREE * 100.0);
+}
+
+/** Start the filter at a new reference point. */
+void MyMotionFilter::restart(double latitude, double longitude, int64_t r, unsigned long ms)
+{
+   refLatitude    = latitude;
+   refLongitude   = longitude;
+   cmPerDegreeLon = cos(radians(latitude)) * METER_PER_DEGREE * 100.0;
+   east.reset(0, r);
+   north.reset(0, r);
+   isStarted = true;
+   rejects   = 0;
+   lastMs    = ms;
+   if (parkLatitude == 0.0 && parkLongitude == 0.0) {
+      parkLatitude  = latitude;
+      parkLongitude = longitude;
+   }
+}
+
+/**
+  * Filter one gps fix, which is expected every intervalSec. Returns false if the fix was rejected as outlier.
+  * After a gap of KALMAN_RESET_FIXES intervals (at least KALMAN_RESET_MS) or too many rejects 
+  * the filter starts again at the fix. A rejected fix leaves the filter state unchanged.
+  */
+bool MyMotionFilter::update(double latitude, double longitude, double hdop, double pdop, unsigned long ms, long intervalSec)
+{
+   int64_t       sigma   = (int64_t) (max(hdop, 0.5) * GPS_UERE_M * 100.0);
+   int64_t       r       = sigma * sigma;
+   long          resetMs = max(intervalSec * KALMAN_RESET_FIXES * 1000L, (long) KALMAN_RESET_MS);
+   int32_t       e, n;
+
+   if (pdop > KALMAN_MAX_PDOP) {
+      return false;
+   }
+   if (!isStarted || ms - lastMs > (unsigned long) resetMs || rejects >= KALMAN_MAX_REJECTS) {
+      restart(latitude, longitude, r, ms);
+      updateState(ms);
+      return true;
+   }
+
+   int32_t      dtDs      = (ms - lastMs + 50) / 100;
+   MyKalmanAxis nextEast  = east;
+   MyKalmanAxis nextNorth = north;
+
+   nextEast.predict(dtDs);
+   nextNorth.predict(dtDs);
+   toLocal(latitude, longitude, e, n);
+
+   int64_t sEast, sNorth;
+   int64_t yEast  = nextEast.getInnovation(e, r, sEast);
+   int64_t yNorth = nextNorth.getInnovation(n, r, sNorth);
+
+   // Outlier: the innovation is outside of the gate (compared in squares, scaled against overflows)
+   if ((yEast  / 16) * (yEast  / 16) > KALMAN_GATE * KALMAN_GATE * (sEast  / 256) ||
+       (yNorth / 16) * (yNorth / 16) > KALMAN_GATE * KALMAN_GATE * (sNorth / 256)) {
+      rejects++;
+      return false;
+   }
+   nextEast.update(e, r);
+   nextNorth.update(n, r);
+   east    = nextEast;
+   north   = nextNorth;
+   rejects = 0;
+   lastMs  = ms;
+   updateState(ms);
+   return true;
+}
+
+/**
+  * Square of the filtered speed in (cm/s)^2 reduced by its uncertainty (KALMAN_GATE sigma).
+  * So the noise of a standing receiver is not taken as speed.
+  */
+int64_t MyMotionFilter::getSpeed2()
+{
+   return (int64_t) east.v * east.v + (int64_t) north.v * north.v -
+          KALMAN_GATE * KALMAN_GATE * (east.p11 + north.p11);
+}
+
+/** Square of the distance between the filtered position and the park position in cm^2. */
+int64_t MyMotionFilter::getParkDistance2()
+{
+   int32_t e, n;
+
+   toLocal(parkLatitude, parkLongitude, e, n);
+   e -= east.x;
+   n -= north.x;
+   return (int64_t) e * e + (int64_t) n * n;
+}
+
+/** Parked -> moving -> stopping -> parked with the speed and the distance to the park position. */
+void MyMotionFilter::updateState(unsigned long ms)
+{
+   int64_t moveSpeed = (int64_t) (myOptions.motionSpeedKmph * 100.0 / 3.6);
+   int64_t moveDist  = (int64_t) myOptions.minMovingDistance * 100 +
+                       (int64_t) (KALMAN_GATE * sqrt((double) max(east.p00, north.p00)));
+   int64_t speed2    = getSpeed2();
+
+   switch (state) {
+      case MOTION_PARKED:
+         if (speed2 > moveSpeed * moveSpeed || getParkDistance2() > moveDist * moveDist) {
+            state = MOTION_MOVING;
+         }
+         break;
+      case MOTION_MOVING:
+         if (speed2 <= moveSpeed * moveSpeed) {
+            state       = MOTION_STOPPING;
+            stopStartMs = ms;
+         }
+         break;
+      case MOTION_STOPPING:
+         if (speed2 > moveSpeed * moveSpeed) {
+            state = MOTION_MOVING;
+         } else if (ms - stopStartMs >= (unsigned long) myOptions.motionStopSec * 1000) {
+            parkLatitude  = getLatitude();
+            parkLongitude = getLongitude();
+            state         = MOTION_PARKED;
+         }
+         break;
+      default:
+         state = MOTION_PARKED;
+         break;
+   }
+}
+
+/** Filtered latitude (the park position while parked). */
+double MyMotionFilter::getLatitude()
+{
+   if (state == MOTION_PARKED) {
+      return parkLatitude;
+   }
+   return refLatitude + north.x / (METER_PER_DEGREE * 100.0);
+}
+
+/** Filtered longitude (the park position while parked). */
+double MyMotionFilter::getLongitude()
+{
+   if (state == MOTION_PARKED) {
+      return parkLongitude;
+   }
+   return refLongitude + (cmPerDegreeLon != 0.0 ? east.x / cmPerDegreeLon : 0.0);
+}
+
+/** Latitude of the park position. */
+double MyMotionFilter::getParkLatitude()
+{
+   return parkLatitude;
+}
+
+/** Longitude of the park position. */
+double MyMotionFilter::getParkLongitude()
+{
+   return parkLongitude;
+}
+
+/** Distance between the filtered position and the park position in m. */
+double MyMotionFilter::getParkDistance()
+{
+   return isStarted ? sqrt((double) getParkDistance2()) / 100.0 : 0.0;
+}
+
+/** Current motion state. */
+MyMotionState MyMotionFilter::getState()
+{
+   return state;
+}
+
+/** Is the vehicle moving or stopping (not parked)? */
+bool MyMotionFilter::isMoving()
+{
+   return state != MOTION_PARKED;
+}
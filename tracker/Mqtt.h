@@ -32,10 +32,11 @@
 #define topic_cmd                    "SIM808/" MQTT_ID "/Cmd"                    //!< mqtt command for modul.
 
 #define topic_voltage                "SIM808/" MQTT_ID "/Voltage"                //!< Power supply voltage
+#define topic_voltage_mean           "SIM808/" MQTT_ID "/Voltage/Mean"           //!< Mean voltage of the last statistics window
+#define topic_voltage_min            "SIM808/" MQTT_ID "/Voltage/Min"            //!< Minimum voltage of the last statistics window
+#define topic_voltage_max            "SIM808/" MQTT_ID "/Voltage/Max"            //!< Maximum voltage of the last statistics window
 
-#define topic_temperature            "SIM808/" MQTT_ID "/BME280/temperature"     //!< Temperature
-#define topic_humidity               "SIM808/" MQTT_ID "/BME280/humidity"        //!< Humidity
-#define topic_pressure               "SIM808/" MQTT_ID "/BME280/pressure"        //!< Pressure
+#define topic_sensor                 "SIM808/" MQTT_ID "/"                       //!< Sensor samples (+ sensor/type, i.e. BME280/temperature)
 
 #define topic_imei                   "SIM808/" MQTT_ID "/Imei"                   //!< IMEI of the sim card
 #define topic_cop                    "SIM808/" MQTT_ID "/Cop"                    //!< Operator selection
@@ -48,6 +49,94 @@
 #define topic_lat                    "SIM808/" MQTT_ID "/Gps/Latitude"           //!< Gps latitude
 #define topic_alt                    "SIM808/" MQTT_ID "/Gps/Altitude"           //!< Gps altitude
 #define topic_kmph                   "SIM808/" MQTT_ID "/Gps/Kmh"                //!< Gps moving speed
+#define topic_ttff                   "SIM808/" MQTT_ID "/Gps/Ttff"               //!< Time to first fix of the last gps start
+#define topic_source                 "SIM808/" MQTT_ID "/Gps/Source"             //!< Source of the position (GNSS, Cell, Cell cache)
+#define topic_accuracy               "SIM808/" MQTT_ID "/Gps/Accuracy"           //!< Estimated accuracy of the position in m
+
+#define topic_energy_total           "SIM808/" MQTT_ID "/Energy/TotalMAh"        //!< Used charge since power on
+#define topic_energy_avg             "SIM808/" MQTT_ID "/Energy/AverageMA"       //!< Average current since power on
+#define topic_energy_profile         "SIM808/" MQTT_ID "/Energy/Profile"         //!< Used charge of every consumer
+
+#define topic_telemetry              "SIM808/" MQTT_ID "/Telemetry"              //!< Binary delta coded report (see Telemetry.h)
+
+#define MQTT_STORE_FILE       "/mqtt%d.bin" //!< SPIFFS file of one unacknowledged QoS 1 publish.
+#define RTC_MQTT_OFFSET       (RTC_CELL_OFFSET + sizeof(MyCellRtc) / 4) //!< RTC memory block behind the cell locator data.
+#define RTC_MQTT_MAGIC        190867 //!< Fantasy value for checking if the mqtt data is initialized.
+#define MQTT_KEEPALIVE_MIN    30     //!< Lower limit of the keepalive in seconds.
+#define MQTT_BACKOFF_MAX      600    //!< Upper limit of the reconnect backoff in seconds.
+#define MQTT_ACK_POLL_SEC     10     //!< Poll interval for outstanding QoS 1 acknowledgements.
+
+/**
+  * Report values which are only published on change.
+  */
+enum MyMqttBandField
+{
+   BAND_LATITUDE,    //!< Gps latitude (deadband of the position in m).
+   BAND_LONGITUDE,   //!< Gps longitude (published together with the latitude).
+   BAND_ALTITUDE,    //!< Gps altitude.
+   BAND_KMPH,        //!< Gps moving speed.
+   BAND_VOLTAGE,     //!< Power supply voltage.
+   BAND_CSQ,         //!< Signal quality.
+   BAND_BATT_LEVEL,  //!< Battery level of the sim808.
+   BAND_BATT_VOLT,   //!< Battery voltage of the sim808.
+   BAND_FIELDS       //!< Number of fields.
+};
+
+/**
+  * Last published value of one field for the deadband check.
+  */
+class MyMqttBand
+{
+public:
+   double value;   //!< Last published value.
+   long   sec;     //!< Timestamp of the last publish.
+   bool   isValid; //!< Was the value published at all?
+
+public:
+   MyMqttBand();
+
+   void set(double newValue, long currentSec);
+};
+
+/**
+  * Sensor sample which is part of the binary telemetry frame.
+  */
+class MyMqttTelemetrySample
+{
+public:
+   MyTelemetryField field;  //!< Field in the frame.
+   const char      *sensor; //!< Name of the sensor.
+   MySampleType     type;   //!< Type of the sample.
+   double           scale;  //!< Factor to the fixed point value.
+};
+
+#define MQTT_TELEMETRY_SAMPLES 3 //!< Number of sensor samples in the telemetry frame.
+
+/**
+  * Mqtt session data which are stored in the RTC memory to survive the deep sleep.
+  */
+class MyMqttRtc
+{
+public:
+   uint32_t magic;         //!< Is the RTC memory initialized?
+   int32_t  natTimeoutSec; //!< Shortest idle time which lost the connection (0 = unknown).
+};
+
+/**
+  * Keeps the unacknowledged QoS 1 publishes in the SPIFFS
+  * so they are sent again after a deep sleep or a modem power off.
+  * The window is only written by MyMqtt::save(), not on every publish.
+  */
+class MyMqttStore : public PubSubStore
+{
+protected:
+   String getFileName(uint8_t slot);
+
+public:
+   virtual void     save(uint8_t slot, const uint8_t *packet, uint16_t length);
+   virtual void     remove(uint8_t slot);
+   virtual uint16_t load(uint8_t slot, uint8_t *packet, uint16_t size);
+};
 
 /**
   * MQTT client for sending the collected data to a MQTT server
@@ -56,147 +145,661 @@ class MyMqtt : protected PubSubClient
 {
 protected:
    static MyOptions *g_myOptions;   //!< Static option pointer for the callback function.
+   static const char *bandTopics[BAND_FIELDS]; //!< Topics of the report values.
+   static const MyMqttTelemetrySample telemetrySamples[MQTT_TELEMETRY_SAMPLES]; //!< Sensor samples in the telemetry frame.
 
 public:
    static void mqttCallback(char* topic, byte* payload, unsigned int len);
    
 protected:
    MyGsmGps  &myGsmGps;             //!< Reference to the Gsmgps instnces.
+   MyEnergy  &myEnergy;             //!< Reference to the energy model.
    MyOptions &myOptions;            //!< Reference to the options. 
    MyData    &myData;               //!< Reference to the data.
+   MyMqttStore myStore;             //!< Persistent QoS 1 window.
+   MyMqttRtc  rtc;                  //!< Measured NAT timeout (RTC memory image).
+   MyTelemetryEncoder telemetry;    //!< Delta encoder of the binary reports.
+   MyMqttBand bands[BAND_FIELDS];   //!< Last published values of the report.
+   MyMqttBand sampleBands[MAX_SAMPLES]; //!< Last published values of the sensor samples.
 
    long       mqttLastSendSec;      //!< Timestamp from the last send.
-   long       mqttLastReconnectSec; //!< Timestamp from the last server connection. 
+   long       mqttNextReconnectSec; //!< Earliest time of the next connection attempt.
+   int        mqttReconnectFailures; //!< Failed connection attempts in a row.
+   long       mqttLastPollSec;      //!< Timestamp of the last poll or send.
    long       lastGpsPublishedSec;  //!< The last timestamp of the sended gps data.
+   long       energyPublishedSec;   //!< Timestamp of the last energy publish.
+   long       voltageWindowPublished; //!< Number of the last published voltage statistics window.
+   long       ttffPublished;        //!< Number of the last published time to first fix.
+   String     sourcePublished;      //!< Last published position source and accuracy.
+   bool       isSessionUp;          //!< Was the server connected at the last check?
 
 protected:
-   void reconnect();
+   long getKeepAliveSec();
+   void connectionLost(long currentSec);
+   void reconnect(long currentSec);
    bool sendData(); 
+   void resetPublished();
+   void getReport(double *values, String *texts);
+   double getBand(int field);
+   double getSampleBand(MySampleType type);
+   bool isDue(int field, const double *values, long currentSec);
+   bool isOutOfBand(const MyMqttBand &band, double value, double absBand, long currentSec);
+   bool isInTelemetry(const MySample &sample);
+   bool isSampleDue(int index, long currentSec);
+   bool isHeartbeatDue(long lastSec, long currentSec);
+   bool canPublishGps(const bool *due);
+   bool publishGps(const char *topic, const String &value);
+   bool publishTelemetry();
 
    using PubSubClient::connected;
    using PubSubClient::publish;
+   using PubSubClient::inflightCount;
+   using PubSubClient::lastActivity;
 
 public:
-   MyMqtt(MyGsmGps &gsmGps, MyOptions &options, MyData &data);
+   MyMqtt(MyGsmGps &gsmGps, MyEnergy &energy, MyOptions &options, MyData &data);
    ~MyMqtt();
    
    bool begin();
    void handleClient();
+   void save();
 };
 
 /* ******************************************** */
 
+/** SPIFFS file name of one window slot. */
+String MyMqttStore::getFileName(uint8_t slot)
+{
+   char fileName[16];
+
+   snprintf(fileName, sizeof(fileName), MQTT_STORE_FILE, slot);
+   return fileName;
+}
+
+/** Write the packet of one slot into its file. */
+void MyMqttStore::save(uint8_t slot, const uint8_t *packet, uint16_t length)
+{
+   File file = SPIFFS.open(getFileName(slot), "w");
+
+   if (file) {
+      file.write(packet, length);
+      file.close();
+   }
+}
+
+/** Remove the file of an acknowledged publish. */
+void MyMqttStore::remove(uint8_t slot)
+{
+   String fileName = getFileName(slot);
+
+   if (SPIFFS.exists(fileName)) {
+      SPIFFS.remove(fileName);
+   }
+}
+
+/** Read the packet of one slot. Returns 0 if the slot is empty. */
+uint16_t MyMqttStore::load(uint8_t slot, uint8_t *packet, uint16_t size)
+{
+   uint16_t length = 0;
+   File     file   = SPIFFS.open(getFileName(slot), "r");
+
+   if (file) {
+      if (file.size() <= size) {
+         length = file.read(packet, file.size());
+      }
+      file.close();
+   }
+   return length;
+}
+
+/* ******************************************** */
+
+/** Constructor */
+MyMqttBand::MyMqttBand()
+   : value(0.0)
+   , sec(0)
+   , isValid(false)
+{
+}
+
+/** Remember the published value. */
+void MyMqttBand::set(double newValue, long currentSec)
+{
+   value   = newValue;
+   sec     = currentSec;
+   isValid = true;
+}
+
+/* ******************************************** */
+
 /** Constructor/Destructor */
-MyMqtt::MyMqtt(MyGsmGps &gsmGps, MyOptions &options, MyData &data)
+MyMqtt::MyMqtt(MyGsmGps &gsmGps, MyEnergy &energy, MyOptions &options, MyData &data)
    : myGsmGps(gsmGps)
+   , myEnergy(energy)
    , PubSubClient(gsmGps.gsmClient)
    , myOptions(options)
    , myData(data)
    , mqttLastSendSec(0)
-   , mqttLastReconnectSec(0)
+   , mqttNextReconnectSec(0)
+   , mqttReconnectFailures(0)
+   , mqttLastPollSec(0)
    , lastGpsPublishedSec(0)
+   , energyPublishedSec(0)
+   , voltageWindowPublished(0)
+   , ttffPublished(0)
+   , isSessionUp(false)
 {
    g_myOptions = &options;
+   memset(&rtc, 0, sizeof(rtc));
 }
 MyMqtt::~MyMqtt()
 {
    g_myOptions = NULL;
 }
 
-/** Connects or reconnect to the MQTT server and subscribes the topics. */
-void MyMqtt::reconnect()
+/** 
+  * Keepalive below the measured NAT timeout of the mobile network, 
+  * so the modem only wakes up as often as needed to keep the socket open.
+  */
+long MyMqtt::getKeepAliveSec()
 {
+   long sec = myOptions.mqttKeepAliveSec;
+
+   if (rtc.natTimeoutSec > 0) {
+      sec = min(sec, (long) rtc.natTimeoutSec * 3 / 4);
+   }
+   return max(sec, (long) MQTT_KEEPALIVE_MIN);
+}
+
+/** 
+  * The connection dropped after an idle time. Take it as the upper bound of the NAT timeout.
+  * The idle time starts with the last packet really sent or received, not with the last poll.
+  * A timeout of the own ping is no measurement: sending the ping already reset the idle time.
+  */
+void MyMqtt::connectionLost(long currentSec)
+{
+   long idleSec   = (long) (millis() - lastActivity()) / 1000;
+   bool isPingOut = state() == MQTT_CONNECTION_TIMEOUT;
+
+   isSessionUp = false;
+   MyDbg("MQTT connection lost after " + String(idleSec) + "s idle" + (isPingOut ? " (ping timeout)" : ""));
+   if (!isPingOut && idleSec >= MQTT_KEEPALIVE_MIN && (rtc.natTimeoutSec == 0 || idleSec < rtc.natTimeoutSec)) {
+      rtc.natTimeoutSec = idleSec;
+      ESP.rtcUserMemoryWrite(RTC_MQTT_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+      myData.mqttNatTimeoutSec = rtc.natTimeoutSec;
+   }
+}
+
+/** 
+  * One connection attempt to the MQTT server. 
+  * Failures are retried with an exponential backoff and jitter instead of waiting here.
+  * The topics are only subscribed if the server has not kept the session.
+  */
+void MyMqtt::reconnect(long currentSec)
+{
+   if (currentSec < mqttNextReconnectSec) {
+      return;
+   }
    MyDbg("Attempting MQTT connection...");
-   // Try 5 times to reconnected
-   for (int i = 0; !PubSubClient::connected() && i < 5; i++) {
-      // Attempt to connect
-      if (PubSubClient::connect(MQTT_NAME, MQTT_USER, MQTT_PASSWORD)) {
+   myData.mqttKeepAliveSec = getKeepAliveSec();
+   setKeepAlive(myData.mqttKeepAliveSec);
+   if (PubSubClient::connect(MQTT_NAME, MQTT_USER, MQTT_PASSWORD)) {
+      if (!sessionPresent()) {
          subscribe(topic_cmd);
          subscribe(topic_gsm_power);
          subscribe(topic_gsm_enabled);
          subscribe(topic_gps_enabled);
          subscribe(topic_send_on_move_every);
          subscribe(topic_send_on_non_move_every);
-         MyDbg(" connected");
-      } else {
-         MyDbg(" Failed (" + String(i+1) + ") rc =" + String(state()));
-         MyDbg(" Try again in 5 seconds");
-         // Wait 5 seconds before retrying
-         myDelay(5000);
-         MyDbg(".", false, false);
       }
+      telemetry.reset();
+      mqttReconnectFailures = 0;
+      mqttLastPollSec       = currentSec;
+      isSessionUp           = true;
+      MyDbg(sessionPresent() ? " connected (session resumed)" : " connected");
+   } else {
+      long backoffSec = myOptions.mqttReconnectIntervalSec << min(mqttReconnectFailures, 6);
+
+      backoffSec = min(backoffSec, (long) MQTT_BACKOFF_MAX);
+      backoffSec = backoffSec / 2 + random(backoffSec / 2 + 1);
+      mqttReconnectFailures++;
+      mqttNextReconnectSec = currentSec + backoffSec;
+      MyDbg(" Failed (" + String(mqttReconnectFailures) + ") rc =" + String(state()));
+      MyDbg(" Try again in " + String(backoffSec) + " seconds");
    }
 }
 
-/** Send the mqtt data if the gps values are new. */
+/** 
+  * Send the mqtt data if the gps values are new. 
+  * The gps values are published all or none. If they could not be sent 
+  * (i.e. the QoS 1 window is full) the fix is published again with the next sending.
+  */
 bool MyMqtt::sendData() 
 {
    if (myData.lastGpsUpdateSec != lastGpsPublishedSec) {
       MyDbg("Attempting MQTT publishing");
       if (PubSubClient::connected()) {
-         publish(topic_voltage, String(myData.voltage).c_str(), true); 
+         uint32_t sendCount  = myGsmGps.gsmClient.getSendCount();
+         long     currentSec = millis() / 1000;
+         int      published  = 0;
+         int      first      = 0;
+         bool     isGpsSent  = true;
+         double   values[BAND_FIELDS];
+         String   texts[BAND_FIELDS];
+         bool     due[BAND_FIELDS];
 
-         publish(topic_temperature, String(myData.temperature).c_str(), true); 
-         publish(topic_humidity,    String(myData.humidity).c_str(),    true); 
-         publish(topic_pressure,    String(myData.pressure).c_str(),    true); 
-         
-         publish(topic_csq,        myData.signalQuality.c_str(), true); 
-         publish(topic_batt_level, myData.batteryLevel.c_str(),  true); 
-         publish(topic_batt_volt,  myData.batteryVolt.c_str(),   true); 
-         
-         publish(topic_lon,  myData.longitude.c_str(), true); 
-         publish(topic_lat,  myData.latitude.c_str(),  true); 
-         publish(topic_alt,  myData.altitude.c_str(),  true); 
-         publish(topic_kmph, myData.kmph.c_str(),      true); 
+         bool     isFrame    = myOptions.mqttKeyframeEvery > 0;
+
+         getReport(values, texts);
+         for (int i = 0; i < BAND_FIELDS; i++) {
+            due[i] = isDue(i, values, currentSec);
+         }
+         if (isFrame) {
+            // The binary frame contains all the values up to the signal quality and the BME280 samples
+            bool frameDue = false;
+
+            for (int i = 0; i <= BAND_CSQ; i++) {
+               frameDue = frameDue || due[i];
+            }
+            for (int i = 0; i < myData.samples.getCount(); i++) {
+               frameDue = frameDue || (isInTelemetry(myData.samples.get(i)) && isSampleDue(i, currentSec));
+            }
+            if (frameDue && !publishTelemetry()) {
+               isGpsSent = false;
+            } else if (frameDue) {
+               for (int i = 0; i <= BAND_CSQ; i++) {
+                  bands[i].set(values[i], currentSec);
+               }
+               for (int i = 0; i < myData.samples.getCount(); i++) {
+                  if (isInTelemetry(myData.samples.get(i))) {
+                     sampleBands[i].set(myData.samples.get(i).value, currentSec);
+                  }
+               }
+               published++;
+            }
+            first = BAND_CSQ + 1;
+         }
+         if (first <= BAND_KMPH && !canPublishGps(due)) {
+            // Not enough room in the QoS 1 window for the whole position
+            isGpsSent = false;
+         }
+         for (int i = first; i < BAND_FIELDS; i++) {
+            if (due[i]) {
+               bool sent = false;
+
+               if (i > BAND_KMPH) {
+                  sent = publish(bandTopics[i], texts[i].c_str(), true);
+               } else if (isGpsSent) {
+                  sent      = publishGps(bandTopics[i], texts[i]);
+                  isGpsSent = sent;
+               }
+               if (sent) {
+                  bands[i].set(values[i], currentSec);
+                  published++;
+               }
+            }
+         }
+         for (int i = 0; i < myData.samples.getCount(); i++) {
+            const MySample &sample = myData.samples.get(i);
+
+            if ((isFrame && isInTelemetry(sample)) || !isSampleDue(i, currentSec)) {
+               continue;
+            }
+
+            String topic = String(topic_sensor) + sample.sensor + "/" + sample.getName();
+
+            if (publish(topic.c_str(), String(sample.value).c_str(), true)) {
+               sampleBands[i].set(sample.value, currentSec);
+               published++;
+            }
+         }
+
+         if (isHeartbeatDue(energyPublishedSec, currentSec)) {
+            myEnergy.update();
+            publish(topic_energy_total,   String(myEnergy.getTotalMAh(), 1).c_str(),  true); 
+            publish(topic_energy_avg,     String(myEnergy.getAverageMA(), 2).c_str(), true); 
+            publish(topic_energy_profile, myEnergy.getProfile().c_str(),              true); 
+            energyPublishedSec = currentSec;
+         }
+         if (myData.voltageWindows != voltageWindowPublished) {
+            publish(topic_voltage_mean, String(myData.voltageMean, 2).c_str(), true);
+            publish(topic_voltage_min,  String(myData.voltageMin,  2).c_str(), true);
+            publish(topic_voltage_max,  String(myData.voltageMax,  2).c_str(), true);
+            voltageWindowPublished = myData.voltageWindows;
+         }
+         if (myData.lastGpsUpdateSec != lastGpsPublishedSec) {
+            String source = myData.positionSource + String((long) myData.positionAccuracyM);
+
+            if (source != sourcePublished) {
+               publish(topic_source,   myData.positionSource.c_str(),               true);
+               publish(topic_accuracy, String(myData.positionAccuracyM, 0).c_str(), true);
+               sourcePublished = source;
+            }
+         }
+         if (myData.gpsTtffCount != ttffPublished) {
+            publish(topic_ttff, String(myData.gpsTtffSec, 1).c_str(), true);
+            ttffPublished = myData.gpsTtffCount;
+         }
          
-         lastGpsPublishedSec = myData.lastGpsUpdateSec;
-         MyDbg("mqtt published");
+         myGsmGps.gsmClient.flush();
+         if (!myGsmGps.gsmClient.connected()) {
+            // The buffered publishes were not sent, everything is published again after the reconnect
+            MyDbg("mqtt send failed");
+            resetPublished();
+            return false;
+         }
+         if (isGpsSent) {
+            lastGpsPublishedSec = myData.lastGpsUpdateSec;
+         } else {
+            MyDbg("mqtt gps values not sent, retry with the next sending");
+         }
+         MyDbg("mqtt published " + String(published) + " changed values (" + 
+               String(myGsmGps.gsmClient.getSendCount() - sendCount) + " modem sends)");
          return true;
       }
    }
    return false;
 }
 
-/** Sets the MQTT server settings */
+/** Forget all the published values, so they are published again with the next sending. */
+void MyMqtt::resetPublished()
+{
+   for (int i = 0; i < BAND_FIELDS; i++) {
+      bands[i].isValid = false;
+   }
+   for (int i = 0; i < MAX_SAMPLES; i++) {
+      sampleBands[i].isValid = false;
+   }
+   energyPublishedSec     = 0;
+   voltageWindowPublished = 0;
+   ttffPublished          = 0;
+   sourcePublished        = "";
+}
+
+/** Current values of the report as numbers for the deadbands and as text for the topics. */
+void MyMqtt::getReport(double *values, String *texts)
+{
+   texts[BAND_LATITUDE]    = myData.latitude;
+   texts[BAND_LONGITUDE]   = myData.longitude;
+   texts[BAND_ALTITUDE]    = myData.altitude;
+   texts[BAND_KMPH]        = myData.kmph;
+   texts[BAND_VOLTAGE]     = String(myData.voltage);
+   texts[BAND_CSQ]         = myData.signalQuality;
+   texts[BAND_BATT_LEVEL]  = myData.batteryLevel;
+   texts[BAND_BATT_VOLT]   = myData.batteryVolt;
+   for (int i = 0; i < BAND_FIELDS; i++) {
+      values[i] = atof(texts[i].c_str());
+   }
+   values[BAND_VOLTAGE]     = myData.voltage;
+}
+
+/** Configured absolute deadband of one field. */
+double MyMqtt::getBand(int field)
+{
+   switch (field) {
+      case BAND_LATITUDE:
+      case BAND_LONGITUDE:    return myOptions.mqttBandPositionM;
+      case BAND_ALTITUDE:     return myOptions.mqttBandAltitudeM;
+      case BAND_KMPH:         return myOptions.mqttBandKmph;
+      case BAND_VOLTAGE:
+      case BAND_BATT_VOLT:    return myOptions.mqttBandVoltage;
+      case BAND_CSQ:          return myOptions.mqttBandCsq;
+      default:                return 0.0;
+   }
+}
+
+/** Configured absolute deadband of one sample type. */
+double MyMqtt::getSampleBand(MySampleType type)
+{
+   switch (type) {
+      case SAMPLE_TEMPERATURE: return myOptions.mqttBandTemperature;
+      case SAMPLE_HUMIDITY:    return myOptions.mqttBandHumidity;
+      case SAMPLE_PRESSURE:    return myOptions.mqttBandPressure;
+      case SAMPLE_VOLTAGE:     return myOptions.mqttBandVoltage;
+      default:                 return 0.0;
+   }
+}
+
+/** Is the heartbeat interval over since the last publish? A heartbeat of 0 publishes every time. */
+bool MyMqtt::isHeartbeatDue(long lastSec, long currentSec)
+{
+   return myOptions.mqttHeartbeatSec <= 0 || lastSec == 0 || currentSec - lastSec >= myOptions.mqttHeartbeatSec;
+}
+
+/** 
+  * Has the value left its deadband around the last published value or is the heartbeat due?
+  * The band is the larger one of the absolute and the relative band. 
+  * Latitude and longitude are checked together by the distance in m.
+  */
+bool MyMqtt::isDue(int field, const double *values, long currentSec)
+{
+   MyMqttBand &band = bands[field];
+
+   if (field == BAND_LATITUDE || field == BAND_LONGITUDE) {
+      if (!band.isValid || isHeartbeatDue(band.sec, currentSec)) {
+         return true;
+      }
+      return MyLocation::distanceBetween(values[BAND_LATITUDE], values[BAND_LONGITUDE], 
+                                         bands[BAND_LATITUDE].value, bands[BAND_LONGITUDE].value) > getBand(field);
+   }
+   return isOutOfBand(band, values[field], getBand(field), currentSec);
+}
+
+/** Has the value left the larger one of the absolute and the relative band or is the heartbeat due? */
+bool MyMqtt::isOutOfBand(const MyMqttBand &band, double value, double absBand, long currentSec)
+{
+   if (!band.isValid || isHeartbeatDue(band.sec, currentSec)) {
+      return true;
+   }
+
+   double deadband = max(absBand, fabs(band.value) * myOptions.mqttBandRelativePct / 100.0);
+
+   return fabs(value - band.value) > deadband;
+}
+
+/** Is the sensor sample a field of the binary telemetry frame? */
+bool MyMqtt::isInTelemetry(const MySample &sample)
+{
+   for (int i = 0; i < MQTT_TELEMETRY_SAMPLES; i++) {
+      if (telemetrySamples[i].type == sample.type && strcmp(telemetrySamples[i].sensor, sample.sensor) == 0) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/** Has a valid sensor sample to be published? Invalid samples are not published at all. */
+bool MyMqtt::isSampleDue(int index, long currentSec)
+{
+   const MySample &sample = myData.samples.get(index);
+
+   return sample.isValid && isOutOfBand(sampleBands[index], sample.value, getSampleBand(sample.type), currentSec);
+}
+
+/** 
+  * Is there room in the QoS 1 window for all the due gps values? 
+  * An empty window is always used, even if it is smaller than the number of values.
+  */
+bool MyMqtt::canPublishGps(const bool *due)
+{
+   int count = 0;
+
+   if (myOptions.mqttQos1Window <= 0 || inflightCount() == 0) {
+      return true;
+   }
+   for (int i = 0; i <= BAND_KMPH; i++) {
+      count += due[i] ? 1 : 0;
+   }
+   return inflightCount() + count <= min(myOptions.mqttQos1Window, (long) MQTT_MAX_INFLIGHT);
+}
+
+/** 
+  * Publish one gps value with QoS 1 if configured. 
+  * It is kept in the window until the server acknowledges it.
+  */
+bool MyMqtt::publishGps(const char *topic, const String &value)
+{
+   if (myOptions.mqttQos1Window <= 0) {
+      return publish(topic, value.c_str(), true);
+   }
+   setInflightWindow(min(myOptions.mqttQos1Window, (long) MQTT_MAX_INFLIGHT));
+   if (!publish(topic, value.c_str(), true, 1)) {
+      MyDbg("mqtt window full: " + String(topic));
+      return false;
+   }
+   return true;
+}
+
+/** 
+  * Publish voltage, BME280, signal quality and gps values as one binary delta frame.
+  * The deltas refer to the last acknowledged frame. With QoS 1 a frame counts as 
+  * acknowledged when the window is empty, with QoS 0 as soon as it is sent.
+  */
+bool MyMqtt::publishTelemetry()
+{
+   MyTelemetryFrame frame;
+   uint8_t          buf[TELEMETRY_MAX_FRAME];
+   bool             isQos1 = myOptions.mqttQos1Window > 0;
+
+   if (isQos1 && inflightCount() == 0) {
+      telemetry.acknowledge();
+   }
+   frame.values[TELEMETRY_LATITUDE]    = round(atof(myData.latitude.c_str())  * 100000.0);
+   frame.values[TELEMETRY_LONGITUDE]   = round(atof(myData.longitude.c_str()) * 100000.0);
+   frame.values[TELEMETRY_ALTITUDE]    = round(atof(myData.altitude.c_str()));
+   frame.values[TELEMETRY_KMPH]        = round(atof(myData.kmph.c_str())      * 10.0);
+   frame.values[TELEMETRY_VOLTAGE]     = round(myData.voltage     * 100.0);
+   frame.values[TELEMETRY_CSQ]         = atoi(myData.signalQuality.c_str());
+   for (int i = 0; i < MQTT_TELEMETRY_SAMPLES; i++) {
+      const MyMqttTelemetrySample &info  = telemetrySamples[i];
+      double                       value = 0.0;
+
+      myData.samples.getValue(info.sensor, info.type, value);
+      frame.values[info.field] = round(value * info.scale);
+   }
+
+   int len = telemetry.encode(frame, buf, myOptions.mqttKeyframeEvery);
+
+   if (isQos1) {
+      setInflightWindow(min(myOptions.mqttQos1Window, (long) MQTT_MAX_INFLIGHT));
+   }
+   if (!publish(topic_telemetry, buf, len, false, isQos1 ? 1 : 0)) {
+      MyDbg("mqtt telemetry not sent");
+      return false;
+   }
+   telemetry.commit();
+   if (!isQos1) {
+      telemetry.acknowledge();
+   }
+   MyDbg("mqtt telemetry " + String(buf[0] == TELEMETRY_KEYFRAME ? "keyframe" : "delta") + " (" + String(len) + " bytes)");
+   return true;
+}
+
+/** Sets the MQTT server settings, restores the unacknowledged publishes and the measured NAT timeout. */
 bool MyMqtt::begin()
 {
    MyDbg("MQTT:begin");
    setServer(MQTT_SERVER, MQTT_PORT);
    setCallback(mqttCallback);
+   setCleanSession(false);
+   setStore(myStore);
+   if (inflightCount() > 0) {
+      MyDbg("mqtt unacknowledged: " + String(inflightCount()));
+   }
 
+   MyMqttRtc tmp;
+
+   ESP.rtcUserMemoryRead(RTC_MQTT_OFFSET, (uint32_t *) &tmp, sizeof(tmp));
+   if (tmp.magic == RTC_MQTT_MAGIC) {
+      rtc = tmp;
+   } else {
+      rtc.magic         = RTC_MQTT_MAGIC;
+      rtc.natTimeoutSec = 0;
+   }
+   myData.mqttNatTimeoutSec = rtc.natTimeoutSec;
+   myData.mqttKeepAliveSec  = getKeepAliveSec();
    return true;
 }
 
-/** Connect To the MQTT server and send the data when the time is right. */
+/** Write the unacknowledged publishes into the SPIFFS before a deep sleep or a modem power off. */
+void MyMqtt::save()
+{
+   if (inflightCount() > 0) {
+      MyDbg("mqtt save unacknowledged: " + String(inflightCount()));
+   }
+   saveInflight();
+}
+
+/** 
+  * Connect To the MQTT server and send the data when the time is right. 
+  * Between the sendings the sim808 is only touched to collect acknowledgements 
+  * and for the keepalive, so it can stay in the slow clock mode and the socket 
+  * and the server session are kept open.
+  */
 void MyMqtt::handleClient()
 {
    if (myGsmGps.isGsmActive) {
-      if (!PubSubClient::connected()) {
-         long currSec = millis() / 1000;
-         
-         if (currSec - mqttLastReconnectSec > myOptions.mqttReconnectIntervalSec) {
-            mqttLastReconnectSec = currSec;
-            reconnect();
-         }
+      bool send       = false;
+      bool poll       = false;
+      long currentSec = millis() / 1000;
+
+      if (myData.isMoving) {
+         send = currentSec - mqttLastSendSec > myOptions.mqttSendOnMoveEverySec * myData.mqttSendFactor;
+      } else {
+         send = currentSec - mqttLastSendSec > myOptions.mqttSendOnNonMoveEverySec * myData.mqttSendFactor;
+      }
+      if (isSessionUp) {
+         // Wake up twice per keepalive so the ping response is read before the next ping is due
+         // and every MQTT_ACK_POLL_SEC while QoS 1 acknowledgements are outstanding
+         poll = (inflightCount() > 0 && currentSec - mqttLastPollSec >= MQTT_ACK_POLL_SEC) || 
+                currentSec - mqttLastPollSec > myData.mqttKeepAliveSec / 2;
+      }
+      if (!send && !poll) {
+         return;
+      }
+      if (!isSessionUp && currentSec < mqttNextReconnectSec) {
+         // Backoff after a failed connection attempt
+         return;
       }
-      if (connected()) {
-         bool send       = false;
-         long currentSec = millis() / 1000;
 
-         if (myData.isMoving) {
-            send = currentSec - mqttLastSendSec > myOptions.mqttSendOnMoveEverySec;
+      myGsmGps.wakeUp();
+      if (!send) {
+         if (PubSubClient::loop()) {
+            mqttLastPollSec = currentSec;
          } else {
-            send = currentSec - mqttLastSendSec > myOptions.mqttSendOnNonMoveEverySec;
+            connectionLost(currentSec);
          }
-         if (send && sendData()) {
-            mqttLastSendSec = currentSec;
+         return;
+      }
+
+      myEnergy.set(ENERGY_GPRS, true);
+      if (!PubSubClient::connected()) {
+         if (isSessionUp) {
+            connectionLost(currentSec);
          }
+         reconnect(currentSec);
+      }
+      if (connected() && sendData()) {
+         mqttLastSendSec = currentSec;
+         mqttLastPollSec = currentSec;
       }
+      myEnergy.set(ENERGY_GPRS, false);
    }
 }
 
 MyOptions *MyMqtt::g_myOptions = NULL;
 
+const char *MyMqtt::bandTopics[BAND_FIELDS] = {
+   topic_lat, topic_lon, topic_alt, topic_kmph, topic_voltage, topic_csq, topic_batt_level, topic_batt_volt
+};
+
+const MyMqttTelemetrySample MyMqtt::telemetrySamples[MQTT_TELEMETRY_SAMPLES] = {
+   // field                  sensor    type                scale
+   { TELEMETRY_TEMPERATURE,  "BME280", SAMPLE_TEMPERATURE, 10.0 },
+   { TELEMETRY_HUMIDITY,     "BME280", SAMPLE_HUMIDITY,    10.0 },
+   { TELEMETRY_PRESSURE,     "BME280", SAMPLE_PRESSURE,    10.0 }
+};
+
 /** Static function for MQTT callback on registered topics. */
 void MyMqtt::mqttCallback(char* topic, byte* payload, unsigned int len) 
 {
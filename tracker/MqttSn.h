@@ -0,0 +1,141 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file MqttSn.h
+  *
+  * Sending the reports as MQTT-SN datagrams over UDP.
+  */
+
+
+#include <MqttSnClient.h>
+
+/**
+  * MQTT-SN publisher for minimal airtime. 
+  * Every report is one datagram with a topic id pre-defined in the gateway,
+  * so there is no TCP handshake, no CONNECT and no acknowledgement.
+  * The values are sent comma separated: 
+  * latitude,longitude,altitude,kmph,voltage,temperature,humidity,pressure,csq
+  */
+class MyMqttSn : protected MqttSnClient
+{
+protected:
+   MyGsmGps  &myGsmGps;             //!< Reference to the Gsmgps instnces.
+   MyEnergy  &myEnergy;             //!< Reference to the energy model.
+   MyOptions &myOptions;            //!< Reference to the options. 
+   MyData    &myData;               //!< Reference to the data.
+
+   long       mqttLastSendSec;      //!< Timestamp from the last send.
+   long       lastGpsPublishedSec;  //!< The last timestamp of the sended gps data.
+
+protected:
+   String getReport();
+   bool   sendData();
+
+public:
+   MyMqttSn(MyGsmGps &gsmGps, MyEnergy &energy, MyOptions &options, MyData &data);
+   
+   bool begin();
+   void handleClient();
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyMqttSn::MyMqttSn(MyGsmGps &gsmGps, MyEnergy &energy, MyOptions &options, MyData &data)
+   : MqttSnClient(gsmGps.gsmUdpClient)
+   , myGsmGps(gsmGps)
+   , myEnergy(energy)
+   , myOptions(options)
+   , myData(data)
+   , mqttLastSendSec(0)
+   , lastGpsPublishedSec(0)
+{
+}
+
+/** All the values of one report in one comma separated line. */
+String MyMqttSn::getReport()
+{
+   double temperature = 0.0;
+   double humidity    = 0.0;
+   double pressure    = 0.0;
+
+   myData.samples.getValue("BME280", SAMPLE_TEMPERATURE, temperature);
+   myData.samples.getValue("BME280", SAMPLE_HUMIDITY,    humidity);
+   myData.samples.getValue("BME280", SAMPLE_PRESSURE,    pressure);
+   return myData.latitude               + "," +
+          myData.longitude              + "," +
+          myData.altitude               + "," +
+          myData.kmph                   + "," +
+          String(myData.voltage)        + "," +
+          String(temperature)           + "," +
+          String(humidity)              + "," +
+          String(pressure)              + "," +
+          myData.signalQuality;
+}
+
+/** Send the report as one datagram if the gps values are new. */
+bool MyMqttSn::sendData()
+{
+   if (myData.lastGpsUpdateSec == lastGpsPublishedSec) {
+      return false;
+   }
+
+   String   report    = getReport();
+   uint32_t sendCount = myGsmGps.gsmUdpClient.getSendCount();
+
+   setServer(myOptions.mqttServer.c_str(), myOptions.mqttSnPort);
+   if (!publish(myOptions.mqttSnTopicId, report.c_str(), true)) {
+      MyDbg("mqtt-sn publishing failed");
+      return false;
+   }
+   lastGpsPublishedSec = myData.lastGpsUpdateSec;
+   MyDbg("mqtt-sn published " + String(report.length()) + " bytes (" + 
+         String(myGsmGps.gsmUdpClient.getSendCount() - sendCount) + " modem sends)");
+   return true;
+}
+
+/** Nothing to prepare, the gateway address is set on every send. */
+bool MyMqttSn::begin()
+{
+   MyDbg("MQTT-SN:begin");
+   return true;
+}
+
+/** Send the report when the time is right. */
+void MyMqttSn::handleClient()
+{
+   if (myGsmGps.isGsmActive) {
+      bool send       = false;
+      long currentSec = millis() / 1000;
+
+      if (myData.isMoving) {
+         send = currentSec - mqttLastSendSec > myOptions.mqttSendOnMoveEverySec * myData.mqttSendFactor;
+      } else {
+         send = currentSec - mqttLastSendSec > myOptions.mqttSendOnNonMoveEverySec * myData.mqttSendFactor;
+      }
+      if (!send) {
+         return;
+      }
+
+      myGsmGps.wakeUp();
+      myEnergy.set(ENERGY_GPRS, true);
+      if (sendData()) {
+         mqttLastSendSec = currentSec;
+      }
+      myEnergy.set(ENERGY_GPRS, false);
+   }
+}
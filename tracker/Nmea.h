@@ -0,0 +1,291 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Nmea.h
+  *
+  * Incremental parser of the nmea stream of the sim808 gnss engine.
+  */
+
+
+#define NMEA_TERM_SIZE  16     //!< Maximum length of one term of a sentence (longer terms are cut).
+#define NMEA_TASK_MS    100    //!< Interval to read the nmea stream from the serial buffer.
+#define NMEA_KNOTS_KMPH 1.852  //!< Factor from knots to km/h.
+#define NMEA_RMC_TERMS  10     //!< Minimum number of terms of a RMC sentence.
+#define NMEA_GGA_TERMS  10     //!< Minimum number of terms of a GGA sentence.
+#define NMEA_GSA_TERMS  18     //!< Minimum number of terms of a GSA sentence.
+
+/**
+  * Types of the evaluated nmea sentences.
+  */
+enum MyNmeaSentence
+{
+   NMEA_OTHER, //!< Sentence is ignored.
+   NMEA_RMC,   //!< Time, date, position, speed and course.
+   NMEA_GGA,   //!< Fix quality, satellites, hdop and altitude.
+   NMEA_GSA    //!< Fix mode and the dilutions of precision.
+};
+
+/**
+  * State machine which parses the nmea sentences byte by byte as they arrive.
+  * The terms are collected in a fixed buffer and the values of a sentence are
+  * only committed to the MyGps data if its checksum is valid.
+  */
+class MyNmeaParser
+{
+protected:
+   MyGps          &gps;                  //!< Target of the committed values.
+   char            term[NMEA_TERM_SIZE]; //!< Current term of the sentence.
+   uint8_t         termLength;           //!< Used chars of the term.
+   uint8_t         termNumber;           //!< Index of the term in the sentence.
+   uint8_t         checksum;             //!< XOR of the chars between '$' and '*'.
+   bool            isInSentence;         //!< Was a '$' received?
+   bool            isChecksumTerm;       //!< Was the '*' received?
+   bool            hasNewFix;            //!< Was a valid RMC fix committed since the last getNewFix()?
+   MyNmeaSentence  sentence;             //!< Type of the current sentence.
+
+   bool            isFix;                //!< RMC status 'A' or GGA quality > 0.
+   long            date;                 //!< Date of the sentence (YearMonthDay).
+   long            time;                 //!< Time of the sentence (HoursMinutesSeconds).
+   MyDegrees       latitude;             //!< Latitude of the sentence.
+   MyDegrees       longitude;            //!< Longitude of the sentence.
+   double          speed;                //!< Speed in knots.
+   double          course;               //!< Course in degrees.
+   double          altitude;             //!< Altitude in m.
+   double          hdop;                 //!< Horizontal dilution of precision.
+   double          pdop;                 //!< Dilution of precision.
+   double          vdop;                 //!< Vertical dilution of precision.
+   int             satellites;           //!< Satellites used for the fix.
+   int             fixMode;              //!< Fix mode (1 = none, 2 = 2D, 3 = 3D).
+
+public:
+   unsigned long   sentences;            //!< Number of committed sentences.
+   unsigned long   checksumErrors;       //!< Number of sentences with a wrong checksum.
+
+protected:
+   void parseTerm();
+   void commit();
+
+   static int fromHex(char c);
+
+public:
+   MyNmeaParser(MyGps &gps);
+
+   bool encode(char c);
+   bool getNewFix();
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyNmeaParser::MyNmeaParser(MyGps &gps)
+   : gps(gps)
+   , termLength(0)
+   , termNumber(0)
+   , checksum(0)
+   , isInSentence(false)
+   , isChecksumTerm(false)
+   , hasNewFix(false)
+   , sentence(NMEA_OTHER)
+   , isFix(false)
+   , date(0)
+   , time(0)
+   , speed(0.0)
+   , course(0.0)
+   , altitude(0.0)
+   , hdop(0.0)
+   , pdop(0.0)
+   , vdop(0.0)
+   , satellites(0)
+   , fixMode(0)
+   , sentences(0)
+   , checksumErrors(0)
+{
+}
+
+/** Value of one hex digit or -1. */
+int MyNmeaParser::fromHex(char c)
+{
+   if (c >= '0' && c <= '9') {
+      return c - '0';
+   }
+   if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+   }
+   if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+   }
+   return -1;
+}
+
+/**
+  * Process one received char.
+  * Returns true if a complete sentence with a valid checksum was committed.
+  */
+bool MyNmeaParser::encode(char c)
+{
+   switch (c) {
+      case '$':
+         isInSentence   = true;
+         isChecksumTerm = false;
+         sentence       = NMEA_OTHER;
+         isFix          = false;
+         termNumber     = 0;
+         termLength     = 0;
+         checksum       = 0;
+         return false;
+      case ',':
+      case '*':
+         if (!isInSentence || isChecksumTerm) {
+            isInSentence = false;
+            return false;
+         }
+         if (c == ',') {
+            checksum ^= c;
+         }
+         term[termLength] = 0;
+         parseTerm();
+         termNumber++;
+         termLength     = 0;
+         isChecksumTerm = c == '*';
+         return false;
+      case '\r':
+      case '\n':
+         if (!isInSentence) {
+            return false;
+         }
+         isInSentence = false;
+         if (isChecksumTerm && termLength == 2 &&
+             fromHex(term[0]) * 16 + fromHex(term[1]) == checksum) {
+            commit();
+            sentences++;
+            return true;
+         }
+         checksumErrors++;
+         return false;
+      default:
+         if (!isInSentence) {
+            return false;
+         }
+         if (!isChecksumTerm) {
+            checksum ^= c;
+         }
+         if (termLength < NMEA_TERM_SIZE - 1) {
+            term[termLength++] = c;
+         }
+         return false;
+   }
+}
+
+/** Store one finished term of the current sentence. */
+void MyNmeaParser::parseTerm()
+{
+   if (termNumber == 0) {
+      // Talker (GP, GL, GN) and sentence type
+      if (termLength == 5 && strcmp(term + 2, "RMC") == 0) {
+         sentence = NMEA_RMC;
+      } else if (termLength == 5 && strcmp(term + 2, "GGA") == 0) {
+         sentence = NMEA_GGA;
+      } else if (termLength == 5 && strcmp(term + 2, "GSA") == 0) {
+         sentence = NMEA_GSA;
+      }
+      return;
+   }
+
+   switch (sentence) {
+      case NMEA_RMC:
+         switch (termNumber) {
+            case 1: time = atol(term);                       break;
+            case 2: isFix = term[0] == 'A';                  break;
+            case 3: latitude.setNmea(term);                  break;
+            case 4: latitude.negative = term[0] == 'S';      break;
+            case 5: longitude.setNmea(term);                 break;
+            case 6: longitude.negative = term[0] == 'W';     break;
+            case 7: speed  = atof(term);                     break;
+            case 8: course = atof(term);                     break;
+            case 9: date   = atol(term); // ddmmyy
+                    date   = 20000000L + (date % 100) * 10000 + ((date / 100) % 100) * 100 + date / 10000; break;
+         }
+         break;
+      case NMEA_GGA:
+         switch (termNumber) {
+            case 6: isFix      = atoi(term) > 0;             break;
+            case 7: satellites = atoi(term);                 break;
+            case 8: hdop       = atof(term);                 break;
+            case 9: altitude   = atof(term);                 break;
+         }
+         break;
+      case NMEA_GSA:
+         switch (termNumber) {
+            case 2:  fixMode = atoi(term);                   break;
+            case 15: pdop    = atof(term);                   break;
+            case 16: hdop    = atof(term);                   break;
+            case 17: vdop    = atof(term);                   break;
+         }
+         break;
+      default:
+         break;
+   }
+}
+
+/** Take over the values of a complete sentence with a valid checksum into the gps data. */
+void MyNmeaParser::commit()
+{
+   switch (sentence) {
+      case NMEA_RMC:
+         if (termNumber < NMEA_RMC_TERMS) {
+            break;
+         }
+         gps.runStatus = true;
+         gps.fixStatus = isFix;
+         if (isFix) {
+            gps.date.date           = date;
+            gps.time.time           = time;
+            gps.location.latitude_  = latitude;
+            gps.location.longitude_ = longitude;
+            gps.speed               = speed * NMEA_KNOTS_KMPH;
+            gps.course              = course;
+            hasNewFix               = true;
+         }
+         break;
+      case NMEA_GGA:
+         if (isFix && termNumber >= NMEA_GGA_TERMS) {
+            gps.satellitesUsed = satellites;
+            gps.hdop           = hdop;
+            gps.altitude       = altitude;
+         }
+         break;
+      case NMEA_GSA:
+         if (termNumber >= NMEA_GSA_TERMS) {
+            gps.fixMode = fixMode;
+            gps.pdop    = pdop;
+            gps.hdop    = hdop;
+            gps.vdop    = vdop;
+         }
+         break;
+      default:
+         break;
+   }
+}
+
+/** Was a new fix committed since the last call? */
+bool MyNmeaParser::getNewFix()
+{
+   bool ret = hasNewFix;
+
+   hasNewFix = false;
+   return ret;
+}
@@ -35,31 +35,81 @@ public:
    String wlanPassword;                  //!< WLAN AR password.
    bool   isDebugActive;                 //!< Is detailed debugging enabled?
    long   bme280CheckIntervalSec;        //!< Time interval to read the temp, hum and pressure.
+   long   bme280Profile;                 //!< Sampling profile of the BME280 (oversampling and filter).
+   bool   isDs2438Enabled;               //!< Is a DS2438 battery monitor connected to the 1-wire pin?
+   long   ds2438CheckIntervalSec;        //!< Time interval to read the battery voltage, current and temperature.
+   double ds2438VoltageFactor;           //!< Factor of the voltage divider in front of the DS2438 VAD input.
+   double ds2438SenseOhm;                //!< Current sense resistor of the DS2438 in Ohm.
    bool   gsmPower;                      //!< Is the GSM power from the DC-DC modul switched on? 
    bool   isGsmEnabled;                  //!< Is the gsm part of the sim808 active?
+   bool   isModemSleepEnabled;           //!< Use the sim808 slow clock mode (DTR) between the AT communication.
    bool   isGpsEnabled;                  //!< Is the gps part of the sim808 active?
    long   gpsCheckIntervalSec;           //!< Time interval to check the gps position.
+   bool   isGpsStreamEnabled;            //!< Parse the nmea stream of the gnss engine instead of polling the position.
+   long   cellLocAfterSec;               //!< Use the position of the gsm cell after this time without gnss fix (0 = off).
+   long   cellLocMaxPerHour;             //!< Maximum network lookups of unknown cell positions per hour.
+   bool   isAgpsEnabled;                 //!< Inject the last position, the time and the EPO data on the gps start.
+   String agpsServer;                    //!< Ftp server of the EPO data (empty = no download).
+   String agpsUser;                      //!< Ftp user of the EPO server.
+   String agpsPassword;                  //!< Ftp password of the EPO server.
+   String agpsFile;                      //!< File name of the EPO data on the ftp server.
+   long   agpsValidHours;                //!< Age of the EPO data until it is downloaded again.
    long   minMovingDistance;             //!< Minimum distance to accept as moving or not.
+   double motionSpeedKmph;               //!< Minimum filtered speed to accept as moving.
+   long   motionStopSec;                 //!< Time of slow speed until a moving vehicle is parked.
    String phoneNumber;                   //!< Pone number for sms answers.
-   long   smsCheckIntervalSec;           //!< SMS check intervall.
+   long   smsCheckIntervalSec;           //!< SMS sweep intervall for missed +CMTI indications.
    bool   isDeepSleepEnabled;            //!< Should the system go into deepsleep if needed.
    double powerSaveModeVoltage;          //!< Minimum voltage to stay always alive.
+   double chargingVoltage;               //!< Minimum voltage to detect a charging battery.
+   double criticalVoltage;               //!< Voltage for the long deep sleep without sim808.
+   double voltageHysteresis;             //!< Hysteresis around the profile voltages.
+   long   voltageSamples;                //!< Number of analog samples for the median of one voltage value.
+   double voltageCalibFactor;            //!< Calibration factor of the analog voltage.
+   double voltageCalibOffset;            //!< Calibration offset of the analog voltage in V.
+   long   voltageWindowSec;              //!< Time window of the voltage mean, minimum and maximum.
+   long   historyRawSec;                 //!< Interval of the raw history records (0 = no history).
    long   powerCheckIntervalSec;         //!< Time interval to check the power supply.
    long   wakeTimeSec;                   //!< Maximum alive time after deepsleep.
    long   deepSleepTimeSec;              //!< Time to stay in deep sleep (without check interrupts)
+   double energyEspMA;                   //!< Current of the awake esp8266 in mA.
+   double energyWifiMA;                  //!< Additional current of the switched on WiFi in mA.
+   double energyModemSleepMA;            //!< Current of the sim808 in slow clock mode in mA.
+   double energyModemIdleMA;             //!< Current of the awake sim808 in mA.
+   double energyModemActiveMA;           //!< Current of the sim808 while AT communication in mA.
+   double energyGnssMA;                  //!< Additional current of the switched on GNSS in mA.
+   double energyGprsMA;                  //!< Additional current while GPRS data transfer in mA.
+   double energyDeepSleepMA;             //!< Current of the whole tracker in deep sleep in mA.
    bool   isMqttEnabled;                 //!< Should the system connect to a MQTT server?
+   bool   isMqttSnEnabled;               //!< Send one MQTT-SN datagram per report instead of the MQTT session.
    String mqttName;                      //!< MQTT server name.
    String mqttServer;                    //!< MQTT server url.
    long   mqttPort;                      //!< MQTT server port.
+   long   mqttSnPort;                    //!< UDP port of the MQTT-SN gateway on the MQTT server.
+   long   mqttSnTopicId;                 //!< Pre-defined topic id of the report in the MQTT-SN gateway.
    String mqttUser;                      //!< MQTT user.
    String mqttPassword;                  //!< MQTT password.
-   long   mqttReconnectIntervalSec;      //!< Reconnect interval on disconnection.
+   long   mqttReconnectIntervalSec;      //!< First reconnect interval on disconnection (doubled on every failure).
    long   mqttSendOnMoveEverySec;        //!< Send data interval to MQTT server on moving.
    long   mqttSendOnNonMoveEverySec;     //!< Send data interval to MQTT server on non moving.
+   long   mqttQos1Window;                //!< Unacknowledged QoS 1 publishes of the gps values (0 = QoS 0).
+   long   mqttKeepAliveSec;              //!< Upper limit of the mqtt keepalive (lowered by the measured NAT timeout).
+   long   mqttKeyframeEvery;             //!< Send the report binary delta coded with a keyframe every n messages (0 = text topics).
+   long   mqttHeartbeatSec;              //!< Maximum silence of an unchanged value in seconds (0 = publish always).
+   double mqttBandRelativePct;           //!< Relative deadband of the values in % (the larger band counts).
+   double mqttBandPositionM;             //!< Deadband of the gps position in m.
+   double mqttBandAltitudeM;             //!< Deadband of the gps altitude in m.
+   double mqttBandKmph;                  //!< Deadband of the gps speed in km/h.
+   double mqttBandVoltage;               //!< Deadband of the voltages in V.
+   double mqttBandTemperature;           //!< Deadband of the temperature in degrees Celsius.
+   double mqttBandHumidity;              //!< Deadband of the humidity in %.
+   double mqttBandPressure;              //!< Deadband of the pressure in hPa.
+   double mqttBandCsq;                   //!< Deadband of the signal quality.
 
 public:
    MyOptions();
 
+   bool setValue(const String &key, const String &value);
    bool load();
    bool save();
 };
@@ -72,30 +122,244 @@ MyOptions::MyOptions()
    , wlanPassword(WLAN_PW)
    , isDebugActive(false)
    , bme280CheckIntervalSec(60)
+   , bme280Profile(0)
+   , isDs2438Enabled(false)
+   , ds2438CheckIntervalSec(10)
+   , ds2438VoltageFactor(2.0)
+   , ds2438SenseOhm(0.05)
    , gsmPower(false)
    , isGsmEnabled(true)
+   , isModemSleepEnabled(false)
    , isGpsEnabled(true)
    , gpsCheckIntervalSec(10)
+   , isGpsStreamEnabled(false)
+   , cellLocAfterSec(120)
+   , cellLocMaxPerHour(4)
+   , isAgpsEnabled(true)
+   , agpsServer("")
+   , agpsUser("")
+   , agpsPassword("")
+   , agpsFile("MTK7d.EPO")
+   , agpsValidHours(72)
    , minMovingDistance(20)
+   , motionSpeedKmph(5.0)
+   , motionStopSec(120)
    , phoneNumber(PHONE_NUMBER)
-   , smsCheckIntervalSec(15)
+   , smsCheckIntervalSec(300)
    , isDeepSleepEnabled(false)
    , powerSaveModeVoltage(12.0)
+   , chargingVoltage(13.2)
+   , criticalVoltage(11.5)
+   , voltageHysteresis(0.2)
+   , voltageSamples(15)
+   , voltageCalibFactor(1.0)
+   , voltageCalibOffset(0.0)
+   , voltageWindowSec(300)
+   , historyRawSec(10)
    , powerCheckIntervalSec(10)
    , wakeTimeSec(15)
    , deepSleepTimeSec(60)
+   , energyEspMA(15.0)
+   , energyWifiMA(55.0)
+   , energyModemSleepMA(1.0)
+   , energyModemIdleMA(20.0)
+   , energyModemActiveMA(90.0)
+   , energyGnssMA(25.0)
+   , energyGprsMA(150.0)
+   , energyDeepSleepMA(0.3)
    , isMqttEnabled(false)
+   , isMqttSnEnabled(false)
    , mqttName(MQTT_NAME)
    , mqttServer(MQTT_SERVER)  
    , mqttPort(MQTT_PORT)
+   , mqttSnPort(1884)
+   , mqttSnTopicId(1)
    , mqttUser(MQTT_USER)
    , mqttPassword(MQTT_PASSWORD)
    , mqttReconnectIntervalSec(10)
    , mqttSendOnMoveEverySec(10)
    , mqttSendOnNonMoveEverySec(15)
+   , mqttQos1Window(4)
+   , mqttKeepAliveSec(300)
+   , mqttKeyframeEvery(0)
+   , mqttHeartbeatSec(900)
+   , mqttBandRelativePct(0.0)
+   , mqttBandPositionM(25.0)
+   , mqttBandAltitudeM(10.0)
+   , mqttBandKmph(5.0)
+   , mqttBandVoltage(0.05)
+   , mqttBandTemperature(0.5)
+   , mqttBandHumidity(2.0)
+   , mqttBandPressure(1.0)
+   , mqttBandCsq(2.0)
 {
 }
 
+/** 
+  * Set one option by its key and value string. Used by the option file and the sms commands.
+  * Returns false if the key is unknown.
+  */
+bool MyOptions::setValue(const String &key, const String &value)
+{
+   long   lValue = atoi(value.c_str());
+   double fValue = atof(value.c_str());
+
+   if (key == "gprsAP") {
+      gprsAP = value;
+   } else if (key == "wlanAP") {
+      wlanAP = value;
+   } else if (key == "wlanPassword") {
+      wlanPassword = value;
+   } else if (key == "gsmPower") {
+      gsmPower = lValue;
+   } else if (key == "isDebugActive") {
+      isDebugActive = lValue;
+   } else if (key == "bme280CheckIntervalSec") {
+      bme280CheckIntervalSec = lValue;
+   } else if (key == "bme280Profile") {
+      bme280Profile = lValue;
+   } else if (key == "isDs2438Enabled") {
+      isDs2438Enabled = lValue;
+   } else if (key == "ds2438CheckIntervalSec") {
+      ds2438CheckIntervalSec = lValue;
+   } else if (key == "ds2438VoltageFactor") {
+      ds2438VoltageFactor = fValue;
+   } else if (key == "ds2438SenseOhm") {
+      ds2438SenseOhm = fValue;
+   } else if (key == "isGsmEnabled") {
+      isGsmEnabled = lValue;
+   } else if (key == "isModemSleepEnabled") {
+      isModemSleepEnabled = lValue;
+   } else if (key == "isGpsEnabled") {
+      isGpsEnabled = lValue;
+   } else if (key == "gpsCheckIntervalSec") {
+      gpsCheckIntervalSec = lValue;
+   } else if (key == "isGpsStreamEnabled") {
+      isGpsStreamEnabled = lValue;
+   } else if (key == "cellLocAfterSec") {
+      cellLocAfterSec = lValue;
+   } else if (key == "cellLocMaxPerHour") {
+      cellLocMaxPerHour = lValue;
+   } else if (key == "isAgpsEnabled") {
+      isAgpsEnabled = lValue;
+   } else if (key == "agpsServer") {
+      agpsServer = value;
+   } else if (key == "agpsUser") {
+      agpsUser = value;
+   } else if (key == "agpsPassword") {
+      agpsPassword = value;
+   } else if (key == "agpsFile") {
+      agpsFile = value;
+   } else if (key == "agpsValidHours") {
+      agpsValidHours = lValue;
+   } else if (key == "minMovingDistance") {
+      minMovingDistance = lValue;
+   } else if (key == "motionSpeedKmph") {
+      motionSpeedKmph = fValue;
+   } else if (key == "motionStopSec") {
+      motionStopSec = lValue;
+   } else if (key == "phoneNumber") {
+      phoneNumber = value;
+   } else if (key == "smsCheckIntervalSec") {
+      smsCheckIntervalSec = lValue;
+   } else if (key == "isDeepSleepEnabled") {
+      isDeepSleepEnabled = lValue;
+   } else if (key == "powerSaveModeVoltage") {
+      powerSaveModeVoltage = fValue;
+   } else if (key == "chargingVoltage") {
+      chargingVoltage = fValue;
+   } else if (key == "criticalVoltage") {
+      criticalVoltage = fValue;
+   } else if (key == "voltageHysteresis") {
+      voltageHysteresis = fValue;
+   } else if (key == "voltageSamples") {
+      voltageSamples = lValue;
+   } else if (key == "voltageCalibFactor") {
+      voltageCalibFactor = fValue;
+   } else if (key == "voltageCalibOffset") {
+      voltageCalibOffset = fValue;
+   } else if (key == "voltageWindowSec") {
+      voltageWindowSec = lValue;
+   } else if (key == "historyRawSec") {
+      historyRawSec = lValue;
+   } else if (key == "powerCheckIntervalSec") {
+      powerCheckIntervalSec = lValue;
+   } else if (key == "wakeTimeSec") {
+      wakeTimeSec = lValue;
+   } else if (key == "deepSleepTimeSec") {
+      deepSleepTimeSec = lValue;
+   } else if (key == "energyEspMA") {
+      energyEspMA = fValue;
+   } else if (key == "energyWifiMA") {
+      energyWifiMA = fValue;
+   } else if (key == "energyModemSleepMA") {
+      energyModemSleepMA = fValue;
+   } else if (key == "energyModemIdleMA") {
+      energyModemIdleMA = fValue;
+   } else if (key == "energyModemActiveMA") {
+      energyModemActiveMA = fValue;
+   } else if (key == "energyGnssMA") {
+      energyGnssMA = fValue;
+   } else if (key == "energyGprsMA") {
+      energyGprsMA = fValue;
+   } else if (key == "energyDeepSleepMA") {
+      energyDeepSleepMA = fValue;
+   } else if (key == "isMqttEnabled") {
+      isMqttEnabled = lValue;
+   } else if (key == "isMqttSnEnabled") {
+      isMqttSnEnabled = lValue;
+   } else if (key == "mqttName") {
+      mqttName = value;
+   } else if (key == "mqttServer") {
+      mqttServer = value;
+   } else if (key == "mqttPort") {
+      mqttPort = lValue;
+   } else if (key == "mqttSnPort") {
+      mqttSnPort = lValue;
+   } else if (key == "mqttSnTopicId") {
+      mqttSnTopicId = lValue;
+   } else if (key == "mqttUser") {
+      mqttUser = value;
+   } else if (key == "mqttPassword") {
+      mqttPassword = value;
+   } else if (key == "mqttSendOnMoveEverySec") {
+      mqttSendOnMoveEverySec = lValue;
+   } else if (key == "mqttSendOnNonMoveEverySec") {
+      mqttSendOnNonMoveEverySec = lValue;
+   } else if (key == "mqttReconnectIntervalSec") {
+      mqttReconnectIntervalSec = lValue;
+   } else if (key == "mqttQos1Window") {
+      mqttQos1Window = lValue;
+   } else if (key == "mqttKeepAliveSec") {
+      mqttKeepAliveSec = lValue;
+   } else if (key == "mqttKeyframeEvery") {
+      mqttKeyframeEvery = lValue;
+   } else if (key == "mqttHeartbeatSec") {
+      mqttHeartbeatSec = lValue;
+   } else if (key == "mqttBandRelativePct") {
+      mqttBandRelativePct = fValue;
+   } else if (key == "mqttBandPositionM") {
+      mqttBandPositionM = fValue;
+   } else if (key == "mqttBandAltitudeM") {
+      mqttBandAltitudeM = fValue;
+   } else if (key == "mqttBandKmph") {
+      mqttBandKmph = fValue;
+   } else if (key == "mqttBandVoltage") {
+      mqttBandVoltage = fValue;
+   } else if (key == "mqttBandTemperature") {
+      mqttBandTemperature = fValue;
+   } else if (key == "mqttBandHumidity") {
+      mqttBandHumidity = fValue;
+   } else if (key == "mqttBandPressure") {
+      mqttBandPressure = fValue;
+   } else if (key == "mqttBandCsq") {
+      mqttBandCsq = fValue;
+   } else {
+      return false;
+   }
+   return true;
+}
+
 /** Load the key-value pairs from the option file into the option values. */
 bool MyOptions::load()
 {
@@ -114,66 +378,14 @@ bool MyOptions::load()
             MyDbg("Wrong option entry: " + line);
             ret = false;
          } else {
-            String key    = line.substring(0, idx);
-            String value  = line.substring(idx + 1);
-            long   lValue = atoi(value.c_str());
-            double fValue = atof(value.c_str());
+            String key   = line.substring(0, idx);
+            String value = line.substring(idx + 1);
 
             value.replace("\r", "");
             value.replace("\n", "");
             MyDbg("Load option '" + key + "=" + value + "'");
 
-            if (key == "gprsAP") {
-               gprsAP = value;
-            } else if (key == "wlanAP") {
-               wlanAP = value;
-            } else if (key == "wlanPassword") {
-               wlanPassword = value;
-            } else if (key == "gsmPower") {
-               gsmPower = lValue;
-            } else if (key == "isDebugActive") {
-               isDebugActive = lValue;
-            } else if (key == "bme280CheckIntervalSec") {
-               bme280CheckIntervalSec = lValue;
-            } else if (key == "isGsmEnabled") {
-               isGsmEnabled = lValue;
-            } else if (key == "isGpsEnabled") {
-               isGpsEnabled = lValue;
-            } else if (key == "gpsCheckIntervalSec") {
-               gpsCheckIntervalSec = lValue;
-            } else if (key == "minMovingDistance") {
-               minMovingDistance = lValue;
-            } else if (key == "phoneNumber") {
-               phoneNumber = value;
-            } else if (key == "smsCheckIntervalSec") {
-               smsCheckIntervalSec = lValue;
-            } else if (key == "isDeepSleepEnabled") {
-               isDeepSleepEnabled = lValue;
-            } else if (key == "powerSaveModeVoltage") {
-               powerSaveModeVoltage = fValue;
-            } else if (key == "powerCheckIntervalSec") {
-               powerCheckIntervalSec = lValue;
-            } else if (key == "wakeTimeSec") {
-               wakeTimeSec = lValue;
-            } else if (key == "deepSleepTimeSec") {
-               deepSleepTimeSec = lValue;
-            } else if (key == "isMqttEnabled") {
-               isMqttEnabled = lValue;
-            } else if (key == "mqttName") {
-               mqttName = value;
-            } else if (key == "mqttServer") {
-               mqttServer = value;
-            } else if (key == "mqttPort") {
-               mqttPort = lValue;
-            } else if (key == "mqttUser") {
-               mqttUser = value;
-            } else if (key == "mqttPassword") {
-               mqttPassword = value;
-            } else if (key == "mqttSendOnMoveEverySec") {
-               mqttSendOnMoveEverySec = lValue;
-            } else if (key == "mqttSendOnNonMoveEverySec") {
-               mqttSendOnNonMoveEverySec = lValue;
-            } else {
+            if (!setValue(key, value)) {
                MyDbg("Wrong option entry: " + line);
                ret = false;
             }
@@ -201,25 +413,75 @@ bool MyOptions::save()
      file.println("gsmPower="                  + String(gsmPower));
      file.println("isDebugActive="             + String(isDebugActive));
      file.println("bme280CheckIntervalSec="    + String(bme280CheckIntervalSec));
+     file.println("bme280Profile="             + String(bme280Profile));
+     file.println("isDs2438Enabled="           + String(isDs2438Enabled));
+     file.println("ds2438CheckIntervalSec="    + String(ds2438CheckIntervalSec));
+     file.println("ds2438VoltageFactor="       + String(ds2438VoltageFactor, 2));
+     file.println("ds2438SenseOhm="            + String(ds2438SenseOhm, 3));
      file.println("isGsmEnabled="              + String(isGsmEnabled));
+     file.println("isModemSleepEnabled="       + String(isModemSleepEnabled));
      file.println("isGpsEnabled="              + String(isGpsEnabled));
      file.println("gpsCheckIntervalSec="       + String(gpsCheckIntervalSec));
+     file.println("isGpsStreamEnabled="        + String(isGpsStreamEnabled));
+     file.println("cellLocAfterSec="           + String(cellLocAfterSec));
+     file.println("cellLocMaxPerHour="         + String(cellLocMaxPerHour));
+     file.println("isAgpsEnabled="             + String(isAgpsEnabled));
+     file.println("agpsServer="                + agpsServer);
+     file.println("agpsUser="                  + agpsUser);
+     file.println("agpsPassword="              + agpsPassword);
+     file.println("agpsFile="                  + agpsFile);
+     file.println("agpsValidHours="            + String(agpsValidHours));
      file.println("minMovingDistance="         + String(minMovingDistance));
+     file.println("motionSpeedKmph="           + String(motionSpeedKmph, 1));
+     file.println("motionStopSec="             + String(motionStopSec));
      file.println("phoneNumber="               + phoneNumber);
      file.println("smsCheckIntervalSec="       + String(smsCheckIntervalSec));
      file.println("isDeepSleepEnabled="        + String(isDeepSleepEnabled));
      file.println("powerSaveModeVoltage="      + String(powerSaveModeVoltage, 1));
+     file.println("chargingVoltage="           + String(chargingVoltage, 1));
+     file.println("criticalVoltage="           + String(criticalVoltage, 1));
+     file.println("voltageHysteresis="         + String(voltageHysteresis, 2));
+     file.println("voltageSamples="            + String(voltageSamples));
+     file.println("voltageCalibFactor="        + String(voltageCalibFactor, 4));
+     file.println("voltageCalibOffset="        + String(voltageCalibOffset, 3));
+     file.println("voltageWindowSec="          + String(voltageWindowSec));
+     file.println("historyRawSec="             + String(historyRawSec));
      file.println("powerCheckIntervalSec="     + String(powerCheckIntervalSec));
      file.println("wakeTimeSec="               + String(wakeTimeSec));
      file.println("deepSleepTimeSec="          + String(deepSleepTimeSec));
+     file.println("energyEspMA="               + String(energyEspMA, 1));
+     file.println("energyWifiMA="              + String(energyWifiMA, 1));
+     file.println("energyModemSleepMA="        + String(energyModemSleepMA, 2));
+     file.println("energyModemIdleMA="         + String(energyModemIdleMA, 1));
+     file.println("energyModemActiveMA="       + String(energyModemActiveMA, 1));
+     file.println("energyGnssMA="              + String(energyGnssMA, 1));
+     file.println("energyGprsMA="              + String(energyGprsMA, 1));
+     file.println("energyDeepSleepMA="         + String(energyDeepSleepMA, 2));
      file.println("isMqttEnabled="             + String(isMqttEnabled));
+     file.println("isMqttSnEnabled="           + String(isMqttSnEnabled));
      file.println("mqttName="                  + mqttName);
      file.println("mqttServer="                + mqttServer);
      file.println("mqttPort="                  + String(mqttPort));
+     file.println("mqttSnPort="                + String(mqttSnPort));
+     file.println("mqttSnTopicId="             + String(mqttSnTopicId));
      file.println("mqttUser="                  + mqttUser);
      file.println("mqttPassword="              + mqttPassword);
      file.println("mqttSendOnMoveEverySec="    + String(mqttSendOnMoveEverySec));
      file.println("mqttSendOnNonMoveEverySec=" + String(mqttSendOnNonMoveEverySec));
+     file.println("mqttReconnectIntervalSec="  + String(mqttReconnectIntervalSec));
+     file.println("mqttQos1Window="            + String(mqttQos1Window));
+     file.println("mqttKeepAliveSec="          + String(mqttKeepAliveSec));
+     file.println("mqttKeyframeEvery="         + String(mqttKeyframeEvery));
+     file.println("mqttHeartbeatSec="          + String(mqttHeartbeatSec));
+     file.println("mqttBandRelativePct="       + String(mqttBandRelativePct, 2));
+     file.println("mqttBandPositionM="         + String(mqttBandPositionM, 2));
+     file.println("mqttBandAltitudeM="         + String(mqttBandAltitudeM, 2));
+     file.println("mqttBandKmph="              + String(mqttBandKmph, 2));
+     file.println("mqttBandVoltage="           + String(mqttBandVoltage, 2));
+     file.println("mqttBandTemperature="       + String(mqttBandTemperature, 2));
+     file.println("mqttBandHumidity="          + String(mqttBandHumidity, 2));
+     file.println("mqttBandPressure="          + String(mqttBandPressure, 2));
+     file.println("mqttBandCsq="               + String(mqttBandCsq, 2));
      file.close();
      MyDbg("Settings saved");
      return true;
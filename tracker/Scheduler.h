@@ -0,0 +1,265 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Scheduler.h
+  *
+  * Small cooperative scheduler for the main loop.
+  */
+
+
+#define MAX_SCHEDULER_TASKS 14  //!< Maximum number of registered tasks.
+#define MAX_SCHEDULER_IDLE  100 //!< Maximum idle time in ms between two scheduler runs.
+#define MIN_OPTION_PERIOD   1     //!< Minimum period in seconds of an option task.
+
+typedef void (*MyTaskFunc)(); //!< Task function called by the scheduler.
+
+/**
+  * One registered task with its period, next deadline and runtime statistics.
+  */
+class MyTask
+{
+public:
+   const char   *name;         //!< Name of the task for the information page.
+   MyTaskFunc    func;         //!< Function to call.
+   long          periodMs;     //!< Fixed period in ms (if no option period is set).
+   long         *periodSec;    //!< Optional period in seconds from the options.
+   unsigned long nextRunMs;    //!< Next deadline in ms.
+   unsigned long runCount;     //!< How often was the task called?
+   unsigned long lastRunMs;    //!< Runtime of the last call in ms.
+   unsigned long maxRunMs;     //!< Maximum runtime of one call in ms.
+   unsigned long totalRunMs;   //!< Sum of all runtimes in ms.
+   unsigned long maxJitterMs;  //!< Maximum delay between deadline and start in ms.
+
+public:
+   MyTask();
+
+   long getPeriodMs();
+   bool isDue(unsigned long currMs);
+   void run(unsigned long currMs);
+};
+
+/**
+  * Tickless cooperative scheduler. Every subsystem registers a task with a
+  * period or a deadline. The scheduler runs all the due tasks and waits
+  * with delay() until the nearest deadline.
+  */
+class MyScheduler
+{
+protected:
+   MyTask        tasks[MAX_SCHEDULER_TASKS]; //!< All the registered tasks.
+   int           taskCount;                  //!< Number of registered tasks.
+   unsigned long startMs;                    //!< Start of the statistics.
+   unsigned long idleMs;                     //!< Sum of all idle times in ms.
+
+protected:
+   int  registerTask(const char *name, MyTaskFunc func, long periodMs, long *periodSec);
+   void idle(unsigned long currMs);
+
+public:
+   MyScheduler();
+
+   bool begin();
+
+   int  addTask(const char *name, MyTaskFunc func, long periodMs);
+   int  addOptionTask(const char *name, MyTaskFunc func, long &periodSec);
+   void runIn(int id, long ms);
+
+   void handleClient();
+
+   int     count();
+   MyTask &getAt(int idx);
+   double  getLoad();
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyTask::MyTask()
+   : name("")
+   , func(NULL)
+   , periodMs(0)
+   , periodSec(NULL)
+   , nextRunMs(0)
+   , runCount(0)
+   , lastRunMs(0)
+   , maxRunMs(0)
+   , totalRunMs(0)
+   , maxJitterMs(0)
+{
+}
+
+/** 
+  * Returns the current period. Option periods can be changed at runtime and
+  * are limited to MIN_OPTION_PERIOD, so a wrong option cannot run a task in every loop.
+  */
+long MyTask::getPeriodMs()
+{
+   if (periodSec) {
+      return max(*periodSec, (long) MIN_OPTION_PERIOD) * 1000;
+   }
+   return periodMs;
+}
+
+/** Is the deadline reached? (overflow safe) */
+bool MyTask::isDue(unsigned long currMs)
+{
+   return (long) (currMs - nextRunMs) >= 0;
+}
+
+/** Call the task function, measure the statistics and calculate the next deadline. */
+void MyTask::run(unsigned long currMs)
+{
+   unsigned long jitterMs   = currMs - nextRunMs;
+   unsigned long deadlineMs = nextRunMs;
+
+   if (jitterMs > maxJitterMs) {
+      maxJitterMs = jitterMs;
+   }
+   func();
+
+   unsigned long endMs = millis();
+
+   lastRunMs   = endMs - currMs;
+   totalRunMs += lastRunMs;
+   runCount++;
+   if (lastRunMs > maxRunMs) {
+      maxRunMs = lastRunMs;
+   }
+
+   if (nextRunMs != deadlineMs) {
+      // The task has set its next deadline itself with runIn().
+      return;
+   }
+   // Keep the rhythm but never catch up missed runs.
+   nextRunMs += getPeriodMs();
+   if ((long) (endMs - nextRunMs) > 0) {
+      nextRunMs = endMs + getPeriodMs();
+   }
+}
+
+/** Constructor */
+MyScheduler::MyScheduler()
+   : taskCount(0)
+   , startMs(0)
+   , idleMs(0)
+{
+}
+
+/** Starts the statistics */
+bool MyScheduler::begin()
+{
+   MyDbg("MyScheduler::begin");
+   startMs = millis();
+   idleMs  = 0;
+   return true;
+}
+
+/** Internal registration of one task. The first call is done immediately. */
+int MyScheduler::registerTask(const char *name, MyTaskFunc func, long periodMs, long *periodSec)
+{
+   if (taskCount >= MAX_SCHEDULER_TASKS) {
+      MyDbg("Too many tasks: " + String(name));
+      return -1;
+   }
+
+   MyTask &task = tasks[taskCount];
+
+   task.name      = name;
+   task.func      = func;
+   task.periodMs  = periodMs;
+   task.periodSec = periodSec;
+   task.nextRunMs = millis();
+   return taskCount++;
+}
+
+/** Register a task with a fixed period in ms. */
+int MyScheduler::addTask(const char *name, MyTaskFunc func, long periodMs)
+{
+   return registerTask(name, func, periodMs, NULL);
+}
+
+/** Register a task with a period in seconds from the options. */
+int MyScheduler::addOptionTask(const char *name, MyTaskFunc func, long &periodSec)
+{
+   return registerTask(name, func, 0, &periodSec);
+}
+
+/** Set the next deadline of a task. A task can also delay its own next run (i.e. for a conversion time). */
+void MyScheduler::runIn(int id, long ms)
+{
+   if (id >= 0 && id < taskCount) {
+      tasks[id].nextRunMs = millis() + ms;
+   }
+}
+
+/** Run all the due tasks and wait until the nearest deadline. */
+void MyScheduler::handleClient()
+{
+   for (int i = 0; i < taskCount; i++) {
+      unsigned long currMs = millis();
+
+      if (tasks[i].isDue(currMs)) {
+         tasks[i].run(currMs);
+      }
+   }
+   idle(millis());
+}
+
+/** Sleep until the nearest deadline of all the tasks. */
+void MyScheduler::idle(unsigned long currMs)
+{
+   unsigned long waitMs = MAX_SCHEDULER_IDLE;
+
+   for (int i = 0; i < taskCount; i++) {
+      if (tasks[i].isDue(currMs)) {
+         waitMs = 0;
+         break;
+      }
+      if (tasks[i].nextRunMs - currMs < waitMs) {
+         waitMs = tasks[i].nextRunMs - currMs;
+      }
+   }
+   if (waitMs > 0) {
+      delay(waitMs);
+      idleMs += waitMs;
+   } else {
+      yield();
+   }
+}
+
+/** Number of registered tasks. */
+int MyScheduler::count()
+{
+   return taskCount;
+}
+
+/** Returns the n'th task. */
+MyTask &MyScheduler::getAt(int idx)
+{
+   return tasks[idx];
+}
+
+/** Percentage of the time the scheduler was not idle. */
+double MyScheduler::getLoad()
+{
+   unsigned long totalMs = millis() - startMs;
+
+   if (totalMs == 0) {
+      return 0.0;
+   }
+   return 100.0 - (100.0 * idleMs / totalMs);
+}
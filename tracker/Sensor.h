@@ -0,0 +1,332 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Sensor.h
+  *
+  * Sensor registry with pluggable drivers and the common sample buffer.
+  */
+
+
+#define MAX_SENSORS       4     //!< Maximum number of registered sensor drivers.
+#define MAX_SAMPLES       12    //!< Maximum number of values in the sample buffer.
+#define SENSORS_IDLE_MS   1000  //!< Check interval of the disabled sensors.
+
+/**
+  * Physical quantity of one sample.
+  */
+enum MySampleType
+{
+   SAMPLE_TEMPERATURE, //!< Temperature in degrees Celsius.
+   SAMPLE_HUMIDITY,    //!< Relative humidity in %.
+   SAMPLE_PRESSURE,    //!< Air pressure in hPa.
+   SAMPLE_VOLTAGE,     //!< Voltage in V.
+   SAMPLE_CURRENT,     //!< Current in A (positive = charging).
+   SAMPLE_TYPES        //!< Number of sample types.
+};
+
+/**
+  * Name, unit and display precision of one sample type.
+  */
+class MySampleTypeInfo
+{
+public:
+   const char *name;     //!< Name in the mqtt topics and on the information page.
+   const char *unit;     //!< Unit (UTF-8).
+   int         decimals; //!< Decimals on the information page and in the sms.
+};
+
+/**
+  * One value of a sensor in the sample buffer.
+  */
+class MySample
+{
+public:
+   static const MySampleTypeInfo types[SAMPLE_TYPES]; //!< Name and unit of all the sample types.
+
+public:
+   const char   *sensor;  //!< Name of the sensor driver.
+   MySampleType  type;    //!< Physical quantity.
+   double        value;   //!< Last read value.
+   long          sec;     //!< Timestamp of the last read.
+   bool          isValid; //!< Was the last read of the sensor successful?
+
+public:
+   MySample();
+
+   const char *getName() const;
+   String      getText() const;
+};
+
+/**
+  * Buffer with the last values of all the sensors.
+  * The mqtt, web and sms layers enumerate it instead of knowing the sensors.
+  */
+class MySamples
+{
+protected:
+   MySample samples[MAX_SAMPLES]; //!< All the values in the order of the first read.
+   int      count;                //!< Number of used samples.
+
+protected:
+   int indexOf(const char *sensor, MySampleType type) const;
+
+public:
+   MySamples();
+
+   int             getCount() const;
+   const MySample &get(int index) const;
+   const MySample *find(const char *sensor, MySampleType type) const;
+   bool            getValue(const char *sensor, MySampleType type, double &value) const;
+
+   void set(const char *sensor, MySampleType type, double value);
+   void invalidate(const char *sensor);
+};
+
+/**
+  * Interface of one sensor driver.
+  * A sample is started, polled until the conversions are finished and then read.
+  * The driver never waits for a conversion, it returns the time until it is ready.
+  */
+class MySensor
+{
+public:
+   /** Name of the sensor (part of the mqtt topics). */
+   virtual const char *getName() = 0;
+   /** Sample interval in seconds (0 = the sensor is disabled). */
+   virtual long getIntervalSec() = 0;
+   /** Start a sample. Returns the time in ms until the first poll or -1 on errors. */
+   virtual long start() = 0;
+   /** Check or continue the conversions. Returns the time in ms until the next poll, 0 if the values are ready or -1 on errors. */
+   virtual long poll() = 0;
+   /** Read the finished sample into the buffer. */
+   virtual bool read(MySamples &samples) = 0;
+};
+
+/**
+  * Registry of all the sensor drivers.
+  * Every sensor runs its own start/poll/read cycle with its own interval,
+  * so the conversions of the different sensors overlap.
+  */
+class MySensors
+{
+protected:
+   MySamples     &samples;                   //!< Buffer of the read values.
+   MySensor      *sensors[MAX_SENSORS];      //!< Registered drivers.
+   unsigned long  nextMs[MAX_SENSORS];       //!< Time of the next step of every driver.
+   bool           isConverting[MAX_SENSORS]; //!< Is a sample of the driver running?
+   int            count;                     //!< Number of registered drivers.
+
+protected:
+   long step(int index);
+
+public:
+   MySensors(MySamples &samples);
+
+   bool add(MySensor &sensor);
+
+   long handleClient();
+};
+
+/* ******************************************** */
+
+const MySampleTypeInfo MySample::types[SAMPLE_TYPES] = {
+   // name           unit              decimals
+   { "temperature",  "\xC2\xB0" "C",   1 },
+   { "humidity",     "%",              1 },
+   { "pressure",     "hPa",            1 },
+   { "voltage",      "V",              2 },
+   { "current",      "A",              3 }
+};
+
+/** Constructor */
+MySample::MySample()
+   : sensor("")
+   , type(SAMPLE_VOLTAGE)
+   , value(0.0)
+   , sec(0)
+   , isValid(false)
+{
+}
+
+/** Name of the sample type. */
+const char *MySample::getName() const
+{
+   return types[type].name;
+}
+
+/** Value with the precision and the unit of its type. */
+String MySample::getText() const
+{
+   return String(value, types[type].decimals) + " " + types[type].unit;
+}
+
+/* ******************************************** */
+
+/** Constructor */
+MySamples::MySamples()
+   : count(0)
+{
+}
+
+/** Number of samples in the buffer. */
+int MySamples::getCount() const
+{
+   return count;
+}
+
+/** One sample of the buffer. */
+const MySample &MySamples::get(int index) const
+{
+   return samples[index];
+}
+
+/** Index of the sample of one sensor or -1. */
+int MySamples::indexOf(const char *sensor, MySampleType type) const
+{
+   for (int i = 0; i < count; i++) {
+      if (samples[i].type == type && strcmp(samples[i].sensor, sensor) == 0) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+/** Search the sample of one sensor. Returns NULL if the sensor has never delivered it. */
+const MySample *MySamples::find(const char *sensor, MySampleType type) const
+{
+   int index = indexOf(sensor, type);
+
+   return index >= 0 ? &samples[index] : NULL;
+}
+
+/** Returns the value of one sensor if it is valid. */
+bool MySamples::getValue(const char *sensor, MySampleType type, double &value) const
+{
+   const MySample *sample = find(sensor, type);
+
+   if (sample && sample->isValid) {
+      value = sample->value;
+      return true;
+   }
+   return false;
+}
+
+/** Store a new read value. The first value of a sensor and type adds a new sample. */
+void MySamples::set(const char *sensor, MySampleType type, double value)
+{
+   int index = indexOf(sensor, type);
+
+   if (index < 0) {
+      if (count >= MAX_SAMPLES) {
+         MyDbg("Too many samples: " + String(sensor));
+         return;
+      }
+      index = count++;
+      samples[index].sensor = sensor;
+      samples[index].type   = type;
+   }
+   samples[index].value   = value;
+   samples[index].sec     = millis() / 1000;
+   samples[index].isValid = true;
+}
+
+/** The sensor could not be read. Its last values are kept but marked as invalid. */
+void MySamples::invalidate(const char *sensor)
+{
+   for (int i = 0; i < count; i++) {
+      if (strcmp(samples[i].sensor, sensor) == 0) {
+         samples[i].isValid = false;
+      }
+   }
+}
+
+/* ******************************************** */
+
+/** Constructor */
+MySensors::MySensors(MySamples &samples)
+   : samples(samples)
+   , count(0)
+{
+}
+
+/** Register one driver. Its first sample is started on the next run. */
+bool MySensors::add(MySensor &sensor)
+{
+   if (count >= MAX_SENSORS) {
+      MyDbg("Too many sensors: " + String(sensor.getName()));
+      return false;
+   }
+   sensors     [count] = &sensor;
+   nextMs      [count] = millis();
+   isConverting[count] = false;
+   count++;
+   return true;
+}
+
+/**
+  * Start, poll or read one driver.
+  * Returns the time in ms until its next step.
+  */
+long MySensors::step(int index)
+{
+   MySensor *sensor     = sensors[index];
+   long      intervalMs = sensor->getIntervalSec() * 1000;
+   long      ms         = 0;
+
+   if (intervalMs <= 0) {
+      samples.invalidate(sensor->getName());
+      isConverting[index] = false;
+      return SENSORS_IDLE_MS;
+   }
+   if (!isConverting[index]) {
+      ms = sensor->start();
+      isConverting[index] = ms >= 0;
+   }
+   if (isConverting[index] && ms == 0) {
+      ms = sensor->poll();
+      if (ms == 0 && !sensor->read(samples)) {
+         ms = -1;
+      }
+   }
+   if (ms > 0) {
+      return ms;
+   }
+   if (ms < 0) {
+      MyDbg(String(sensor->getName()) + " read error");
+      samples.invalidate(sensor->getName());
+   }
+   isConverting[index] = false;
+   return intervalMs;
+}
+
+/**
+  * Run the due steps of all the drivers.
+  * Returns the time in ms until the next due step.
+  */
+long MySensors::handleClient()
+{
+   unsigned long currMs = millis();
+   long          waitMs = SENSORS_IDLE_MS;
+
+   for (int i = 0; i < count; i++) {
+      if ((long) (currMs - nextMs[i]) >= 0) {
+         nextMs[i] = currMs + step(i);
+      }
+      waitMs = min(waitMs, max(0L, (long) (nextMs[i] - currMs)));
+   }
+   return waitMs;
+}
@@ -20,8 +20,13 @@
   * Class to hook the serial communication and store the information in the console stringlist.
   */
 
+#define SERIAL_RX_BUFFER 256 //!< Receive buffer for more than 100ms of the nmea stream.
+
 /** 
   * Helper class to hook the SoftwareSerial calls to log the information for the console. 
+  * With a nmea parser the lines starting with '$' are given to the parser and 
+  * are not seen by the AT communication. The raw socket data after a +CIPRXGET: 2 
+  * header is never checked for nmea lines.
   */
 class MySerial : public SoftwareSerial
 {
@@ -32,10 +37,21 @@ protected:
    int         outIdx;       //!< How many bytes are read.
    StringList &logInfos;     //!< Hook pointer for the data logging.
    bool       &debug;        //!< Enable or disable the hooking.
+   MyNmeaParser *nmeaParser; //!< Parser of the nmea stream (NULL = no stream).
+   bool        isLineStart;  //!< Was the last received char a line end?
+   bool        isNmeaLine;   //!< Is the current line a nmea sentence?
+   long        rawCount;     //!< Outstanding bytes of a raw socket read.
+
+protected:
+   void encodeNmea(char c);
+   void checkRawHeader();
    
 public:
    MySerial(StringList &li, bool &d, uint8_t receivePin, uint8_t transmitPin, bool inverse_logic = false);
 
+   void setNmeaParser(MyNmeaParser *parser);
+   void readNmea();
+
    virtual int    read();
    virtual size_t write(uint8_t byte);
 };
@@ -44,29 +60,94 @@ public:
 
 /** Constructor */
 MySerial::MySerial(StringList &li, bool &d, uint8_t receivePin, uint8_t transmitPin, bool inverse_logic /*= false*/)
-   : SoftwareSerial(receivePin, transmitPin, inverse_logic)
+   : SoftwareSerial(receivePin, transmitPin, inverse_logic, SERIAL_RX_BUFFER)
    , inIdx(0)
    , outIdx(0)
    , logInfos(li)
    , debug(d)
+   , nmeaParser(NULL)
+   , isLineStart(true)
+   , isNmeaLine(false)
+   , rawCount(0)
+{
+}
+
+/** Set or remove (NULL) the parser of the nmea stream. */
+void MySerial::setNmeaParser(MyNmeaParser *parser)
+{
+   nmeaParser = parser;
+   isNmeaLine = false;
+}
+
+/** Give one char of a nmea line to the parser. */
+void MySerial::encodeNmea(char c)
 {
+   nmeaParser->encode(c);
+   isNmeaLine  = c != '\n';
+   isLineStart = c == '\n';
 }
 
-/** Virtual function call on read operations */
+/** Take over the data length of a +CIPRXGET: 2,<mux>,<len>,<rest> header line in inData. */
+void MySerial::checkRawHeader()
+{
+   const char *header = "+CIPRXGET: 2,";
+
+   if (strncmp(inData, header, strlen(header)) == 0) {
+      const char *len = strchr(inData + strlen(header), ',');
+
+      if (len) {
+         rawCount = atol(len + 1);
+      }
+   }
+}
+
+/** 
+  * Parse the received nmea lines until the next other data, 
+  * which is left in the buffer for the AT communication. 
+  */
+void MySerial::readNmea()
+{
+   while (nmeaParser && rawCount <= 0 && SoftwareSerial::available() > 0) {
+      int c = SoftwareSerial::peek();
+
+      if (!isNmeaLine && !(isLineStart && c == '$')) {
+         break;
+      }
+      encodeNmea((char) SoftwareSerial::read());
+   }
+}
+
+/** 
+  * Virtual function call on read operations. Nmea lines are given to the parser and skipped. 
+  * The bytes of a raw socket read are passed through unchanged and not logged.
+  */
 int MySerial::read()
 {
    int ret = SoftwareSerial::read();
 
+   if (ret >= 0 && rawCount > 0) {
+      rawCount--;
+      isLineStart = false;
+      return ret;
+   }
+
+   while (ret >= 0 && nmeaParser && (isNmeaLine || (isLineStart && ret == '$'))) {
+      encodeNmea((char) ret);
+      ret = SoftwareSerial::read();
+   }
+
    if (ret >= 0) {
       char c = (char) ret;
 
+      isLineStart = c == '\n';
       if (c != '\r' && c != '\n') {
          if (inIdx < 250) {
             inData[inIdx++] = c;
          }
-      } else {
+      } else if (c == '\n') {
+         inData[inIdx] = 0;
+         checkRawHeader();
          if (inIdx > 0 && debug) {
-            inData[inIdx] = 0;
             logInfos.addTail("< " + (String) inData);
          }
          inIdx = 0;
@@ -23,10 +23,13 @@
 
 #define TINY_GSM_MODEM_SIM808 //!< Defines the modul as a SIM808 type for the TinyGsmClient library 
 #define TINY_GSM_DEBUG Serial //!< ???
+#define TINY_GSM_TX_BUFFER 512 //!< Collects the mqtt packets of one sending into few +CIPSEND transactions.
 
 #include <TinyGsmClient.h>
 #include "Gps.h"
 
+#define EPO_DOWNLOAD_SEC 120 //!< Timeout of the ftp download of the EPO file.
+
 /** 
   * Helper class for storing one SMS data. 
   */
@@ -41,6 +44,24 @@ public:
    String message;          //!< Sms content.
 };
 
+/** 
+  * Helper class to identify one gsm cell. 
+  */
+class MyCell
+{
+public:
+   uint16_t mcc;    //!< Mobile country code.
+   uint16_t mnc;    //!< Mobile network code.
+   uint16_t lac;    //!< Location area code.
+   uint16_t cellId; //!< Cell id in the location area.
+
+public:
+   bool operator==(const MyCell &cell) const
+   {
+      return mcc == cell.mcc && mnc == cell.mnc && lac == cell.lac && cellId == cell.cellId;
+   }
+};
+
 /**
   * Extension class of the TinyGsmSim808 base class.
   * Implements the special gps call and some sms functions.
@@ -51,8 +72,16 @@ public:
    MyGsmSim808(Stream &stream);
 
    bool getGPS    (MyGps &gps);
-   bool getSMS    (SmsData &sms);
+   bool startEpoDownload(const String &server, const String &user, const String &password, const String &file);
+   bool checkEpoDownload(bool &isOk);
+   void stopEpoDownload ();
+   bool loadEpo   ();
+   bool sendGnssCmd(const String &sentence);
+   bool getServingCell(MyCell &cell);
+   int  listSMS   (bool isUnread, int skip, SmsData *list, int maxCount, int &total);
+   bool readSMS   (long index, SmsData &sms);
    bool deleteSMS (long index);
+   bool deleteReadSMS();
 };
 
 /* ******************************************** */
@@ -93,22 +122,165 @@ bool MyGsmSim808::getGPS(MyGps &gps)
    return gps.fixStatus;
 }
 
-/** Read one SMS from the sim card into the own SmsData class. */
-bool MyGsmSim808::getSMS(SmsData &sms)
+/** 
+  * Start the download of the EPO file of the A-GNSS via ftp into the file system of the sim808.
+  * Uses the bearer profile 1 which is opened with the gprs connection.
+  * The transfer runs in the sim808 and ends with a +FTPGETTOFS URC (see checkEpoDownload).
+  */
+bool MyGsmSim808::startEpoDownload(const String &server, const String &user, const String &password, const String &file)
 {
-   // PDU Mode (Hex)
-   sendAT(GF("+CMGF=1")); 
+   sendAT(GF("+FTPCID=1"));
    if (waitResponse() != 1) {
       return false;
    }
-   
-   // Read unread sms
-   sendAT(GF("+CMGL=\"REC UNREAD\""));
-   if (waitResponse(GF(GSM_NL "+CMGL:")) != 1) {
+   sendAT(GF("+FTPSERV=\""), server, '"');
+   waitResponse();
+   sendAT(GF("+FTPUN=\""), user, '"');
+   waitResponse();
+   sendAT(GF("+FTPPW=\""), password, '"');
+   waitResponse();
+   sendAT(GF("+FTPGETNAME=\""), file, '"');
+   waitResponse();
+   sendAT(GF("+FTPGETPATH=\"/\""));
+   waitResponse();
+   ftp_get_result = -1;
+   sendAT(GF("+FTPGETTOFS=0,\""), file, '"');
+   return waitResponse() == 1;
+}
+
+/** 
+  * Check for the end of a started EPO download without waiting.
+  * The +FTPGETTOFS: 0,<size> or +FTPGETTOFS: <error> URC is caught by every waitResponse.
+  * Returns true if the download is finished and sets isOk to its result.
+  */
+bool MyGsmSim808::checkEpoDownload(bool &isOk)
+{
+   long size;
+
+   maintain();
+   int result = getFtpGetResult(size);
+
+   if (result < 0) {
+      return false;
+   }
+   isOk = result == 0 && size > 0;
+   return true;
+}
+
+/** Close the ftp session of a failed or timed out EPO download. */
+void MyGsmSim808::stopEpoDownload()
+{
+   sendAT(GF("+FTPQUIT"));
+   waitResponse();
+}
+
+/** Check the downloaded EPO file and hand it over to the running gnss engine. */
+bool MyGsmSim808::loadEpo()
+{
+   sendAT(GF("+CGNSCHK=3,1"));
+   if (waitResponse(10000L) != 1) {
+      return false;
+   }
+   sendAT(GF("+CGNSAID=31,1,1"));
+   return waitResponse(10000L) == 1;
+}
+
+/** Send one PMTK sentence (without '$' and checksum) to the gnss engine. */
+bool MyGsmSim808::sendGnssCmd(const String &sentence)
+{
+   uint8_t checksum = 0;
+   char    hex[3];
+
+   for (unsigned int i = 0; i < sentence.length(); i++) {
+      checksum ^= sentence[i];
+   }
+   sprintf(hex, "%02X", checksum);
+   sendAT(GF("+CGNSCMD=0,\"$"), sentence, '*', hex, '"');
+   return waitResponse() == 1;
+}
+
+/** 
+  * Read the identification of the serving cell from the engineering mode (+CENG).
+  * +CENG: 0,"<arfcn>,<rxl>,<rxq>,<mcc>,<mnc>,<bsic>,<cellid>,<rla>,<txp>,<lac>,<TA>"
+  */
+bool MyGsmSim808::getServingCell(MyCell &cell)
+{
+   sendAT(GF("+CENG=1,0"));
+   if (waitResponse() != 1) {
+      return false;
+   }
+   sendAT(GF("+CENG?"));
+   if (waitResponse(GF("+CENG: 0,\"")) != 1) {
+      return false;
+   }
+
+   String serving = stream.readStringUntil('"');
+   String terms[11];
+   int    count = 0;
+
+   waitResponse();
+   for (int start = 0; count < 11; count++) {
+      int end = serving.indexOf(',', start);
+
+      terms[count] = serving.substring(start, end < 0 ? serving.length() : end);
+      if (end < 0) {
+         count++;
+         break;
+      }
+      start = end + 1;
+   }
+   if (count < 10) {
       return false;
    }
+   cell.mcc    = terms[3].toInt();
+   cell.mnc    = terms[4].toInt();
+   cell.cellId = strtoul(terms[6].c_str(), NULL, 16);
+   cell.lac    = strtoul(terms[9].c_str(), NULL, 16);
+   return cell.mcc != 0 && cell.cellId != 0;
+}
+
+/** 
+  * Read the unread (or read) received SMS with one +CMGL listing into the list. 
+  * Stored (sent/unsent) sms are not listed. The listing marks the unread sms as 
+  * read, so they can be deleted together with deleteReadSMS(). The first skip 
+  * entries and the entries behind maxCount are only counted in total.
+  * The text mode is set once with setNewSmsIndication().
+  */
+int MyGsmSim808::listSMS(bool isUnread, int skip, SmsData *list, int maxCount, int &total)
+{
+   int count = 0;
+
+   total = 0;
+   sendAT(GF("+CMGL=\""), isUnread ? GF("REC UNREAD") : GF("REC READ"), '"');
+   while (waitResponse(GF("+CMGL:"), GFP(GSM_OK), GFP(GSM_ERROR)) == 1) {
+      if (total++ < skip || count >= maxCount) {
+         stream.readStringUntil('\n');
+         stream.readStringUntil('\n');
+         continue;
+      }
+
+      SmsData &sms = list[count++];
+
+      sms.index           = atoi(stream.readStringUntil(',').c_str());
+      sms.status          = stream.readStringUntil(',');
+      sms.phoneNumber     = stream.readStringUntil(',');
+      sms.referenceNumber = stream.readStringUntil(',');
+      sms.dateTime        = stream.readStringUntil('\n');
+      sms.message         = stream.readStringUntil('\n');
+      sms.message         = Trim(sms.message, "\r\n");
+   }
+   return count;
+}
 
-   sms.index           = atoi(stream.readStringUntil(',').c_str());
+/** Read the SMS with the index from a +CMTI indication into the own SmsData class. */
+bool MyGsmSim808::readSMS(long index, SmsData &sms)
+{
+   sendAT(GF("+CMGR=") + String(index));
+   if (waitResponse(GF(GSM_NL "+CMGR:"), GFP(GSM_OK), GFP(GSM_ERROR)) != 1) {
+      return false;
+   }
+
+   sms.index           = index;
    sms.status          = stream.readStringUntil(',');
    sms.phoneNumber     = stream.readStringUntil(',');
    sms.referenceNumber = stream.readStringUntil(',');
@@ -116,7 +288,7 @@ bool MyGsmSim808::getSMS(SmsData &sms)
    sms.message         = stream.readStringUntil('\n');
    sms.message         = Trim(sms.message, "\r\n");
    waitResponse(); 
-       
+
    return true;
 }
 
@@ -130,3 +302,15 @@ bool MyGsmSim808::deleteSMS(long index)
 
    return true; 
 }
+
+/** Delete all read sms from the sim card with one command. */
+bool MyGsmSim808::deleteReadSMS()
+{
+   sendAT(GF("+CMGDA=\"DEL READ\""));
+   if (waitResponse() == 1) {
+      return true;
+   }
+   // Fallback: delete flag 1 = all read messages
+   sendAT(GF("+CMGD=1,1"));
+   return waitResponse() == 1;
+}
@@ -20,35 +20,110 @@
   * Implementation of SMS interaction to the Modul.
   */
 
+#define MAX_SMS_BATCH         8    //!< Maximum number of sms processed with one listing.
+#define MAX_SMS_ARGS          4    //!< Maximum number of ':' separated tokens (command + arguments).
+#define MAX_SMS_REPLIES       4    //!< Number of remembered replies for the deduplication.
+#define SMS_REPLY_DEDUP_SEC   600  //!< The same reply is not sent again within this time.
+#define SMS_REPLY_WINDOW_SEC  3600 //!< Time window of the reply rate limit.
+#define SMS_REPLY_MAX         10   //!< Maximum number of replies in the time window.
+#define SMS_PHONE_DIGITS      9    //!< Number of trailing digits to compare phone numbers (+49.. / 0049.. / 0..).
+
+/**
+  * Zero allocation tokenizer for sms commands like 'mqtt:30:60'.
+  * The tokens point into the message and are not terminated.
+  */
+class MySmsArgs
+{
+public:
+   const char *token[MAX_SMS_ARGS];  //!< Start of every token (token 0 is the command).
+   int         len[MAX_SMS_ARGS];    //!< Length of every token.
+   int         count;                //!< Number of tokens.
+   bool        isOverflow;           //!< More tokens than MAX_SMS_ARGS.
+   const char *messageEnd;           //!< End of the message (without trailing blanks).
+
+public:
+   MySmsArgs(const char *message);
+
+   bool   is(int idx, const char *name) const;
+   bool   isLong(int idx) const;
+   long   getLong(int idx) const;
+   String getString(int idx) const;
+   String getRest(int idx) const;
+};
+
+/**
+  * One option which can be changed with the set command.
+  */
+class MySmsSetEntry
+{
+public:
+   const char   *key;           //!< Option key like in the option file.
+   char          type;          //!< Value type: 'l' long, 'd' double, 's' string.
+   long          minValue;      //!< Minimum value of the numbers.
+};
+
+class MySmsCmd;
+
+typedef void (MySmsCmd::*MySmsCmdFunc)(const SmsData &sms, const MySmsArgs &args); //!< Command handler.
+
+/**
+  * One entry of the command table.
+  */
+class MySmsCmdEntry
+{
+public:
+   const char   *name;          //!< Command name (case insensitive).
+   const char   *schema;        //!< Argument types: 'l' long, 's' string (a last 's' takes the rest with ':').
+   int           minArgs;       //!< Number of required arguments.
+   long          minValue;      //!< Minimum value of the long arguments.
+   MySmsCmdFunc  func;          //!< Handler function.
+   const char   *help;          //!< Help text for the command list.
+};
+
 /**
   * SMS Controller class to manage receiving SMS commands.
+  * The commands are dispatched via a table with argument checking and
+  * sender authorization. The replies are deduplicated and rate limited.
   */
 class MySmsCmd
 {
+public:
+   static const MySmsCmdEntry commands[]; //!< The command table.
+   static const MySmsSetEntry options[];  //!< The options of the set command.
+
 protected:
-   MyGsmGps  &myGsmGps;       //!< Reference to the gsm/gps instance.
-   MyOptions &myOptions;      //!< Reference to the options.
-   MyData    &myData;         //!< Reference to the data.
-   long      smsLastCheckSec; //!< Timestamps of the last sms check.
+   MyGsmGps     &myGsmGps;                      //!< Reference to the gsm/gps instance.
+   MyOptions    &myOptions;                     //!< Reference to the options.
+   MyData       &myData;                        //!< Reference to the data.
+
+   unsigned long replyHash[MAX_SMS_REPLIES];    //!< Hashes of the last replies.
+   long          replySec[MAX_SMS_REPLIES];     //!< Send time of the last replies.
+   int           replyNext;                     //!< Next slot in the reply history.
+   long          replyWindowSec;                //!< Start of the rate limit window.
+   int           replyCount;                    //!< Number of replies in the window.
 
 protected:   
    void checkSms();   
+   void checkNewSms();
+   void processSms (const SmsData &sms);
+
+   bool isAuthorized(const SmsData &sms);
+   bool isValid    (const MySmsCmdEntry &cmd, const MySmsArgs &args);
+   bool isValid    (const MySmsSetEntry &option, const MySmsArgs &args);
+   bool canReply   (const String &message);
 
    void sendSms    (const String &message);
    void sendOk     (const SmsData &sms);
-
-   bool readValues (String &value, const String message);
-   bool readValues (long   &value, const String message);
-   bool readValues (long   &value, long &value2, const String message);
    
-   void cmdOn      (const SmsData &sms);
-   void cmdOff     (const SmsData &sms);
-   void cmdStatus  (const SmsData &sms);
-   void cmdGps     (const SmsData &sms);
-   void cmdSms     (const SmsData &sms);
-   void cmdMqtt    (const SmsData &sms);
-   void cmdPhone   (const SmsData &sms);
-   void cmdDefault (const SmsData &sms);
+   void cmdOn      (const SmsData &sms, const MySmsArgs &args);
+   void cmdOff     (const SmsData &sms, const MySmsArgs &args);
+   void cmdStatus  (const SmsData &sms, const MySmsArgs &args);
+   void cmdGps     (const SmsData &sms, const MySmsArgs &args);
+   void cmdSms     (const SmsData &sms, const MySmsArgs &args);
+   void cmdMqtt    (const SmsData &sms, const MySmsArgs &args);
+   void cmdPhone   (const SmsData &sms, const MySmsArgs &args);
+   void cmdSet     (const SmsData &sms, const MySmsArgs &args);
+   void cmdHelp    (const SmsData &sms, const MySmsArgs &args);
       
 public:
    MySmsCmd(MyGsmGps &gsmGps, MyOptions &options, MyData &data);
@@ -59,13 +134,172 @@ public:
 
 /* ******************************************** */
 
+/** Split the message at the ':' characters and trim the blanks of every token. */
+MySmsArgs::MySmsArgs(const char *message)
+   : count(0)
+   , isOverflow(false)
+   , messageEnd(message + strlen(message))
+{
+   const char *p = message;
+
+   while (messageEnd > message && isspace(*(messageEnd - 1))) {
+      messageEnd--;
+   }
+
+   while (*p) {
+      const char *end = strchr(p, ':');
+      const char *last;
+
+      if (!end) {
+         end = p + strlen(p);
+      }
+      last = end;
+      while (p < last && isspace(*p)) {
+         p++;
+      }
+      while (last > p && isspace(*(last - 1))) {
+         last--;
+      }
+      if (count >= MAX_SMS_ARGS) {
+         isOverflow = true;
+         break;
+      }
+      token[count] = p;
+      len[count]   = last - p;
+      count++;
+      p = *end ? end + 1 : end;
+   }
+}
+
+/** Is the token equal to the name (case insensitive)? */
+bool MySmsArgs::is(int idx, const char *name) const
+{
+   return idx < count && strlen(name) == (size_t) len[idx] && strncasecmp(token[idx], name, len[idx]) == 0;
+}
+
+/** Is the token a positive number (digits only)? */
+bool MySmsArgs::isLong(int idx) const
+{
+   if (idx >= count || len[idx] == 0 || len[idx] > 9) {
+      return false;
+   }
+   for (int i = 0; i < len[idx]; i++) {
+      if (!isdigit(token[idx][i])) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/** Numeric value of the token. */
+long MySmsArgs::getLong(int idx) const
+{
+   return idx < count ? atol(token[idx]) : 0;
+}
+
+/** Copy of the token. */
+String MySmsArgs::getString(int idx) const
+{
+   String ret;
+
+   if (idx < count) {
+      ret.reserve(len[idx]);
+      for (int i = 0; i < len[idx]; i++) {
+         ret += token[idx][i];
+      }
+   }
+   return ret;
+}
+
+/** The rest of the message from the token on, including the ':' characters. */
+String MySmsArgs::getRest(int idx) const
+{
+   String ret;
+
+   if (idx < count) {
+      ret.reserve(messageEnd - token[idx]);
+      for (const char *p = token[idx]; p < messageEnd; p++) {
+         ret += *p;
+      }
+   }
+   return ret;
+}
+
+const MySmsCmdEntry MySmsCmd::commands[] = {
+   // name      schema minArgs minValue handler               help
+   { "on",      "",    0,      0,       &MySmsCmd::cmdOn,     "on" },
+   { "off",     "",    0,      0,       &MySmsCmd::cmdOff,    "off" },
+   { "status",  "",    0,      0,       &MySmsCmd::cmdStatus, "status" },
+   { "gps",     "l",   0,      5,       &MySmsCmd::cmdGps,    "gps[:15] - check every (sec >= 5)" },
+   { "sms",     "l",   1,      10,      &MySmsCmd::cmdSms,    "sms:300 - sweep every (sec >= 10)" },
+   { "mqtt",    "ll",  2,      10,      &MySmsCmd::cmdMqtt,   "mqtt:30:60 - moving:standing (sec >= 10)" },
+   { "phone",   "s",   1,      0,       &MySmsCmd::cmdPhone,  "phone:1234" },
+   { "set",     "ss",  2,      0,       &MySmsCmd::cmdSet,    "set:option:value" },
+   { "help",    "",    0,      0,       &MySmsCmd::cmdHelp,   "help" },
+   { NULL,      NULL,  0,      0,       NULL,                 NULL }
+};
+
+const MySmsSetEntry MySmsCmd::options[] = {
+   // key                         type minValue
+   { "gprsAP",                    's', 0 },
+   { "wlanAP",                    's', 0 },
+   { "wlanPassword",              's', 0 },
+   { "bme280CheckIntervalSec",    'l', 1 },
+   { "isDs2438Enabled",           'l', 0 },
+   { "ds2438CheckIntervalSec",    'l', 1 },
+   { "gsmPower",                  'l', 0 },
+   { "isGsmEnabled",              'l', 0 },
+   { "isModemSleepEnabled",       'l', 0 },
+   { "isGpsEnabled",              'l', 0 },
+   { "gpsCheckIntervalSec",       'l', 5 },
+   { "isGpsStreamEnabled",        'l', 0 },
+   { "cellLocAfterSec",           'l', 0 },
+   { "cellLocMaxPerHour",         'l', 0 },
+   { "isAgpsEnabled",             'l', 0 },
+   { "agpsServer",                's', 0 },
+   { "agpsUser",                  's', 0 },
+   { "agpsPassword",              's', 0 },
+   { "agpsFile",                  's', 0 },
+   { "agpsValidHours",            'l', 1 },
+   { "minMovingDistance",         'l', 0 },
+   { "motionSpeedKmph",           'd', 0 },
+   { "motionStopSec",             'l', 0 },
+   { "smsCheckIntervalSec",       'l', 10 },
+   { "isDeepSleepEnabled",        'l', 0 },
+   { "powerSaveModeVoltage",      'd', 0 },
+   { "chargingVoltage",           'd', 0 },
+   { "criticalVoltage",           'd', 0 },
+   { "powerCheckIntervalSec",     'l', 1 },
+   { "wakeTimeSec",               'l', 1 },
+   { "deepSleepTimeSec",          'l', 1 },
+   { "isMqttEnabled",             'l', 0 },
+   { "isMqttSnEnabled",           'l', 0 },
+   { "mqttServer",                's', 0 },
+   { "mqttPort",                  'l', 1 },
+   { "mqttSnPort",                'l', 1 },
+   { "mqttUser",                  's', 0 },
+   { "mqttPassword",              's', 0 },
+   { "mqttReconnectIntervalSec",  'l', 10 },
+   { "mqttSendOnMoveEverySec",    'l', 10 },
+   { "mqttSendOnNonMoveEverySec", 'l', 10 },
+   { "mqttKeepAliveSec",          'l', 10 },
+   { "mqttHeartbeatSec",          'l', 0 },
+   { NULL,                        0,   0 }
+};
+
 /** Constructor */
 MySmsCmd::MySmsCmd(MyGsmGps &gsmGps, MyOptions &options, MyData &data)
    : myGsmGps(gsmGps)
    , myOptions(options)
    , myData(data)
-   , smsLastCheckSec(0)
+   , replyNext(0)
+   , replyWindowSec(0)
+   , replyCount(0)
 {
+   for (int i = 0; i < MAX_SMS_REPLIES; i++) {
+      replyHash[i] = 0;
+      replySec[i]  = 0;
+   }
 }
 
 /** Log only the start of the sms controller */
@@ -75,109 +309,234 @@ bool MySmsCmd::begin()
    return true;
 }
 
-/** Check the sms if the time from the options is elapsed. */
+/** 
+  * Called by the scheduler every smsCheckIntervalSec or immediately on a +CMTI indication.
+  * Indicated sms are read by index, otherwise the sim card is swept for missed ones.
+  */
 void MySmsCmd::handleClient()
 {
-   long currSec = millis() / 1000;
-
-   if (currSec - smsLastCheckSec > myOptions.smsCheckIntervalSec) {
-      smsLastCheckSec = currSec;
+   if (!myGsmGps.isGsmActive) {
+      return;
+   }
+   if (myGsmGps.hasNewSms()) {
+      checkNewSms();
+   } else {
       checkSms();
    }
 }
 
-/** Checks for new sms and parse the commands from the message */
-void MySmsCmd::checkSms()
+/** 
+  * Reads only the sms with the indicated indices. 
+  * They are deleted together before the commands are processed.
+  */
+void MySmsCmd::checkNewSms()
 {
-   if (!myGsmGps.isGsmActive) {
-      return;
+   SmsData list[MAX_SMS_BATCH];
+   int     count = 0;
+   long    index;
+
+   while (count < MAX_SMS_BATCH && (index = myGsmGps.getNewSmsIndex()) >= 0) {
+      if (myGsmGps.readSMS(index, list[count])) {
+         count++;
+      }
    }
-   
-   SmsData sms;
+   if (count > 0) {
+      myGsmGps.deleteReadSMS();
+   }
+   for (int i = 0; i < count; i++) {
+      processSms(list[i]);
+   }
+}
+
+/** 
+  * Sweeps the sim card for missed unread sms with one listing, which marks them as read. 
+  * Entries behind MAX_SMS_BATCH are fetched from the read ones behind the processed.
+  * The processed sms are deleted with one command at the end. Sms received 
+  * in the meantime stay unread for the next sweep.
+  */
+void MySmsCmd::checkSms()
+{
+   SmsData list[MAX_SMS_BATCH];
+   int     total = 0;
+   int     done  = 0;
+   int     count = 0;
 
    MyDbg("checkSMS");
-   while (myGsmGps.getSMS(sms)) {
-      String messageLower = sms.message;
-
-      messageLower.toLowerCase();
-      myGsmGps.deleteSMS(sms.index);
-
-      MyDbg("SMS: " + sms.message + " ["+ sms.phoneNumber + "]");
-      if (messageLower == "on") {
-         cmdOn(sms);
-      } else if (messageLower == "off") {
-         cmdOff(sms);
-      } else if (messageLower == "status") {
-         cmdStatus(sms);
-      } else if (messageLower == "gps") {
-         cmdGps(sms);
-      } else if (messageLower == "sms") {
-         cmdSms(sms);
-      } else if (messageLower == "mqtt") {
-         cmdMqtt(sms);
-      } else if (messageLower == "phone") {
-         cmdPhone(sms);
-      } else {
-         cmdDefault(sms);
+   count = myGsmGps.listSMS(true, 0, list, MAX_SMS_BATCH, total);
+   while (count > 0) {
+      for (int i = 0; i < count; i++) {
+         processSms(list[i]);
+      }
+      done += count;
+      if (total <= done) {
+         break;
       }
+      count = myGsmGps.listSMS(false, done, list, MAX_SMS_BATCH, total);
+   }
+   if (done > 0) {
+      myGsmGps.deleteReadSMS();
    }
 }
 
-/** Helper function to send one sms */
-void MySmsCmd::sendSms(const String &message)
+/** 
+  * Look up the command in the table, check the sender and the arguments and call the handler. 
+  * Unknown commands are only answered with the help to the configured phone number.
+  */
+void MySmsCmd::processSms(const SmsData &sms)
 {
-   myGsmGps.sendSMS(myOptions.phoneNumber, message);
+   MySmsArgs args(sms.message.c_str());
+   bool      isAuth = isAuthorized(sms);
+
+   MyDbg("SMS: " + sms.message + " ["+ sms.phoneNumber + "]");
+   for (int i = 0; commands[i].name; i++) {
+      const MySmsCmdEntry &cmd = commands[i];
+
+      if (args.is(0, cmd.name)) {
+         if (!isAuth) {
+            MyDbg("SMS sender not allowed: " + sms.phoneNumber);
+         } else if (!isValid(cmd, args)) {
+            cmdHelp(sms, args);
+         } else {
+            (this->*cmd.func)(sms, args);
+         }
+         return;
+      }
+   }
+   if (isAuth) {
+      cmdHelp(sms, args);
+   }
 }
 
-/** Send an OK sms */
-void MySmsCmd::sendOk(const SmsData &sms)
+/** Compare the trailing digits of the sender with the configured phone number. */
+bool MySmsCmd::isAuthorized(const SmsData &sms)
 {
-   sendSms(sms.message + " -> OK");
+   const char *sender = sms.phoneNumber.c_str();
+   const char *phone  = myOptions.phoneNumber.c_str();
+   int         i      = strlen(sender);
+   int         j      = strlen(phone);
+   int         digits = 0;
+
+   while (digits < SMS_PHONE_DIGITS) {
+      while (i > 0 && !isdigit(sender[i - 1])) {
+         i--;
+      }
+      while (j > 0 && !isdigit(phone[j - 1])) {
+         j--;
+      }
+      if (i == 0 || j == 0) {
+         return digits > 0 && i == 0 && j == 0;
+      }
+      if (sender[--i] != phone[--j]) {
+         return false;
+      }
+      digits++;
+   }
+   return true;
 }
 
-/** Parse a sub string parameter from a sms message (xxx:sub) */
-bool MySmsCmd::readValues(String &value, const String message)
+/** 
+  * Check the number, the types and the minimum values of the arguments with the schema of the command.
+  * A last string argument takes the rest of the message, so it may contain ':'.
+  */
+bool MySmsCmd::isValid(const MySmsCmdEntry &cmd, const MySmsArgs &args)
 {
-   int idx = message.indexOf(':');
+   int  maxArgs = strlen(cmd.schema);
+   int  numArgs = args.count - 1;
+   bool isRest  = maxArgs > 0 && cmd.schema[maxArgs - 1] == 's';
 
-   if (idx != -1) {
-      value = message.substring(idx + 1);
-      return true;
+   if (numArgs < cmd.minArgs || ((args.isOverflow || numArgs > maxArgs) && !isRest)) {
+      return false;
    }
-   return false;
+   for (int i = 0; i < numArgs && i < maxArgs; i++) {
+      if (cmd.schema[i] == 'l' && (!args.isLong(i + 1) || args.getLong(i + 1) < cmd.minValue)) {
+         return false;
+      }
+   }
+   return true;
 }
 
-/** Parse a sub long parameter from a sms message (xxx:sub) */
-bool MySmsCmd::readValues(long &value, const String message)
+/** 
+  * Check the value of the set command with the type and the minimum value of the option.
+  * Numbers are one token of digits (with one '.' for doubles), strings take the rest of the message.
+  */
+bool MySmsCmd::isValid(const MySmsSetEntry &option, const MySmsArgs &args)
 {
-   int idx = message.indexOf(':');
-
-   if (idx != -1) {
-      value = atoi(message.substring(idx + 1).c_str());
+   if (option.type == 's') {
       return true;
    }
-   return false;
+   if (args.count != 3 || args.isOverflow) {
+      return false;
+   }
+   if (option.type == 'l') {
+      return args.isLong(2) && args.getLong(2) >= option.minValue;
+   }
+
+   String value  = args.getString(2);
+   int    digits = 0;
+   int    dots   = 0;
+
+   for (unsigned int i = 0; i < value.length(); i++) {
+      if (isdigit(value[i])) {
+         digits++;
+      } else if (value[i] == '.') {
+         dots++;
+      } else {
+         return false;
+      }
+   }
+   return digits > 0 && digits <= 9 && dots <= 1 && atof(value.c_str()) >= option.minValue;
 }
 
-/** Parse two sub long parameter from a sms message (xxx:sub1:sub2) */
-bool MySmsCmd::readValues(long &value1, long &value2, const String message)
+/** 
+  * Reply deduplication and rate limit to control the sms costs.
+  * The same message is not sent again within SMS_REPLY_DEDUP_SEC and
+  * at most SMS_REPLY_MAX messages are sent within SMS_REPLY_WINDOW_SEC.
+  */
+bool MySmsCmd::canReply(const String &message)
 {
-   int first = message.indexOf(':');
+   long          currSec = millis() / 1000;
+   unsigned long hash    = 5381;
 
-   if (first != -1) {
-      int second = message.indexOf(':', first + 1);
-
-      if (second != -1) {
-         value1 = atoi(message.substring(first + 1, second).c_str());
-         value2 = atoi(message.substring(second + 1).c_str());
-         return true;
+   for (unsigned int i = 0; i < message.length(); i++) {
+      hash = hash * 33 + message[i];
+   }
+   for (int i = 0; i < MAX_SMS_REPLIES; i++) {
+      if (replyHash[i] == hash && replySec[i] != 0 && currSec - replySec[i] < SMS_REPLY_DEDUP_SEC) {
+         MyDbg("SMS reply suppressed (duplicate)");
+         return false;
       }
    }
-   return false;
+   if (replyCount == 0 || currSec - replyWindowSec >= SMS_REPLY_WINDOW_SEC) {
+      replyWindowSec = currSec;
+      replyCount     = 0;
+   }
+   if (replyCount >= SMS_REPLY_MAX) {
+      MyDbg("SMS reply suppressed (rate limit)");
+      return false;
+   }
+   replyCount++;
+   replyHash[replyNext] = hash;
+   replySec[replyNext]  = currSec > 0 ? currSec : 1;
+   replyNext = (replyNext + 1) % MAX_SMS_REPLIES;
+   return true;
+}
+
+/** Helper function to send one sms if the rate limit allows it. */
+void MySmsCmd::sendSms(const String &message)
+{
+   if (canReply(message)) {
+      myGsmGps.sendSMS(myOptions.phoneNumber, message);
+   }
+}
+
+/** Send an OK sms */
+void MySmsCmd::sendOk(const SmsData &sms)
+{
+   sendSms(sms.message + " -> OK");
 }
 
 /** Command: switch on the modules */
-void MySmsCmd::cmdOn(const SmsData &sms)
+void MySmsCmd::cmdOn(const SmsData &sms, const MySmsArgs &args)
 {
    myOptions.gsmPower     = true;
    myOptions.isGsmEnabled = true;
@@ -186,88 +545,103 @@ void MySmsCmd::cmdOn(const SmsData &sms)
 }
 
 /** Command: switch off the modules */
-void MySmsCmd::cmdOff(const SmsData &sms)
+void MySmsCmd::cmdOff(const SmsData &sms, const MySmsArgs &args)
 {
    myOptions.gsmPower = false;
    sendOk(sms);
 }
 
 /** Command: send status information via sms */
-void MySmsCmd::cmdStatus(const SmsData &sms)
+void MySmsCmd::cmdStatus(const SmsData &sms, const MySmsArgs &args)
 {
    String status;
 
    status += "Status:"       + myData.status              + '\n';
    status += "Voltage:"      + String(myData.voltage, 1)  + "V\n";
-   status += "Temperature: " + String(myData.temperature) + "C\n";
-   status += "Humidity: "    + String(myData.humidity)    + "%\n";
-   status += "Pressure: "    + String(myData.pressure)    + "hPa\n";
+   for (int i = 0; i < myData.samples.getCount(); i++) {
+      const MySample &sample = myData.samples.get(i);
+
+      if (sample.isValid) {
+         status += String(sample.sensor) + " " + sample.getName() + ": " + sample.getText() + '\n';
+      }
+   }
    status += "Modem Info:"   + myData.modemInfo           + '\n';
    status += "Longitude:"    + myData.longitude           + '\n';
    status += "Latitude:"     + myData.latitude            + '\n';
    status += "Altitude:"     + myData.altitude            + '\n';
+   status += "Source:"       + myData.positionSource      + '\n';
    status += "Satellites:"   + myData.satellites          + '\n';
    sendSms(status);
 }
 
-/** Command: send the gps position as an google map URL. */
-void MySmsCmd::cmdGps(const SmsData &sms)
+/** Command: send the gps position as an google map URL or set the gps checking time. */
+void MySmsCmd::cmdGps(const SmsData &sms, const MySmsArgs &args)
 {
-   if (sms.message.indexOf(":") == -1) {
+   if (args.count == 1) {
       sendSms(
          "http://maps.google.com/maps?q=" + 
          myData.latitude + "," + myData.longitude);
    } else {
-      if (readValues(myOptions.gpsCheckIntervalSec, sms.message)) {
-         sendOk(sms);
-      } else {
-         cmdDefault(sms);
-      }
+      myOptions.gpsCheckIntervalSec = args.getLong(1);
+      sendOk(sms);
    }
 }
 
-/** Command: Set the sms checking time. */
-void MySmsCmd::cmdSms(const SmsData &sms)
+/** Command: Set the sms sweep time. */
+void MySmsCmd::cmdSms(const SmsData &sms, const MySmsArgs &args)
 {
-   if (readValues(myOptions.smsCheckIntervalSec, sms.message)) {
-      sendOk(sms);
-   } else {
-      cmdDefault(sms);
-   }
+   myOptions.smsCheckIntervalSec = args.getLong(1);
+   sendOk(sms);
 }
 
-/** Command: Set the mqtt sending time checking time values. */
-void MySmsCmd::cmdMqtt(const SmsData &sms)
+/** Command: Set the mqtt sending time values. */
+void MySmsCmd::cmdMqtt(const SmsData &sms, const MySmsArgs &args)
 {
-   if (readValues(myOptions.mqttSendOnMoveEverySec, myOptions.mqttSendOnNonMoveEverySec, sms.message)) {
-      sendOk(sms);
-   } else {
-      cmdDefault(sms);
-   }
+   myOptions.mqttSendOnMoveEverySec    = args.getLong(1);
+   myOptions.mqttSendOnNonMoveEverySec = args.getLong(2);
+   sendOk(sms);
 }
 
 /** Command: Set the receiving phone number. */
-void MySmsCmd::cmdPhone(const SmsData &sms)
+void MySmsCmd::cmdPhone(const SmsData &sms, const MySmsArgs &args)
 {
-   if (readValues(myOptions.phoneNumber, sms.message)) {
-      sendOk(sms);
-   } else {
-      cmdDefault(sms);
+   myOptions.phoneNumber = args.getRest(1);
+   sendOk(sms);
+}
+
+/** 
+  * Command: Set one option of the option table like in the option file and save the options. 
+  * The reply contains only the key, so passwords are not sent back.
+  */
+void MySmsCmd::cmdSet(const SmsData &sms, const MySmsArgs &args)
+{
+   for (int i = 0; options[i].key; i++) {
+      const MySmsSetEntry &option = options[i];
+
+      if (args.is(1, option.key)) {
+         if (!isValid(option, args)) {
+            sendSms(String(option.key) + " -> wrong value");
+         } else if (myOptions.setValue(option.key, args.getRest(2))) {
+            myOptions.save();
+            sendSms(String(option.key) + " -> OK");
+         }
+         return;
+      }
    }
+   sendSms(args.getString(1) + " -> unknown option");
 }
 
-/** Default sms response if anything is wrong */
-void MySmsCmd::cmdDefault(const SmsData &sms)
+/** Help sms response on request or if anything is wrong */
+void MySmsCmd::cmdHelp(const SmsData &sms, const MySmsArgs &args)
 {
    String info;
 
-   info += "wrong command\n";
-   info += "on\n";
-   info += "off\n";
-   info += "status\n";
-   info += "gps[:15] - check every (sec)\n";
-   info += "sms[:15] - check every (sec)\n";
-   info += "mqtt[30:60] - (moving:standing (sec)\n";
-   info += "phone:1234\n";
+   if (!args.is(0, "help")) {
+      info += "wrong command\n";
+   }
+   for (int i = 0; commands[i].name; i++) {
+      info += commands[i].help;
+      info += '\n';
+   }
    sendSms(info);
 }
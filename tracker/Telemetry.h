@@ -0,0 +1,281 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Telemetry.h
+  *
+  * Binary delta encoding of the reports with periodic keyframes.
+  * The file has no Arduino dependencies, so the decoder can be compiled on the server too.
+  *
+  * Frame layout:
+  *   byte 0:   TELEMETRY_KEYFRAME or TELEMETRY_DELTA
+  *   byte 1:   sequence number of the frame
+  *   byte 2:   sequence number of the reference frame (only in delta frames)
+  *   byte 3..: all the fields as zigzag varints (absolute values or differences to the reference)
+  */
+
+#include <stdint.h>
+#include <string.h>
+
+#define TELEMETRY_KEYFRAME    0x4B   //!< Frame type with absolute values ('K').
+#define TELEMETRY_DELTA       0x44   //!< Frame type with differences to the reference frame ('D').
+#define TELEMETRY_HISTORY     8      //!< Decoded frames the decoder keeps as possible references.
+#define TELEMETRY_MAX_VARINT  5      //!< Maximum bytes of one 32 bit varint.
+
+/**
+  * Fields of one report and their fixed point scaling.
+  */
+enum MyTelemetryField
+{
+   TELEMETRY_LATITUDE,    //!< Latitude in 1/100000 degrees.
+   TELEMETRY_LONGITUDE,   //!< Longitude in 1/100000 degrees.
+   TELEMETRY_ALTITUDE,    //!< Altitude in m.
+   TELEMETRY_KMPH,        //!< Speed in 1/10 km/h.
+   TELEMETRY_VOLTAGE,     //!< Supply voltage in 1/100 V.
+   TELEMETRY_TEMPERATURE, //!< Temperature in 1/10 degrees Celsius.
+   TELEMETRY_HUMIDITY,    //!< Humidity in 1/10 %.
+   TELEMETRY_PRESSURE,    //!< Pressure in 1/10 hPa.
+   TELEMETRY_CSQ,         //!< Signal quality of the sim808.
+   TELEMETRY_FIELDS       //!< Number of fields.
+};
+
+#define TELEMETRY_MAX_FRAME   (3 + TELEMETRY_FIELDS * TELEMETRY_MAX_VARINT) //!< Maximum size of one frame.
+
+/**
+  * All the field values of one report in fixed point.
+  */
+class MyTelemetryFrame
+{
+public:
+   int32_t values[TELEMETRY_FIELDS]; //!< Fixed point values in the order of MyTelemetryField.
+
+public:
+   MyTelemetryFrame();
+};
+
+/**
+  * Encodes the reports as deltas against the last acknowledged report.
+  * A keyframe is sent at the beginning, after a reset (i.e. reconnect)
+  * and every 'keyframeEvery' messages. An encoded frame only counts after
+  * commit(), so a frame which could not be published is never a reference.
+  */
+class MyTelemetryEncoder
+{
+protected:
+   MyTelemetryFrame reference;      //!< Last acknowledged frame.
+   MyTelemetryFrame pending;        //!< Last sent frame which is not yet acknowledged.
+   MyTelemetryFrame encoded;        //!< Last encoded frame which is not yet sent.
+   uint8_t          referenceSeq;   //!< Sequence number of the reference.
+   uint8_t          pendingSeq;     //!< Sequence number of the pending frame.
+   uint8_t          seq;            //!< Sequence number of the next frame.
+   bool             hasReference;   //!< Is the reference valid?
+   bool             hasPending;     //!< Is the pending frame valid?
+   bool             hasEncoded;     //!< Is the encoded frame valid?
+   bool             isKeyframe;     //!< Is the encoded frame a keyframe?
+   int              sinceKeyframe;  //!< Sent frames since the last keyframe.
+
+public:
+   static int putVarint(uint8_t *buf, int32_t value);
+
+public:
+   MyTelemetryEncoder();
+
+   int  encode(const MyTelemetryFrame &frame, uint8_t *buf, int keyframeEvery);
+   void commit();
+   void acknowledge();
+   void reset();
+};
+
+/**
+  * Restores the reports from keyframes and delta frames.
+  * A delta frame can only be decoded if its reference is one of the last decoded frames.
+  */
+class MyTelemetryDecoder
+{
+protected:
+   MyTelemetryFrame history[TELEMETRY_HISTORY];    //!< Last decoded frames.
+   int16_t          historySeq[TELEMETRY_HISTORY]; //!< Sequence numbers of the history (-1 = empty).
+
+public:
+   static int getVarint(const uint8_t *buf, int len, int32_t &value);
+
+public:
+   MyTelemetryDecoder();
+
+   bool decode(const uint8_t *buf, int len, MyTelemetryFrame &frame);
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyTelemetryFrame::MyTelemetryFrame()
+{
+   memset(values, 0, sizeof(values));
+}
+
+/* ******************************************** */
+
+/** Constructor */
+MyTelemetryEncoder::MyTelemetryEncoder()
+   : referenceSeq(0)
+   , pendingSeq(0)
+   , seq(0)
+   , hasReference(false)
+   , hasPending(false)
+   , hasEncoded(false)
+   , isKeyframe(false)
+   , sinceKeyframe(0)
+{
+}
+
+/** Write one value zigzag and varint coded. Returns the number of bytes. */
+int MyTelemetryEncoder::putVarint(uint8_t *buf, int32_t value)
+{
+   uint32_t zigzag = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+   int      len    = 0;
+
+   while (zigzag >= 0x80) {
+      buf[len++] = (uint8_t) (zigzag | 0x80);
+      zigzag >>= 7;
+   }
+   buf[len++] = (uint8_t) zigzag;
+   return len;
+}
+
+/**
+  * Encode one frame into buf (TELEMETRY_MAX_FRAME bytes). The state of the encoder
+  * is only changed with commit() after the frame was sent.
+  * Returns the length of the encoded frame.
+  */
+int MyTelemetryEncoder::encode(const MyTelemetryFrame &frame, uint8_t *buf, int keyframeEvery)
+{
+   bool keyframe = !hasReference || sinceKeyframe >= keyframeEvery - 1;
+   int  len      = 0;
+
+   buf[len++] = keyframe ? TELEMETRY_KEYFRAME : TELEMETRY_DELTA;
+   buf[len++] = seq;
+   if (!keyframe) {
+      buf[len++] = referenceSeq;
+   }
+   for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+      int32_t value = frame.values[i];
+
+      if (!keyframe) {
+         value = (int32_t) ((uint32_t) value - (uint32_t) reference.values[i]);
+      }
+      len += putVarint(buf + len, value);
+   }
+   encoded    = frame;
+   hasEncoded = true;
+   isKeyframe = keyframe;
+   return len;
+}
+
+/** The encoded frame was sent. It is pending until the server acknowledges it. */
+void MyTelemetryEncoder::commit()
+{
+   if (hasEncoded) {
+      sinceKeyframe = isKeyframe ? 0 : sinceKeyframe + 1;
+      pending       = encoded;
+      pendingSeq    = seq++;
+      hasPending    = true;
+      hasEncoded    = false;
+   }
+}
+
+/** The server has received the pending frame. It is the reference of the next deltas. */
+void MyTelemetryEncoder::acknowledge()
+{
+   if (hasPending) {
+      reference    = pending;
+      referenceSeq = pendingSeq;
+      hasReference = true;
+      hasPending   = false;
+   }
+}
+
+/** Forget the reference, so the next frame is a keyframe. */
+void MyTelemetryEncoder::reset()
+{
+   hasReference = false;
+   hasPending   = false;
+   hasEncoded   = false;
+}
+
+/* ******************************************** */
+
+/** Constructor */
+MyTelemetryDecoder::MyTelemetryDecoder()
+{
+   for (int i = 0; i < TELEMETRY_HISTORY; i++) {
+      historySeq[i] = -1;
+   }
+}
+
+/** Read one zigzag and varint coded value. Returns the number of bytes or 0 on errors. */
+int MyTelemetryDecoder::getVarint(const uint8_t *buf, int len, int32_t &value)
+{
+   uint32_t zigzag = 0;
+
+   for (int i = 0; i < len && i < TELEMETRY_MAX_VARINT; i++) {
+      zigzag |= (uint32_t) (buf[i] & 0x7F) << (7 * i);
+      if (!(buf[i] & 0x80)) {
+         value = (int32_t) ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+         return i + 1;
+      }
+   }
+   return 0;
+}
+
+/** Decode one received frame. Returns false if the frame is corrupt or its reference is unknown. */
+bool MyTelemetryDecoder::decode(const uint8_t *buf, int len, MyTelemetryFrame &frame)
+{
+   if (len < 2 || (buf[0] != TELEMETRY_KEYFRAME && buf[0] != TELEMETRY_DELTA)) {
+      return false;
+   }
+
+   bool                    keyframe  = buf[0] == TELEMETRY_KEYFRAME;
+   uint8_t                 seq       = buf[1];
+   int                     pos       = 2;
+   const MyTelemetryFrame *reference = NULL;
+
+   if (!keyframe) {
+      if (len < 3 || historySeq[buf[2] % TELEMETRY_HISTORY] != buf[2]) {
+         return false;
+      }
+      reference = &history[buf[2] % TELEMETRY_HISTORY];
+      pos++;
+   }
+   for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+      int32_t value = 0;
+      int     n     = getVarint(buf + pos, len - pos, value);
+
+      if (n == 0) {
+         return false;
+      }
+      if (reference) {
+         value = (int32_t) ((uint32_t) reference->values[i] + (uint32_t) value);
+      }
+      frame.values[i] = value;
+      pos += n;
+   }
+   if (pos != len) {
+      return false;
+   }
+   history   [seq % TELEMETRY_HISTORY] = frame;
+   historySeq[seq % TELEMETRY_HISTORY] = seq;
+   return true;
+}
@@ -62,6 +62,42 @@ String Trim(const String &data, const String &chars)
    return ret;
 }
 
+/**
+  * Seconds since 1970-01-01 of an UTC date and time (days from the civil calendar).
+  */
+uint32_t ToEpoch(int year, int month, int day, int hour, int minute, int second)
+{
+   long y    = year - (month <= 2 ? 1 : 0);
+   long era  = y / 400;
+   long yoe  = y - era * 400;
+   long doy  = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+   long doe  = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+   long days = era * 146097 + doe - 719468;
+
+   return (uint32_t) days * 86400UL + hour * 3600UL + minute * 60UL + second;
+}
+
+/**
+  * UTC date and time of the seconds since 1970-01-01 (inverse of ToEpoch).
+  */
+void FromEpoch(uint32_t epoch, int &year, int &month, int &day, int &hour, int &minute, int &second)
+{
+   long days = epoch / 86400UL + 719468;
+   long secs = epoch % 86400UL;
+   long era  = days / 146097;
+   long doe  = days - era * 146097;
+   long yoe  = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+   long doy  = doe - (365 * yoe + yoe / 4 - yoe / 100);
+   long mp   = (5 * doy + 2) / 153;
+
+   day    = doy - (153 * mp + 2) / 5 + 1;
+   month  = mp < 10 ? mp + 3 : mp - 9;
+   year   = yoe + era * 400 + (month <= 2 ? 1 : 0);
+   hour   = secs / 3600;
+   minute = (secs / 60) % 60;
+   second = secs % 60;
+}
+
 /**
   * Helper function to start the OTA functionality of the ESP.
   */
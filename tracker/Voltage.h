@@ -0,0 +1,337 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Voltage.h
+  *
+  * Filtered supply voltage and selection of the duty cycle profile.
+  */
+
+
+#define RTC_VOLTAGE_OFFSET     (RTC_ENERGY_OFFSET + sizeof(MyEnergyRtc) / 4) //!< RTC memory block behind the energy data.
+#define RTC_VOLTAGE_MAGIC      130868 //!< Fantasy value for checking if the voltage data is initialized.
+#define VOLTAGE_MAX_SAMPLES    32     //!< Maximum number of analog samples for one voltage value.
+#define VOLTAGE_EMA_ALPHA      0.1    //!< Weight of a new voltage value in the exponential moving average.
+#define VOLTAGE_TREND_SEC      60     //!< Time between two trend calculations.
+#define VOLTAGE_TREND_ALPHA    0.3    //!< Weight of a new slope in the trend average.
+#define VOLTAGE_CHARGING_TREND 0.2    //!< Minimum rising trend in V/h to detect charging.
+#define VOLTAGE_CHARGING_AMP   0.05   //!< Minimum battery current in A to detect charging (DS2438).
+#define VOLTAGE_SAMPLE_SEC     1      //!< Interval of the analog samples.
+#define VOLTAGE_MONITOR        "DS2438" //!< Sensor with the preferred battery voltage and current.
+
+/**
+  * Intervals of one duty cycle profile as factors of the configured options.
+  */
+class MyDutyProfileInfo
+{
+public:
+   const char *name;        //!< Name for the information page.
+   long        gpsFactor;   //!< Factor to the gps check interval.
+   long        mqttFactor;  //!< Factor to the mqtt send intervals.
+   long        sleepFactor; //!< Factor to the deep sleep time (0 = stay awake).
+   bool        isGsmOn;     //!< May the sim808 be switched on?
+};
+
+/**
+  * Voltage estimator data which are stored in the RTC memory to survive the deep sleep.
+  */
+class MyVoltageRtc
+{
+public:
+   uint32_t magic;        //!< Is the RTC memory initialized?
+   int32_t  profile;      //!< Current duty cycle profile.
+   double   ema;          //!< Exponential moving average of the voltage.
+   double   trend;        //!< Average voltage slope in V/h.
+   double   trendEma;     //!< Voltage at the last trend calculation.
+   double   trendSec;     //!< Uptime of the last trend calculation.
+   double   windowSec;    //!< Uptime at the start of the statistics window.
+   double   windowSum;    //!< Sum of the voltages in the running window.
+   double   windowMin;    //!< Minimum voltage in the running window.
+   double   windowMax;    //!< Maximum voltage in the running window.
+   double   lastMean;     //!< Mean voltage of the last finished window.
+   double   lastMin;      //!< Minimum voltage of the last finished window.
+   double   lastMax;      //!< Maximum voltage of the last finished window.
+   int32_t  windowCount;  //!< Number of voltages in the running window.
+   int32_t  windows;      //!< Number of finished windows.
+};
+
+/**
+  * Sensor driver of the analog input and supply voltage estimator.
+  * Reads the supply voltage as the median of several samples, corrects it with the 
+  * calibration from the options and filters it with an exponential moving average. 
+  * The average, the trend and the statistics window are kept in the RTC memory so a
+  * single sample after the deep sleep does not switch the mode. The duty cycle
+  * profile is selected with hysteresis bands around the configured voltages.
+  */
+class MyVoltage : public MySensor
+{
+public:
+   static const MyDutyProfileInfo profiles[DUTY_PROFILES]; //!< Intervals of all the profiles.
+
+protected:
+   MyOptions   &myOptions;     //!< Reference to the options.
+   MyData      &myData;        //!< Reference to the data.
+   MyEnergy    &myEnergy;      //!< Reference to the energy model (uptime over deep sleeps).
+   int          pinAnalog;     //!< Analog pin connected with the voltage divider.
+   double       analogFactor;  //!< Factor of the voltage divider.
+   MyVoltageRtc rtc;           //!< Estimator values (RTC memory image).
+
+protected:
+   double        readSample();
+   void          updateTrend();
+   void          updateWindow(double sample);
+   void          setWindow();
+   MyDutyProfile selectProfile(const MySamples &samples);
+   void          setProfile(MyDutyProfile profile);
+
+public:
+   MyVoltage(MyOptions &options, MyData &data, MyEnergy &energy, int pinAnalog, double analogFactor);
+
+   bool begin();
+
+   virtual const char *getName();
+   virtual long getIntervalSec();
+   virtual long start();
+   virtual long poll();
+   virtual bool read(MySamples &samples);
+
+   bool isGsmAllowed();
+};
+
+/* ******************************************** */
+
+const MyDutyProfileInfo MyVoltage::profiles[DUTY_PROFILES] = {
+   // name        gps  mqtt sleep gsm
+   { "Charging",  1,   1,   0,    true  },
+   { "Normal",    1,   2,   0,    true  },
+   { "Save",      2,   4,   1,    true  },
+   { "Critical",  4,   4,   4,    false }
+};
+
+/** Constructor */
+MyVoltage::MyVoltage(MyOptions &options, MyData &data, MyEnergy &energy, int pinAnalog, double analogFactor)
+   : myOptions(options)
+   , myData(data)
+   , myEnergy(energy)
+   , pinAnalog(pinAnalog)
+   , analogFactor(analogFactor)
+{
+   memset(&rtc, 0, sizeof(rtc));
+}
+
+/** Restore the estimator from the RTC memory and take the first sample. */
+bool MyVoltage::begin()
+{
+   MyDbg("MyVoltage::begin");
+
+   MyVoltageRtc tmp;
+   double       sample = readSample();
+
+   ESP.rtcUserMemoryRead(RTC_VOLTAGE_OFFSET, (uint32_t *) &tmp, sizeof(tmp));
+   if (tmp.magic == RTC_VOLTAGE_MAGIC) {
+      rtc = tmp;
+   } else {
+      rtc.magic    = RTC_VOLTAGE_MAGIC;
+      rtc.profile  = DUTY_NORMAL;
+      rtc.ema      = sample;
+      rtc.trend    = 0.0;
+      rtc.trendEma = sample;
+      rtc.trendSec = myEnergy.getUptimeSec();
+      rtc.windowSec   = rtc.trendSec;
+      rtc.windowCount = 0;
+      rtc.windows     = 0;
+   }
+   setWindow();
+   read(myData.samples);
+   MyDbg("Voltage: " + String(myData.voltage, 1) + " (" + String(profiles[myData.dutyProfile].name) + ")");
+   return true;
+}
+
+/** 
+  * Median of several analog readings in Volt with the calibration of the options.
+  * The median drops the spikes of the sim808 transmit bursts which an average would keep.
+  */
+double MyVoltage::readSample()
+{
+   int values[VOLTAGE_MAX_SAMPLES];
+   int count = constrain(myOptions.voltageSamples, 1L, (long) VOLTAGE_MAX_SAMPLES);
+
+   for (int i = 0; i < count; i++) {
+      int value = analogRead(pinAnalog);
+      int j     = i;
+
+      // Insertion sort while reading
+      for (; j > 0 && values[j - 1] > value; j--) {
+         values[j] = values[j - 1];
+      }
+      values[j] = value;
+   }
+
+   double median = count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+
+   return analogFactor * median * myOptions.voltageCalibFactor + myOptions.voltageCalibOffset;
+}
+
+/** Calculate the voltage slope in V/h from time to time (also over the deep sleep). */
+void MyVoltage::updateTrend()
+{
+   double currSec    = myEnergy.getUptimeSec();
+   double elapsedSec = currSec - rtc.trendSec;
+
+   if (elapsedSec < VOLTAGE_TREND_SEC) {
+      return;
+   }
+
+   double slope = (rtc.ema - rtc.trendEma) * 3600.0 / elapsedSec;
+
+   rtc.trend   += VOLTAGE_TREND_ALPHA * (slope - rtc.trend);
+   rtc.trendEma = rtc.ema;
+   rtc.trendSec = currSec;
+}
+
+/** Collect the mean, minimum and maximum voltage of the statistics window. */
+void MyVoltage::updateWindow(double sample)
+{
+   if (rtc.windowCount == 0) {
+      rtc.windowSum = 0.0;
+      rtc.windowMin = sample;
+      rtc.windowMax = sample;
+   }
+   rtc.windowSum += sample;
+   rtc.windowMin  = min(rtc.windowMin, sample);
+   rtc.windowMax  = max(rtc.windowMax, sample);
+   rtc.windowCount++;
+
+   double currSec = myEnergy.getUptimeSec();
+
+   if (currSec - rtc.windowSec >= myOptions.voltageWindowSec) {
+      rtc.lastMean    = rtc.windowSum / rtc.windowCount;
+      rtc.lastMin     = rtc.windowMin;
+      rtc.lastMax     = rtc.windowMax;
+      rtc.windowSec   = currSec;
+      rtc.windowCount = 0;
+      rtc.windows++;
+      setWindow();
+   }
+}
+
+/** Set the statistics of the last finished window into the global data. */
+void MyVoltage::setWindow()
+{
+   myData.voltageMean    = rtc.lastMean;
+   myData.voltageMin     = rtc.lastMin;
+   myData.voltageMax     = rtc.lastMax;
+   myData.voltageWindows = rtc.windows;
+}
+
+/**
+  * Select the profile from the filtered voltage.
+  * A boundary has to be crossed by the hysteresis before the profile changes.
+  */
+MyDutyProfile MyVoltage::selectProfile(const MySamples &samples)
+{
+   double thresholds[DUTY_PROFILES - 1] = {
+      myOptions.chargingVoltage, myOptions.powerSaveModeVoltage, myOptions.criticalVoltage
+   };
+   int    profile = DUTY_CRITICAL;
+   double current = 0.0;
+
+   for (int i = 0; i < DUTY_PROFILES - 1; i++) {
+      double threshold = rtc.profile <= i ? thresholds[i] - myOptions.voltageHysteresis
+                                          : thresholds[i] + myOptions.voltageHysteresis;
+
+      if (rtc.ema >= threshold) {
+         profile = i;
+         break;
+      }
+   }
+   if (profile == DUTY_NORMAL && rtc.trend >= VOLTAGE_CHARGING_TREND) {
+      profile = DUTY_CHARGING;
+   }
+   if (profile == DUTY_NORMAL && samples.getValue(VOLTAGE_MONITOR, SAMPLE_CURRENT, current) && current >= VOLTAGE_CHARGING_AMP) {
+      profile = DUTY_CHARGING;
+   }
+   return (MyDutyProfile) profile;
+}
+
+/** Set the effective intervals of the profile into the global data. */
+void MyVoltage::setProfile(MyDutyProfile profile)
+{
+   if (profile != rtc.profile) {
+      MyDbg("Duty profile: " + String(profiles[profile].name));
+   }
+   rtc.profile = profile;
+
+   myData.dutyProfile = profile;
+   if (myOptions.isDeepSleepEnabled) {
+      myData.gpsCheckIntervalSec = myOptions.gpsCheckIntervalSec * profiles[profile].gpsFactor;
+      myData.mqttSendFactor      = profiles[profile].mqttFactor;
+   } else {
+      myData.gpsCheckIntervalSec = myOptions.gpsCheckIntervalSec;
+      myData.mqttSendFactor      = 1;
+   }
+}
+
+/** May the sim808 be switched on in the current profile? */
+bool MyVoltage::isGsmAllowed()
+{
+   return !myOptions.isDeepSleepEnabled || profiles[myData.dutyProfile].isGsmOn;
+}
+
+/** Name of the sensor. */
+const char *MyVoltage::getName()
+{
+   return "ADC";
+}
+
+/** The analog input is read every second. */
+long MyVoltage::getIntervalSec()
+{
+   return VOLTAGE_SAMPLE_SEC;
+}
+
+/** The analog conversion is done while reading. */
+long MyVoltage::start()
+{
+   return 0;
+}
+
+/** The analog conversion is done while reading. */
+long MyVoltage::poll()
+{
+   return 0;
+}
+
+/** 
+  * Read a new sample, update the average, trend and profile and keep them in the RTC memory. 
+  * The voltage of the DS2438 battery monitor is preferred to the analog input if it is available.
+  * The analog sample is not added to the sample buffer, the estimated voltage is published as 'Voltage'.
+  */
+bool MyVoltage::read(MySamples &samples)
+{
+   double sample = readSample();
+
+   samples.getValue(VOLTAGE_MONITOR, SAMPLE_VOLTAGE, sample);
+   rtc.ema += VOLTAGE_EMA_ALPHA * (sample - rtc.ema);
+   updateTrend();
+   updateWindow(sample);
+   setProfile(selectProfile(samples));
+
+   myData.voltage      = rtc.ema;
+   myData.voltageTrend = rtc.trend;
+   ESP.rtcUserMemoryWrite(RTC_VOLTAGE_OFFSET, (uint32_t *) &rtc, sizeof(rtc));
+   return true;
+}
@@ -40,6 +40,9 @@ public:
    static DNSServer        dnsServer; //!< Dns server
    static MyOptions       *myOptions; //!< Reference to the options.
    static MyData          *myData;    //!< Reference to the data.
+   static MyScheduler     *myScheduler; //!< Reference to the main loop scheduler.
+   static MyEnergy        *myEnergy;  //!< Reference to the energy model.
+   static MyHistory       *myHistory; //!< Reference to the time series history.
 
 protected:
    static bool   loadFromSpiffs(String path);
@@ -69,6 +72,7 @@ public:
    static void handleLoadConsoleInfo();
    static void loadRestart();
    static void handleLoadRestartInfo();
+   static void handleHistory();
    static void handleNotFound();
    static void handleWebRequests();
 
@@ -76,7 +80,7 @@ public:
    bool isWebServerActive; //!< Is the webserver currently active.
    
 public:
-   MyWebServer(MyOptions &options, MyData &data);
+   MyWebServer(MyOptions &options, MyData &data, MyScheduler &scheduler, MyEnergy &energy, MyHistory &history);
    ~MyWebServer();
 
    bool begin();
@@ -90,19 +94,28 @@ DNSServer        MyWebServer::dnsServer;
 ESP8266WebServer MyWebServer::server(80);
 MyOptions       *MyWebServer::myOptions = NULL;
 MyData          *MyWebServer::myData    = NULL;
+MyScheduler     *MyWebServer::myScheduler = NULL;
+MyEnergy        *MyWebServer::myEnergy    = NULL;
+MyHistory       *MyWebServer::myHistory   = NULL;
 
 
 /** Constructor/Destructor */
-MyWebServer::MyWebServer(MyOptions &options, MyData &data)
+MyWebServer::MyWebServer(MyOptions &options, MyData &data, MyScheduler &scheduler, MyEnergy &energy, MyHistory &history)
    : isWebServerActive(false)
 {
-   myOptions = &options;
-   myData    = &data;      
+   myOptions   = &options;
+   myData      = &data;      
+   myScheduler = &scheduler;
+   myEnergy    = &energy;
+   myHistory   = &history;
 }
 MyWebServer::~MyWebServer()
 {
-   myOptions = NULL;
-   myData    = NULL;      
+   myOptions   = NULL;
+   myData      = NULL;      
+   myScheduler = NULL;
+   myEnergy    = NULL;
+   myHistory   = NULL;
 }
 
 /** Starts the Webserver in station and/or ap mode and sets all the callback 
@@ -115,6 +128,9 @@ bool MyWebServer::begin()
 
    MyDbg("MyWebServer::begin");
    WiFi.mode(WIFI_AP_STA);
+   if (myEnergy) {
+      myEnergy->set(ENERGY_WIFI, true);
+   }
    WiFi.softAP("ESP8266AP", "");
    WiFi.softAPConfig(ip, ip, IPAddress(255, 255, 255, 0));  
    dnsServer.setErrorReplyCode(DNSReplyCode::NoError);
@@ -151,6 +167,7 @@ bool MyWebServer::begin()
    server.on("/ConsoleInfo",         handleLoadConsoleInfo);
    server.on("/Restart.html",        loadRestart);
    server.on("/RestartInfo",         handleLoadRestartInfo);
+   server.on("/api/history",         handleHistory);
    server.onNotFound(handleWebRequests);
 
    server.begin(); 
@@ -355,10 +372,14 @@ void MyWebServer::handleLoadMainInfo()
    if (myData->status != "") {
       AddTableTr(info, "Status", myData->status);
    }
-   AddTableTr(info, "Battery",     String(myData->voltage,     1) + " V");
-   AddTableTr(info, "Temperature", String(myData->temperature, 1) + " °C");
-   AddTableTr(info, "Humidity",    String(myData->humidity,    1) + " %");
-   AddTableTr(info, "Pressure",    String(myData->temperature, 1) + " hPa");
+   AddTableTr(info, "Battery",     String(myData->voltage,     1) + " V (" + MyVoltage::profiles[myData->dutyProfile].name + ")");
+   for (int i = 0; i < myData->samples.getCount(); i++) {
+      const MySample &sample = myData->samples.get(i);
+
+      if (sample.isValid) {
+         AddTableTr(info, String(sample.sensor) + " " + sample.getName(), sample.getText());
+      }
+   }
    if (myData->status != "") {
       AddTableTr(info, "Modem Info", myData->modemInfo);
       AddTableTr(info, "Longitude",  myData->longitude);
@@ -428,11 +449,19 @@ void MyWebServer::handleLoadSettingsInfo()
    AddOption(info, "isDebugActive",          "Debug Active",                      myOptions->isDebugActive);
    
    AddOption(info, "bme280CheckIntervalSec", "Temperature check every (Seconds)", String(myOptions->bme280CheckIntervalSec));
+   AddOption(info, "bme280Profile",          "BME280 profile (0 = Weather, 1 = Cabin, 2 = Precise)", String(myOptions->bme280Profile));
    AddOption(info, "isGsmEnabled",           "GSM Enabled",                       myOptions->isGsmEnabled);
+   AddOption(info, "isModemSleepEnabled",    "GSM Sleep between communication",   myOptions->isModemSleepEnabled);
    AddOption(info, "isGpsEnabled",           "GPS Enabled",                       myOptions->isGpsEnabled);
    AddOption(info, "gpsCheckIntervalSec",    "GPS check every (Seconds)",         String(myOptions->gpsCheckIntervalSec));
+   AddOption(info, "isGpsStreamEnabled",     "GPS NMEA stream (1 Hz without polling)", myOptions->isGpsStreamEnabled);
+   AddOption(info, "cellLocAfterSec",        "Cell position without GPS fix after (Seconds, 0 = off)", String(myOptions->cellLocAfterSec));
+   AddOption(info, "cellLocMaxPerHour",      "Cell position lookups per hour",    String(myOptions->cellLocMaxPerHour));
+   AddOption(info, "minMovingDistance",      "Moving over distance (m)",          String(myOptions->minMovingDistance));
+   AddOption(info, "motionSpeedKmph",        "Moving over speed (km/h)",          String(myOptions->motionSpeedKmph, 1));
+   AddOption(info, "motionStopSec",          "Parked after standing (Seconds)",   String(myOptions->motionStopSec));
    AddOption(info, "phoneNumber",            "Information send to",               myOptions->phoneNumber);
-   AddOption(info, "smsCheckIntervalSec",    "SMS check every (Seconds)",         String(myOptions->smsCheckIntervalSec));
+   AddOption(info, "smsCheckIntervalSec",    "SMS sweep every (Seconds)",         String(myOptions->smsCheckIntervalSec));
    {
       HtmlTag fieldset(info, "fieldset");
       {
@@ -441,6 +470,14 @@ void MyWebServer::handleLoadSettingsInfo()
          AddOption(info, "isDeepSleepEnabled", "Power saving mode active", myOptions->isDeepSleepEnabled, false);
       }
       AddOption(info, "powerSaveModeVoltage",  "Power saving mode under (Volt)", String(myOptions->powerSaveModeVoltage, 1));
+      AddOption(info, "chargingVoltage",       "Charging over (Volt)",           String(myOptions->chargingVoltage, 1));
+      AddOption(info, "criticalVoltage",       "Critical under (Volt)",          String(myOptions->criticalVoltage, 1));
+      AddOption(info, "voltageHysteresis",     "Hysteresis (Volt)",              String(myOptions->voltageHysteresis, 2));
+      AddOption(info, "voltageSamples",        "Analog samples per value",       String(myOptions->voltageSamples));
+      AddOption(info, "voltageCalibFactor",    "Analog calibration factor",      String(myOptions->voltageCalibFactor, 4));
+      AddOption(info, "voltageCalibOffset",    "Analog calibration offset (Volt)", String(myOptions->voltageCalibOffset, 3));
+      AddOption(info, "voltageWindowSec",      "Voltage statistics window (Seconds)", String(myOptions->voltageWindowSec));
+      AddOption(info, "historyRawSec",         "History every (Seconds, 0 = off)", String(myOptions->historyRawSec));
       AddOption(info, "powerCheckIntervalSec", "Check power every (Seconds)",    String(myOptions->powerCheckIntervalSec));
       
       AddOption(info, "wakeTimeSec",          "Active time (Seconds)",           String(myOptions->wakeTimeSec));
@@ -452,16 +489,75 @@ void MyWebServer::handleLoadSettingsInfo()
       {
          HtmlTag legend(info, "legend");
          
+         AddOption(info, "isDs2438Enabled", "DS2438 battery monitor active", myOptions->isDs2438Enabled, false);
+      }
+      AddOption(info, "ds2438CheckIntervalSec", "Check battery every (Seconds)",   String(myOptions->ds2438CheckIntervalSec));
+      AddOption(info, "ds2438VoltageFactor",    "Voltage divider factor",          String(myOptions->ds2438VoltageFactor, 2));
+      AddOption(info, "ds2438SenseOhm",         "Current sense resistor (Ohm)",    String(myOptions->ds2438SenseOhm, 3), false);
+   }
+   AddBr(info);
+   {
+      HtmlTag fieldset(info, "fieldset");
+      {
+         HtmlTag legend(info, "legend");
+         
+         AddOption(info, "isAgpsEnabled", "A-GNSS (last position, time and EPO data)", myOptions->isAgpsEnabled, false);
+      }
+      AddOption(info, "agpsServer",     "EPO ftp server (empty = no download)", myOptions->agpsServer);
+      AddOption(info, "agpsUser",       "EPO ftp user",                        myOptions->agpsUser);
+      AddOption(info, "agpsPassword",   "EPO ftp password",                    myOptions->agpsPassword, true, true);
+      AddOption(info, "agpsFile",       "EPO file",                            myOptions->agpsFile);
+      AddOption(info, "agpsValidHours", "EPO download every (Hours)",          String(myOptions->agpsValidHours), false);
+   }
+   AddBr(info);
+   {
+      HtmlTag fieldset(info, "fieldset");
+      {
+         HtmlTag legend(info, "legend");
+         
+         info += "Energy model (mA)";
+      }
+      AddOption(info, "energyEspMA",         "ESP8266 awake",           String(myOptions->energyEspMA, 1));
+      AddOption(info, "energyWifiMA",        "WiFi on",                 String(myOptions->energyWifiMA, 1));
+      AddOption(info, "energyModemSleepMA",  "Modem sleep",             String(myOptions->energyModemSleepMA, 2));
+      AddOption(info, "energyModemIdleMA",   "Modem idle",              String(myOptions->energyModemIdleMA, 1));
+      AddOption(info, "energyModemActiveMA", "Modem active",            String(myOptions->energyModemActiveMA, 1));
+      AddOption(info, "energyGnssMA",        "GNSS on",                 String(myOptions->energyGnssMA, 1));
+      AddOption(info, "energyGprsMA",        "GPRS transfer",           String(myOptions->energyGprsMA, 1));
+      AddOption(info, "energyDeepSleepMA",   "DeepSleep",               String(myOptions->energyDeepSleepMA, 2), false);
+   }
+   AddBr(info);
+   {
+      HtmlTag fieldset(info, "fieldset");
+      {
+         HtmlTag legend(info, "legend");
+         
          AddOption(info, "isMqttEnabled", "MQTT Active", myOptions->isMqttEnabled, false);
       }
       AddOption(info, "mqttName",                  "MQTT Name",                             myOptions->mqttName);
       AddOption(info, "mqttServer",                "MQTT Server",                           myOptions->mqttServer);
       AddOption(info, "mqttPort",                  "MQTT Port",                             String(myOptions->mqttPort));
+      AddOption(info, "isMqttSnEnabled",           "MQTT-SN over UDP (one datagram per report)", myOptions->isMqttSnEnabled);
+      AddOption(info, "mqttSnPort",                "MQTT-SN Gateway Port",                  String(myOptions->mqttSnPort));
+      AddOption(info, "mqttSnTopicId",             "MQTT-SN Topic Id (pre-defined)",        String(myOptions->mqttSnTopicId));
       AddOption(info, "mqttUser",                  "MQTT User",                             myOptions->mqttUser);
       AddOption(info, "mqttPassword",              "MQTT Password",                         myOptions->mqttPassword, true, true);
       AddOption(info, "mqttReconnectIntervalSec",  "MQTT Reconnect every (Seconds)",        String(myOptions->mqttReconnectIntervalSec));
       AddOption(info, "mqttSendOnMoveEverySec",    "MQTT Send on moving every (Seconds)",   String(myOptions->mqttSendOnMoveEverySec));
-      AddOption(info, "mqttSendOnNonMoveEverySec", "MQTT Send on standing every (Seconds)", String(myOptions->mqttSendOnNonMoveEverySec), false);
+      AddOption(info, "mqttSendOnNonMoveEverySec", "MQTT Send on standing every (Seconds)", String(myOptions->mqttSendOnNonMoveEverySec));
+      AddOption(info, "mqttQos1Window",            "MQTT QoS 1 window (0 = QoS 0)",         String(myOptions->mqttQos1Window));
+      AddOption(info, "mqttKeepAliveSec",          "MQTT max. keepalive (Seconds)",         String(myOptions->mqttKeepAliveSec));
+      AddOption(info, "mqttKeyframeEvery",         "MQTT binary keyframe every (0 = text)", String(myOptions->mqttKeyframeEvery));
+      AddOption(info, "mqttHeartbeatSec",          "MQTT Heartbeat (Seconds, 0 = always)",  String(myOptions->mqttHeartbeatSec));
+      AddOption(info, "mqttBandRelativePct",       "MQTT Relative deadband (%)",            String(myOptions->mqttBandRelativePct));
+      AddOption(info, "mqttBandPositionM",         "MQTT Deadband position (m)",            String(myOptions->mqttBandPositionM));
+      AddOption(info, "mqttBandAltitudeM",         "MQTT Deadband altitude (m)",            String(myOptions->mqttBandAltitudeM));
+      AddOption(info, "mqttBandKmph",              "MQTT Deadband speed (km/h)",            String(myOptions->mqttBandKmph));
+      AddOption(info, "mqttBandVoltage",           "MQTT Deadband voltage (V)",             String(myOptions->mqttBandVoltage));
+      AddOption(info, "mqttBandTemperature",       "MQTT Deadband temperature (C)",         String(myOptions->mqttBandTemperature));
+      AddOption(info, "mqttBandHumidity",          "MQTT Deadband humidity (%)",            String(myOptions->mqttBandHumidity));
+      AddOption(info, "mqttBandPressure",          "MQTT Deadband pressure (hPa)",          String(myOptions->mqttBandPressure));
+      AddOption(info, "mqttBandCsq",               "MQTT Deadband signal quality",          String(myOptions->mqttBandCsq), false);
    }
 
    server.send(200,"text/html", info);
@@ -480,25 +576,75 @@ void MyWebServer::handleSaveSettings()
    GetOption("wlanPassword",              myOptions->wlanPassword);
    GetOption("isDebugActive",             myOptions->isDebugActive);
    GetOption("bme280CheckIntervalSec",    myOptions->bme280CheckIntervalSec);
+   GetOption("bme280Profile",             myOptions->bme280Profile);
+   GetOption("isDs2438Enabled",           myOptions->isDs2438Enabled);
+   GetOption("ds2438CheckIntervalSec",    myOptions->ds2438CheckIntervalSec);
+   GetOption("ds2438VoltageFactor",       myOptions->ds2438VoltageFactor);
+   GetOption("ds2438SenseOhm",            myOptions->ds2438SenseOhm);
    GetOption("isGsmEnabled",              myOptions->isGsmEnabled);
+   GetOption("isModemSleepEnabled",       myOptions->isModemSleepEnabled);
    GetOption("phoneNumber",               myOptions->phoneNumber);
    GetOption("smsCheckIntervalSec",       myOptions->smsCheckIntervalSec);
    GetOption("isGpsEnabled",              myOptions->isGpsEnabled);
    GetOption("gpsCheckIntervalSec",       myOptions->gpsCheckIntervalSec);
+   GetOption("isGpsStreamEnabled",        myOptions->isGpsStreamEnabled);
+   GetOption("cellLocAfterSec",           myOptions->cellLocAfterSec);
+   GetOption("cellLocMaxPerHour",         myOptions->cellLocMaxPerHour);
+   GetOption("minMovingDistance",         myOptions->minMovingDistance);
+   GetOption("motionSpeedKmph",           myOptions->motionSpeedKmph);
+   GetOption("motionStopSec",             myOptions->motionStopSec);
+   GetOption("isAgpsEnabled",             myOptions->isAgpsEnabled);
+   GetOption("agpsServer",                myOptions->agpsServer);
+   GetOption("agpsUser",                  myOptions->agpsUser);
+   GetOption("agpsPassword",              myOptions->agpsPassword);
+   GetOption("agpsFile",                  myOptions->agpsFile);
+   GetOption("agpsValidHours",            myOptions->agpsValidHours);
    GetOption("isDeepSleepEnabled",        myOptions->isDeepSleepEnabled);
    GetOption("powerSaveModeVoltage",      myOptions->powerSaveModeVoltage);
+   GetOption("chargingVoltage",           myOptions->chargingVoltage);
+   GetOption("criticalVoltage",           myOptions->criticalVoltage);
+   GetOption("voltageHysteresis",         myOptions->voltageHysteresis);
+   GetOption("voltageSamples",            myOptions->voltageSamples);
+   GetOption("voltageCalibFactor",        myOptions->voltageCalibFactor);
+   GetOption("voltageCalibOffset",        myOptions->voltageCalibOffset);
+   GetOption("voltageWindowSec",          myOptions->voltageWindowSec);
+   GetOption("historyRawSec",             myOptions->historyRawSec);
    GetOption("powerCheckIntervalSec",     myOptions->powerCheckIntervalSec);
    GetOption("wakeTimeSec",               myOptions->wakeTimeSec);
    GetOption("deepSleepTimeSec",          myOptions->deepSleepTimeSec);
+   GetOption("energyEspMA",               myOptions->energyEspMA);
+   GetOption("energyWifiMA",              myOptions->energyWifiMA);
+   GetOption("energyModemSleepMA",        myOptions->energyModemSleepMA);
+   GetOption("energyModemIdleMA",         myOptions->energyModemIdleMA);
+   GetOption("energyModemActiveMA",       myOptions->energyModemActiveMA);
+   GetOption("energyGnssMA",              myOptions->energyGnssMA);
+   GetOption("energyGprsMA",              myOptions->energyGprsMA);
+   GetOption("energyDeepSleepMA",         myOptions->energyDeepSleepMA);
    GetOption("isMqttEnabled",             myOptions->isMqttEnabled);
+   GetOption("isMqttSnEnabled",           myOptions->isMqttSnEnabled);
    GetOption("mqttName",                  myOptions->mqttName);
    GetOption("mqttServer",                myOptions->mqttServer);
    GetOption("mqttPort",                  myOptions->mqttPort);
+   GetOption("mqttSnPort",                myOptions->mqttSnPort);
+   GetOption("mqttSnTopicId",             myOptions->mqttSnTopicId);
    GetOption("mqttUser",                  myOptions->mqttUser);
    GetOption("mqttPassword",              myOptions->mqttPassword);
    GetOption("mqttReconnectIntervalSec",  myOptions->mqttReconnectIntervalSec);
    GetOption("mqttSendOnMoveEverySec",    myOptions->mqttSendOnMoveEverySec);
    GetOption("mqttSendOnNonMoveEverySec", myOptions->mqttSendOnNonMoveEverySec);
+   GetOption("mqttQos1Window",            myOptions->mqttQos1Window);
+   GetOption("mqttKeepAliveSec",          myOptions->mqttKeepAliveSec);
+   GetOption("mqttKeyframeEvery",         myOptions->mqttKeyframeEvery);
+   GetOption("mqttHeartbeatSec",          myOptions->mqttHeartbeatSec);
+   GetOption("mqttBandRelativePct",       myOptions->mqttBandRelativePct);
+   GetOption("mqttBandPositionM",         myOptions->mqttBandPositionM);
+   GetOption("mqttBandAltitudeM",         myOptions->mqttBandAltitudeM);
+   GetOption("mqttBandKmph",              myOptions->mqttBandKmph);
+   GetOption("mqttBandVoltage",           myOptions->mqttBandVoltage);
+   GetOption("mqttBandTemperature",       myOptions->mqttBandTemperature);
+   GetOption("mqttBandHumidity",          myOptions->mqttBandHumidity);
+   GetOption("mqttBandPressure",          myOptions->mqttBandPressure);
+   GetOption("mqttBandCsq",               myOptions->mqttBandCsq);
 
    myOptions->save();
 
@@ -547,8 +693,37 @@ void MyWebServer::handleLoadInfoInfo()
       AddTableTr(info, "Battery Volt",         myData->batteryVolt);
       AddTableTr(info);
    }
+   {
+      static const char *stateNames[MODEM_STATES] = { "Off", "Sleep", "Idle", "Active" };
+
+      AddTableTr(info, "Modem State",          stateNames[myData->modemState]);
+      AddTableTr(info);
+   }
+   AddTableTr(info, "MQTT Keepalive",       String(myData->mqttKeepAliveSec) + " s (NAT timeout " + 
+                    (myData->mqttNatTimeoutSec ? String(myData->mqttNatTimeoutSec) + " s)" : String("unknown)")));
+   AddTableTr(info);
+   AddTableTr(info, "Voltage Trend",        String(myData->voltageTrend, 2) + " V/h");
+   AddTableTr(info, "Voltage Window",       String(myData->voltageMean, 2) + " V (" + String(myData->voltageMin, 2) + " - " + 
+                                            String(myData->voltageMax, 2) + " V)");
+   AddTableTr(info, "Duty Profile",         MyVoltage::profiles[myData->dutyProfile].name);
+   AddTableTr(info, "BME280 Profile",       myData->bme280Profile + " (" + String(myData->bme280ConversionMs, 1) + " ms, " + 
+                                            String(myData->bme280ChargeUAs, 1) + " uAs)");
+   AddTableTr(info);
+   if (myEnergy) {
+      myEnergy->update();
+      AddTableTr(info, "Energy Total",         String(myEnergy->getTotalMAh(), 2) + " mAh");
+      AddTableTr(info, "Energy Average",       String(myEnergy->getAverageMA(), 2) + " mA");
+      for (int i = 0; i < ENERGY_ITEMS; i++) {
+         MyEnergyItem item = (MyEnergyItem) i;
+
+         AddTableTr(info, "Energy " + String(MyEnergy::names[i]), 
+                    String((long) myEnergy->getSec(item)) + " s (" + String(myEnergy->getMAh(item), 2) + " mAh)");
+      }
+      AddTableTr(info);
+   }
    if (myData->longitude  != "" || myData->latitude != "" || myData->altitude != "" || myData->kmph    != "" || 
        myData->satellites != "" || myData->course   != "" || myData->gpsDate  != "" || myData->gpsTime != "") {
+      AddTableTr(info, "Position Source",      myData->positionSource + " (" + String(myData->positionAccuracyM, 0) + " m)");
       AddTableTr(info, "Longitude",            myData->longitude);
       AddTableTr(info, "Latitude",             myData->latitude);
       AddTableTr(info, "Altitude",             myData->altitude);
@@ -559,9 +734,30 @@ void MyWebServer::handleLoadInfoInfo()
       AddTableTr(info, "GPS Time",             myData->gpsTime);
       AddTableTr(info);
    }
-   if (myData->isMoving || myData->movingDistance != 0.0) {
-      AddTableTr(info, "Moving",               myData->isMoving ? "Yes" : "No");
-      AddTableTr(info, "Distance (m)",         String(myData->movingDistance, 2));
+   if (myData->gpsTtffCount > 0 || myData->epoAgeSec >= 0) {
+      AddTableTr(info, "GPS TTFF",             String(myData->gpsTtffSec, 1) + " s (" + myData->gpsAssist + ")");
+      AddTableTr(info, "EPO Age",              myData->epoAgeSec >= 0 ? String(myData->epoAgeSec / 3600.0, 1) + " h" : String("-"));
+      AddTableTr(info);
+   }
+   if (myData->nmeaSentences > 0 || myData->nmeaErrors > 0) {
+      AddTableTr(info, "NMEA Sentences",       String(myData->nmeaSentences) + " (" + String(myData->nmeaErrors) + " checksum errors)");
+      AddTableTr(info);
+   }
+   if (myData->motionState != "") {
+      AddTableTr(info, "Motion",               myData->motionState);
+      AddTableTr(info, "Distance to park position (m)", String(myData->movingDistance, 2));
+      AddTableTr(info, "Rejected Fixes",       String(myData->rejectedFixes));
+      AddTableTr(info);
+   }
+   if (myScheduler) {
+      AddTableTr(info, "CPU Load",             String(myScheduler->getLoad(), 1) + " %");
+      for (int i = 0; i < myScheduler->count(); i++) {
+         MyTask &task  = myScheduler->getAt(i);
+         long    avgMs = task.runCount ? task.totalRunMs / task.runCount : 0;
+
+         AddTableTr(info, "Task " + String(task.name), 
+                    String(avgMs) + " / " + String(task.maxRunMs) + " ms (Jitter " + String(task.maxJitterMs) + " ms)");
+      }
       AddTableTr(info);
    }
    AddTableTr(info, "ESP Chip ID",            String(ESP.getChipId()));
@@ -643,6 +839,27 @@ void MyWebServer::handleLoadRestartInfo()
    myData->restartInfo = "";
 }
 
+/** 
+  * Stream the history of one value: /api/history?field=voltage&from=3600&res=1m&fmt=csv
+  * 'from' is the time span in seconds back from now, 'res' is raw, 1m, 15m or 1h and 'fmt' csv or bin.
+  */
+void MyWebServer::handleHistory()
+{
+   if (!myOptions || !myData || !myHistory) {
+      return;
+   }
+
+   int  field   = MyHistory::getField(server.arg("field"));
+   int  level   = server.hasArg("res")  ? MyHistory::getLevel(server.arg("res")) : HISTORY_1MIN;
+   long fromSec = server.hasArg("from") ? server.arg("from").toInt()            : 3600;
+
+   if (field < 0 || level < 0 || fromSec <= 0) {
+      server.send(400, "text/plain", "Unknown field, res or from");
+      return;
+   }
+   myHistory->stream(server, field, level, fromSec, server.arg("fmt") == "bin");
+}
+
 /** Handle if the url could not be found. */
 void MyWebServer::handleNotFound()
 {
@@ -112,3 +112,57 @@ function loadRestartInfo()
     x.open('GET', 'RestartInfo', true);
     x.send();
 }
+
+function loadHistory()
+{
+    var f = document.getElementById('field').value;
+    var r = document.getElementById('range').value.split(',');
+
+    if (x != null) {
+        x.abort();
+    }
+    clearTimeout(lt);
+    x = new XMLHttpRequest();
+    x.onreadystatechange = function () {
+        if (x.readyState == 4 && x.status == 200) {
+            drawHistory(x.responseText, parseInt(r[0]));
+        }
+    };
+    x.open('GET', 'api/history?field=' + f + '&from=' + r[0] + '&res=' + r[1], true);
+    x.send();
+    lt = setTimeout(loadHistory, 60000);
+}
+
+function drawHistory(csv, span)
+{
+    var c = document.getElementById('chart');
+    var g = c.getContext('2d');
+    var l = csv.split('\n');
+    var a = [], v = [];
+    var i, p, min, max;
+
+    for (i = 1; i < l.length; i++) {
+        p = l[i].split(',');
+        if (p.length == 2) {
+            a.push(parseFloat(p[0]));
+            v.push(parseFloat(p[1]));
+        }
+    }
+    g.clearRect(0, 0, c.width, c.height);
+    if (v.length == 0) {
+        document.getElementById('info').innerHTML = 'No values';
+        return;
+    }
+    min = Math.min.apply(null, v);
+    max = Math.max.apply(null, v);
+    if (max == min) {
+        max = min + 1;
+    }
+    g.strokeStyle = '#1fa3ec';
+    g.beginPath();
+    for (i = 0; i < v.length; i++) {
+        g.lineTo(c.width - a[i] * c.width / span, c.height - 10 - (v[i] - min) * (c.height - 20) / (max - min));
+    }
+    g.stroke();
+    document.getElementById('info').innerHTML = 'Min: ' + min.toFixed(2) + ' Max: ' + max.toFixed(2) + ' (' + v.length + ' values)';
+}
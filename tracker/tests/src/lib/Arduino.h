@@ -0,0 +1,43 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+
+
+extern "C"{
+    typedef uint8_t byte ;
+    typedef uint8_t boolean ;
+
+    uint32_t millis( void );
+}
+
+#define TWO_PI 6.283185307179586476925286766559
+#define radians(deg) ((deg)*(M_PI/180.0))
+#define degrees(rad) ((rad)*(180.0/M_PI))
+#define sq(x) ((x)*(x))
+
+// Minimal Arduino String for the gps classes
+class String {
+public:
+    String(const char *s = "") : str(s) {}
+    String(const std::string &s) : str(s) {}
+
+    const char *c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.length(); }
+    String substring(unsigned int from) const { return from < str.length() ? str.substr(from) : ""; }
+    String substring(unsigned int from, unsigned int to) const {
+        return from < str.length() && from < to ? str.substr(from,to - from) : "";
+    }
+    bool operator==(const char *s) const { return str == s; }
+    bool operator!=(const char *s) const { return str != s; }
+
+private:
+    std::string str;
+};
+
+#endif // Arduino_h
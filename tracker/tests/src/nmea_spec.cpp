@@ -0,0 +1,130 @@
+#include "Arduino.h"
+#include "Gps.h"
+#include "Nmea.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+
+bool encodeAll(MyNmeaParser &parser, const char *sentence) {
+    bool ret = false;
+    while (*sentence) {
+        ret = parser.encode(*sentence++);
+    }
+    return ret;
+}
+
+bool isNear(double a, double b) {
+    return fabs(a - b) < 0.000001;
+}
+
+int test_rmc() {
+    IT("takes over a rmc fix with a valid checksum");
+    MyGps gps;
+    MyNmeaParser parser(gps);
+
+    IS_TRUE(encodeAll(parser,"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r"));
+    IS_FALSE(parser.encode('\n'));
+    IS_TRUE(parser.sentences == 1);
+    IS_TRUE(parser.checksumErrors == 0);
+    IS_TRUE(parser.getNewFix());
+    IS_FALSE(parser.getNewFix());
+    IS_TRUE(gps.fixStatus);
+    IS_TRUE(isNear(gps.location.latitude(),48.1173));
+    IS_TRUE(isNear(gps.location.longitude(),11.5 + 1.0 / 60));
+    IS_TRUE(isNear(gps.speed,22.4 * NMEA_KNOTS_KMPH));
+    IS_TRUE(isNear(gps.course,84.4));
+    IS_TRUE(gps.date.day() == 23);
+    IS_TRUE(gps.date.month() == 3);
+    IS_TRUE(gps.time.hour() == 12);
+    IS_TRUE(gps.time.second() == 19);
+
+    END_IT
+}
+
+int test_hemispheres() {
+    IT("negates southern and western positions");
+    MyGps gps;
+    MyNmeaParser parser(gps);
+
+    IS_TRUE(encodeAll(parser,"$GPRMC,123519,A,4807.038,S,01131.000,W,022.4,084.4,230394,003.1,W*65\r"));
+    IS_TRUE(isNear(gps.location.latitude(),-48.1173));
+    IS_TRUE(isNear(gps.location.longitude(),-(11.5 + 1.0 / 60)));
+
+    END_IT
+}
+
+int test_checksum() {
+    IT("rejects a sentence with a wrong or missing checksum");
+    MyGps gps;
+    MyNmeaParser parser(gps);
+
+    IS_FALSE(encodeAll(parser,"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6B\r"));
+    IS_FALSE(encodeAll(parser,"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W\r"));
+    IS_FALSE(encodeAll(parser,"$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6\r"));
+    IS_TRUE(parser.sentences == 0);
+    IS_TRUE(parser.checksumErrors == 3);
+    IS_FALSE(parser.getNewFix());
+    IS_FALSE(gps.fixStatus);
+
+    END_IT
+}
+
+int test_cut_terms() {
+    IT("cuts too long terms but checks the whole sentence");
+    MyGps gps;
+    MyNmeaParser parser(gps);
+
+    IS_TRUE(encodeAll(parser,"$GPRMC,123519,A,4807.0380000000000000001,N,01131.000,E,022.4,084.4,230394,003.1,W*6B\r"));
+    IS_TRUE(isNear(gps.location.latitude(),48.1173));
+
+    END_IT
+}
+
+int test_gga_and_no_fix() {
+    IT("takes over the gga values and a rmc without fix");
+    MyGps gps;
+    MyNmeaParser parser(gps);
+
+    IS_TRUE(encodeAll(parser,"$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r"));
+    IS_TRUE(gps.satellitesUsed == 8);
+    IS_TRUE(isNear(gps.hdop,0.9));
+    IS_TRUE(isNear(gps.altitude,545.4));
+    IS_FALSE(parser.getNewFix());
+
+    IS_TRUE(encodeAll(parser,"$GPRMC,123519,V,,,,,,,230394,,*33\r"));
+    IS_TRUE(gps.runStatus);
+    IS_FALSE(gps.fixStatus);
+    IS_FALSE(parser.getNewFix());
+
+    END_IT
+}
+
+int test_set_nmea() {
+    IT("converts degrees and minutes into degrees");
+    MyDegrees degrees;
+
+    IS_TRUE(degrees.setNmea("4807.038"));
+    IS_TRUE(degrees.predecimal == 48);
+    IS_TRUE(isNear(degrees.value(),48.1173));
+    IS_TRUE(degrees.setNmea("01131.5"));
+    IS_TRUE(isNear(degrees.value(),11.525));
+    IS_TRUE(degrees.setNmea("0000.0000"));
+    IS_TRUE(isNear(degrees.value(),0.0));
+    IS_TRUE(degrees.setNmea("17959.9999"));
+    IS_TRUE(isNear(degrees.value(),179.0 + 59.9999 / 60));
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Nmea");
+    test_rmc();
+    test_hemispheres();
+    test_checksum();
+    test_cut_terms();
+    test_gga_and_no_fix();
+    test_set_nmea();
+
+    FINISH
+}
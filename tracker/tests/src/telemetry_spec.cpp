@@ -0,0 +1,173 @@
+#include "Telemetry.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+
+MyTelemetryFrame makeFrame(int32_t base) {
+    MyTelemetryFrame frame;
+    for (int i = 0;i<TELEMETRY_FIELDS;i++) {
+        frame.values[i] = base + i * 1000;
+    }
+    return frame;
+}
+
+bool isSame(const MyTelemetryFrame &a, const MyTelemetryFrame &b) {
+    return memcmp(a.values,b.values,sizeof(a.values)) == 0;
+}
+
+int test_varint() {
+    IT("codes zigzag varints");
+    int32_t values[] = { 0, 1, -1, 63, -64, 64, 8191, -8192, 2147483647, -2147483647-1 };
+    int lengths[]    = { 1, 1, 1,  1,  1,   2,  2,    2,     5,          5 };
+    uint8_t buf[TELEMETRY_MAX_VARINT];
+
+    for (int i = 0;i<10;i++) {
+        int32_t value = 0;
+        int len = MyTelemetryEncoder::putVarint(buf,values[i]);
+        IS_TRUE(len == lengths[i]);
+        IS_TRUE(MyTelemetryDecoder::getVarint(buf,len,value) == len);
+        IS_TRUE(value == values[i]);
+    }
+    // truncated varint
+    int32_t value = 0;
+    int len = MyTelemetryEncoder::putVarint(buf,8191);
+    IS_TRUE(MyTelemetryDecoder::getVarint(buf,len-1,value) == 0);
+
+    END_IT
+}
+
+int test_keyframe_and_deltas() {
+    IT("decodes a keyframe and the following deltas");
+    MyTelemetryEncoder encoder;
+    MyTelemetryDecoder decoder;
+    uint8_t buf[TELEMETRY_MAX_FRAME];
+
+    for (int i = 0;i<5;i++) {
+        MyTelemetryFrame frame = makeFrame(5200000 + i * 3);
+        MyTelemetryFrame decoded;
+        int len = encoder.encode(frame,buf,10);
+        encoder.commit();
+        encoder.acknowledge();
+
+        IS_TRUE(buf[0] == (i == 0 ? TELEMETRY_KEYFRAME : TELEMETRY_DELTA));
+        IS_TRUE(buf[1] == i);
+        IS_TRUE(decoder.decode(buf,len,decoded));
+        IS_TRUE(isSame(frame,decoded));
+        if (i > 0) {
+            // small changes only cost one byte per field
+            IS_TRUE(len == 3 + TELEMETRY_FIELDS);
+        }
+    }
+
+    END_IT
+}
+
+int test_keyframe_every() {
+    IT("sends a keyframe every n frames and after a reset");
+    MyTelemetryEncoder encoder;
+    uint8_t buf[TELEMETRY_MAX_FRAME];
+    uint8_t types[7];
+
+    for (int i = 0;i<6;i++) {
+        encoder.encode(makeFrame(i),buf,3);
+        encoder.commit();
+        encoder.acknowledge();
+        types[i] = buf[0];
+    }
+    encoder.reset();
+    encoder.encode(makeFrame(7),buf,3);
+    types[6] = buf[0];
+
+    IS_TRUE(types[0] == TELEMETRY_KEYFRAME);
+    IS_TRUE(types[1] == TELEMETRY_DELTA);
+    IS_TRUE(types[2] == TELEMETRY_DELTA);
+    IS_TRUE(types[3] == TELEMETRY_KEYFRAME);
+    IS_TRUE(types[4] == TELEMETRY_DELTA);
+    IS_TRUE(types[5] == TELEMETRY_DELTA);
+    IS_TRUE(types[6] == TELEMETRY_KEYFRAME);
+
+    END_IT
+}
+
+int test_not_sent_frame() {
+    IT("never uses a not sent frame as reference");
+    MyTelemetryEncoder encoder;
+    MyTelemetryDecoder decoder;
+    uint8_t buf[TELEMETRY_MAX_FRAME];
+    MyTelemetryFrame decoded;
+
+    int len = encoder.encode(makeFrame(100),buf,10);
+    encoder.commit();
+    IS_TRUE(decoder.decode(buf,len,decoded));
+    encoder.acknowledge();
+
+    // the publish of this frame fails, so it is not committed
+    encoder.encode(makeFrame(200),buf,10);
+    encoder.acknowledge();
+
+    MyTelemetryFrame frame = makeFrame(300);
+    len = encoder.encode(frame,buf,10);
+    encoder.commit();
+    IS_TRUE(buf[0] == TELEMETRY_DELTA);
+    IS_TRUE(buf[1] == 1);
+    IS_TRUE(buf[2] == 0);
+    IS_TRUE(decoder.decode(buf,len,decoded));
+    IS_TRUE(isSame(frame,decoded));
+
+    END_IT
+}
+
+int test_unacknowledged_reference() {
+    IT("keeps the reference until the frame is acknowledged");
+    MyTelemetryEncoder encoder;
+    uint8_t buf[TELEMETRY_MAX_FRAME];
+
+    encoder.encode(makeFrame(100),buf,10);
+    encoder.commit();
+    encoder.acknowledge();
+    encoder.encode(makeFrame(200),buf,10);
+    encoder.commit();
+    encoder.encode(makeFrame(300),buf,10);
+    IS_TRUE(buf[0] == TELEMETRY_DELTA);
+    IS_TRUE(buf[2] == 0);
+
+    END_IT
+}
+
+int test_decode_errors() {
+    IT("rejects unknown references and corrupt frames");
+    MyTelemetryEncoder encoder;
+    MyTelemetryDecoder decoder;
+    uint8_t buf[TELEMETRY_MAX_FRAME];
+    MyTelemetryFrame decoded;
+
+    int len = encoder.encode(makeFrame(100),buf,10);
+    encoder.commit();
+    encoder.acknowledge();
+    // the keyframe is lost
+    len = encoder.encode(makeFrame(200),buf,10);
+    IS_FALSE(decoder.decode(buf,len,decoded));
+
+    len = encoder.encode(makeFrame(100),buf,1);
+    IS_TRUE(buf[0] == TELEMETRY_KEYFRAME);
+    IS_FALSE(decoder.decode(buf,len-1,decoded));
+    buf[len] = 0;
+    IS_FALSE(decoder.decode(buf,len+1,decoded));
+    buf[0] = 'X';
+    IS_FALSE(decoder.decode(buf,len,decoded));
+
+    END_IT
+}
+
+int main()
+{
+    SUITE("Telemetry");
+    test_varint();
+    test_keyframe_and_deltas();
+    test_keyframe_every();
+    test_not_sent_frame();
+    test_unacknowledged_reference();
+    test_decode_errors();
+
+    FINISH
+}
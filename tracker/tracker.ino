@@ -35,32 +35,54 @@
 #include "StringList.h"
 #include "Utils.h"
 #include "Options.h"
+#include "Sensor.h"
 #include "Data.h"
+#include "Scheduler.h"
+#include "Energy.h"
+#include "Voltage.h"
 #include "DeepSleep.h"
+#include "History.h"
 #include "WebServer.h"
 #include "GsmPower.h"
 #include "GsmGps.h"
+#include "CellLocator.h"
 #include "SmsCmd.h"
+#include "Telemetry.h"
 #include "Mqtt.h"
+#include "MqttSn.h"
 #include "BME280.h"
+#include "BatteryMonitor.h"
 
 
 #define     PIN_TX        14                               //!< Transmit-pin to the sim808
 #define     PIN_RX        12                               //!< receive-pin to the sim808
 #define     PIN_POWER     0                                //!< power on/off to DC-DC LM2596
 #define     PIN_BME_POWER 2                                //!< power pin to the BME280 module
+#define     PIN_DTR       13                               //!< DTR pin of the sim808 for the slow clock mode
+#define     PIN_ONE_WIRE  3                                //!< 1-wire bus of the DS2438 (RX pin, serial is tx only if enabled)
 #define     ANALOG_FACTOR 0.03                             //!< Factor to the analog voltage divider
 
 MyOptions   myOptions;                                     //!< The global options.
 MyData      myData;                                        //!< The global collected data.
-MyDeepSleep myDeepSleep(myOptions, myData);                //!< Helper class for deep sleeps.
-MyWebServer myWebServer(myOptions, myData);                //!< The Webserver
-MyGsmPower  myGsmPower(PIN_POWER);                         //!< Helper class to switch on/off the sim808 power.
-MyGsmGps    myGsmGps(myOptions, myData, PIN_RX, PIN_TX);   //!< sim808 gsm/gps communication class.
+MyScheduler myScheduler;                                   //!< The main loop task scheduler.
+MyEnergy    myEnergy(myOptions, myData);                   //!< Energy accounting of all the consumers.
+MyVoltage   myVoltage(myOptions, myData, myEnergy, A0, ANALOG_FACTOR); //!< Filtered supply voltage and duty cycle profile.
+MyDeepSleep myDeepSleep(myOptions, myData, myEnergy);      //!< Helper class for deep sleeps.
+MyHistory   myHistory(myOptions, myData, myEnergy);        //!< Time series history on the SPIFFS.
+MyWebServer myWebServer(myOptions, myData, myScheduler, myEnergy, myHistory);     //!< The Webserver
+MyGsmPower  myGsmPower(myOptions, myData, myEnergy, PIN_POWER, PIN_DTR);          //!< Power state machine of the sim808.
+MyGsmGps    myGsmGps(myGsmPower, myEnergy, myOptions, myData, PIN_RX, PIN_TX); //!< sim808 gsm/gps communication class.
+MyCellLocator myCellLocator(myGsmGps, myEnergy, myOptions, myData); //!< Cell position if the gps has no fix.
 MySmsCmd    mySmsCmd(myGsmGps, myOptions, myData);         //!< sms controller class for the sms handling.
-MyMqtt      myMqtt(myGsmGps, myOptions, myData);           //!< Helper class for the mqtt communication.
-MyBME280    myBME280(myOptions, myData, PIN_BME_POWER);    //!< Helper class for the BME280 sensor communication.
+MyMqtt      myMqtt(myGsmGps, myEnergy, myOptions, myData); //!< Helper class for the mqtt communication.
+MyMqttSn    myMqttSn(myGsmGps, myEnergy, myOptions, myData); //!< Helper class for the mqtt-sn datagrams.
+MyBME280    myBME280(myOptions, myData, PIN_BME_POWER);    //!< Sensor driver of the BME280.
+MyDS2438    myDS2438(myOptions, PIN_ONE_WIRE);             //!< Sensor driver of the DS2438 battery monitor.
+MySensors   mySensors(myData.samples);                     //!< Registry of all the sensor drivers.
 
+int         gpsTaskId   = -1;                              //!< Scheduler id of the gps task.
+int         smsTaskId   = -1;                              //!< Scheduler id of the sms task.
+int         sensorsTaskId = -1;                            //!< Scheduler id of the sensors task.
 bool        gsmHasPower = false;                           //!< Is the DC-DC modul switched on?
 bool        isStarting  = false;                           //!< Are we in a starting process?
 bool        isStopping  = false;                           //!< Are we in a stopping process?
@@ -105,61 +127,50 @@ void myDelayLoop()
    yield();
 }
 
-/** Helper Function to read the power supply voltage from the voltage divider. */
-void readVoltage(bool dbg = false)
+/** Task: Start, poll or read the due sensors and come back at the next due step of any sensor. */
+void taskSensors()
 {
-   myData.voltage = ANALOG_FACTOR * analogRead(A0); // Volt
-   if (dbg) {
-      MyDbg("Voltage: " + String(myData.voltage, 1));
-   }
+   myScheduler.runIn(sensorsTaskId, mySensors.handleClient());
 }
 
-/** Main setup function. This is also called after every deep sleep. 
-  * Do the initialization of every sub-component. */
-void setup() 
+/** Task: Store the values in the history if the raw interval is over. */
+void taskHistory()
 {
-   Serial.begin(115200); 
-   MyDbg("Start ESP8266...");
-
-   myGsmPower.begin();
-   SPIFFS.begin();
-   myOptions.load();
-   readVoltage(true);
-   myDeepSleep.begin();
-   
-   myWebServer.begin();
-   myMqtt.begin();
-   mySmsCmd.begin();
-   myBME280.begin();
+   myHistory.handleClient();
 }
 
-/** Main loop function.
-  * Read the power supply voltage.
-  * Checks for console inputs and send them to the SIM808 modul.
-  * Checks for OTA activities.
-  * Start or stop the gsm and/or gps activities.
-  * Check for receiving sms and process them.
-  * Checks the gps and send the overall information to a mqtt server if needed.
-  * Starts the deep sleep mode if needed.
-  */
-void loop() 
+/** Task: Send one console input to the SIM808 modul. */
+void taskConsole()
 {
-   readVoltage();
-   myBME280.readValues();
-
    if (!myData.consoleCmds.isEmpty()) {
       String cmd = myData.consoleCmds.removeHead();
       
       myGsmGps.sendAT(cmd);
    }
-   
+}
+
+/** Task: Handle the webserver and OTA activities. */
+void taskWebServer()
+{
    myWebServer.handleClient();
    
    if (myData.isOtaActive) {
       ArduinoOTA.handle();    
    }
+}
+
+/** Is the sim808 modul powered and not in a starting or stopping process? */
+bool isGsmReady()
+{
+   return gsmHasPower && !isStarting && !isStopping;
+}
+
+/** Task: Start or stop the gsm and/or gps activities and handle the sim808 power states. */
+void taskGsmPower()
+{
+   bool gsmPower = myOptions.gsmPower && myVoltage.isGsmAllowed();
 
-   if (myOptions.gsmPower && !gsmHasPower) {
+   if (gsmPower && !gsmHasPower) {
       if (!isStarting && !isStopping) {
          isStarting = true;
          myGsmPower.on(); 
@@ -168,33 +179,134 @@ void loop()
             myOptions.gsmPower = false;
          }
          isStarting = false;
+         // The first gps and sms check as soon as the sim808 is ready.
+         myScheduler.runIn(gpsTaskId, 0);
+         myScheduler.runIn(smsTaskId, 0);
       }
    }
-   if (!myOptions.gsmPower && gsmHasPower) {
+   if (!gsmPower && gsmHasPower) {
       if (!isStarting && !isStopping) {
          isStopping = true;
+         myMqtt.save();
          myGsmGps.stop();
          myGsmPower.off();
          gsmHasPower = false;
          isStopping  = false;   
       }
    }
-   if (gsmHasPower && !isStarting && !isStopping) {
+   if (isGsmReady()) {
+      myGsmGps.handlePower();
+      if (myGsmGps.hasNewSms()) {
+         myScheduler.runIn(smsTaskId, 0);
+      }
+   }
+   myGsmPower.handleClient();
+}
+
+/** Task: Check the gps position and fall back to the cell position without fix. */
+void taskGps()
+{
+   if (isGsmReady()) {
       myGsmGps.handleClient();
+      myCellLocator.handleClient();
+   }
+}
+
+/** Task: Parse the nmea stream of the gps if it is switched on. */
+void taskNmea()
+{
+   if (isGsmReady()) {
+      myGsmGps.handleNmea();
+   }
+}
+
+/** Task: Process the indicated sms or sweep for missed ones. */
+void taskSms()
+{
+   if (isGsmReady()) {
       mySmsCmd.handleClient();
-      if (myOptions.isMqttEnabled) {
+   }
+}
+
+/** Task: Send the overall information to a mqtt server (session or datagrams) if needed. */
+void taskMqtt()
+{
+   if (isGsmReady() && myOptions.isMqttEnabled) {
+      if (myOptions.isMqttSnEnabled) {
+         myMqttSn.handleClient();
+      } else {
          myMqtt.handleClient();
       }
    }
+}
 
+/** Task: Accumulate the energy model and keep it in the RTC memory. */
+void taskEnergy()
+{
+   myEnergy.save();
+}
+
+/** Task: Starts the deep sleep mode if needed. */
+void taskDeepSleep()
+{
    if (myDeepSleep.haveToSleep()) {
+      myMqtt.save();
       if (myGsmGps.isGsmActive) {
          myGsmGps.stop();
       }
       myGsmPower.off();
       myDeepSleep.sleep();
    }
+}
+
+/** Main setup function. This is also called after every deep sleep. 
+  * Do the initialization of every sub-component. */
+void setup() 
+{
+   Serial.begin(115200);
+   MyDbg("Start ESP8266...");
+
+   myGsmPower.begin();
+   SPIFFS.begin();
+   myOptions.load();
+   if (myOptions.isDs2438Enabled) {
+      Serial.end(); // RX pin is the 1-wire bus
+      Serial.begin(115200, SERIAL_8N1, SERIAL_TX_ONLY);
+   }
+   myEnergy.begin();
+   myVoltage.begin();
+   myDeepSleep.begin();
+   myHistory.begin();
+   myCellLocator.begin();
    
-   yield();
-   delay(10); 
+   myWebServer.begin();
+   myMqtt.begin();
+   myMqttSn.begin();
+   mySmsCmd.begin();
+   myBME280.begin();
+   myDS2438.begin();
+   mySensors.add(myVoltage);
+   mySensors.add(myBME280);
+   mySensors.add(myDS2438);
+
+   myScheduler.begin();
+   myScheduler.addTask      ("WebServer", taskWebServer, 10);
+   myScheduler.addTask      ("Console",   taskConsole,   100);
+   sensorsTaskId = myScheduler.addTask("Sensors", taskSensors, SENSORS_IDLE_MS);
+   myScheduler.addTask      ("GsmPower",  taskGsmPower,  1000);
+   gpsTaskId = myScheduler.addOptionTask("Gps", taskGps, myData.gpsCheckIntervalSec);
+   myScheduler.addTask      ("Nmea",      taskNmea,      NMEA_TASK_MS);
+   smsTaskId = myScheduler.addOptionTask("Sms", taskSms, myOptions.smsCheckIntervalSec);
+   myScheduler.addTask      ("Mqtt",      taskMqtt,      1000);
+   myScheduler.addTask      ("Energy",    taskEnergy,    10000);
+   myScheduler.addTask      ("History",   taskHistory,   1000);
+   myScheduler.addTask      ("DeepSleep", taskDeepSleep, 1000);
+}
+
+/** Main loop function.
+  * Runs all the due tasks of the scheduler and waits until the next deadline.
+  */
+void loop() 
+{
+   myScheduler.handleClient();
 }